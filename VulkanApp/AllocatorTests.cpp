@@ -0,0 +1,288 @@
+#include "AllocatorTests.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "BlockAllocator.h"
+#include "DescriptorAllocator.h"
+#include "Benchmark.h"
+
+namespace {
+	const uint64_t TEST_CAPACITY = 64ull * 1024 * 1024;
+
+	bool Check(bool condition, const std::string& what) {
+		if (!condition) {
+			std::cout << "FAILED: " << what << std::endl;
+		}
+		return condition;
+	}
+
+	//Live allocations by offset, to find overlaps with the neighbours of each new one
+	bool CheckPlacement(const std::map<uint64_t, BlockAllocator::Allocation>& live, const BlockAllocator::Allocation& allocation,
+		uint64_t alignment) {
+		if (!Check(allocation.offset % alignment == 0, "offset is aligned") ||
+			!Check(allocation.offset + allocation.size <= TEST_CAPACITY, "allocation is inside the block")) {
+			return false;
+		}
+
+		auto next = live.lower_bound(allocation.offset);
+		if (next != live.end() && !Check(allocation.offset + allocation.size <= next->first, "no overlap with the next allocation")) {
+			return false;
+		}
+		if (next != live.begin()) {
+			auto prev = std::prev(next);
+			if (!Check(prev->first + prev->second.size <= allocation.offset, "no overlap with the previous allocation")) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	template <typename Function>
+	bool Throws(Function function) {
+		try {
+			function();
+		}
+		catch (const std::runtime_error&) {
+			return true;
+		}
+		return false;
+	}
+
+	//Freeing twice must throw and leave the allocator intact, also when the range was merged into a neighbour
+	bool CheckDoubleFree() {
+		BlockAllocator allocator(1024);
+		BlockAllocator::Allocation first = allocator.Allocate(256);
+		BlockAllocator::Allocation second = allocator.Allocate(256);
+		allocator.Free(first);
+		allocator.Free(second);		//Merges into first, its node is released
+
+		if (!Check(Throws([&] { allocator.Free(first); }), "freeing a free range throws") ||
+			!Check(Throws([&] { allocator.Free(second); }), "freeing a range merged into its neighbour throws")) {
+			return false;
+		}
+
+		BlockAllocator::Stats stats = allocator.GetStats();
+		return Check(allocator.IsEmpty() && stats.used == 0, "double free leaves the counters alone") &&
+			Check(stats.free_range_count == 1 && stats.largest_free_range == 1024, "double free leaves the free lists alone") &&
+			Check(allocator.Allocate(1024).IsValid(), "block is still usable after a double free");
+	}
+
+	//Handles are only compared and hashed, never used, so any distinct bit patterns will do
+	template<typename T>
+	T FakeHandle(uint64_t bits) {
+		T handle = {};
+		std::memcpy(&handle, &bits, sizeof(T));
+		return handle;
+	}
+
+	//DescriptorSetCache keys: equal content must hash and compare equal whatever order bindings were added in
+	bool CheckDescriptorSetDescs() {
+		VkDescriptorSetLayout layout = FakeHandle<VkDescriptorSetLayout>(0x10);
+		VkBuffer uniforms = FakeHandle<VkBuffer>(0x20);
+		VkBuffer objects = FakeHandle<VkBuffer>(0x30);
+		VkImageView view = FakeHandle<VkImageView>(0x40);
+		VkSampler sampler = FakeHandle<VkSampler>(0x50);
+
+		DescriptorSetDesc in_order(layout);
+		in_order.Buffer(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, uniforms)
+			.Buffer(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, objects, 256, 1024)
+			.Image(2, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, view, sampler);
+
+		DescriptorSetDesc reversed(layout);
+		reversed.Image(2, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, view, sampler)
+			.Buffer(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, objects, 256, 1024)
+			.Buffer(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, uniforms);
+
+		DescriptorSetDesc rebound(layout);
+		rebound.Buffer(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, objects)
+			.Image(2, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, view, sampler)
+			.Buffer(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, objects, 256, 1024)
+			.Buffer(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, uniforms);
+
+		if (!Check(in_order == reversed && in_order.Hash() == reversed.Hash(), "descriptor set add order doesn't matter") ||
+			!Check(in_order == rebound && in_order.Hash() == rebound.Hash(), "rebinding a descriptor replaces it")) {
+			return false;
+		}
+
+		//Any one difference makes it another set
+		DescriptorSetDesc other_layout(FakeHandle<VkDescriptorSetLayout>(0x11));
+		other_layout.Buffer(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, uniforms)
+			.Buffer(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, objects, 256, 1024)
+			.Image(2, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, view, sampler);
+
+		DescriptorSetDesc other_range(layout);
+		other_range.Buffer(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, uniforms)
+			.Buffer(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, objects, 256, 512)
+			.Image(2, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, view, sampler);
+
+		DescriptorSetDesc other_sampler(layout);
+		other_sampler.Buffer(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, uniforms)
+			.Buffer(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, objects, 256, 1024)
+			.Image(2, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, view, FakeHandle<VkSampler>(0x51));
+
+		DescriptorSetDesc missing_binding(layout);
+		missing_binding.Buffer(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, uniforms)
+			.Image(2, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, view, sampler);
+
+		for (const DescriptorSetDesc* different : { &other_layout, &other_range, &other_sampler, &missing_binding }) {
+			if (!Check(!(in_order == *different), "descriptor sets with different content compare unequal") ||
+				!Check(in_order.Hash() != different->Hash(), "descriptor sets with different content hash apart")) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	uint64_t RandomSize(std::mt19937_64& random) {
+		//Mostly small (uniforms, small meshes), sometimes large (textures)
+		std::uniform_int_distribution<int> bucket(0, 9);
+		if (bucket(random) < 8) {
+			return std::uniform_int_distribution<uint64_t>(1, 64 * 1024)(random);
+		}
+		return std::uniform_int_distribution<uint64_t>(64 * 1024, 4 * 1024 * 1024)(random);
+	}
+}
+
+bool RunAllocatorSelfTest() {
+	if (!CheckDoubleFree() || !CheckDescriptorSetDescs()) {
+		return false;
+	}
+
+	std::mt19937_64 random(1234);
+	std::uniform_int_distribution<int> alignment_shift(0, 16);		//1 byte to 64 KiB, like Vulkan alignments
+	BlockAllocator allocator(TEST_CAPACITY);
+	std::map<uint64_t, BlockAllocator::Allocation> live;
+	std::vector<uint64_t> live_offsets;
+	uint64_t failed_allocations = 0;
+
+	const int OPERATIONS = 200000;
+	for (int i = 0; i < OPERATIONS; ++i) {
+		bool allocate = live.empty() || std::uniform_int_distribution<int>(0, 99)(random) < 55;
+
+		if (allocate) {
+			uint64_t size = RandomSize(random);
+			uint64_t alignment = uint64_t(1) << alignment_shift(random);
+			BlockAllocator::Allocation allocation = allocator.Allocate(size, alignment);
+			if (!allocation.IsValid()) {
+				++failed_allocations;
+				continue;
+			}
+			if (!Check(allocation.size == size, "allocation has the requested size") ||
+				!CheckPlacement(live, allocation, alignment)) {
+				return false;
+			}
+			live[allocation.offset] = allocation;
+			live_offsets.push_back(allocation.offset);
+		}
+		else {
+			size_t index = std::uniform_int_distribution<size_t>(0, live_offsets.size() - 1)(random);
+			uint64_t offset = live_offsets[index];
+			live_offsets[index] = live_offsets.back();
+			live_offsets.pop_back();
+
+			allocator.Free(live[offset]);
+			live.erase(offset);
+		}
+
+		if (i % 10000 == 0) {
+			uint64_t live_bytes = 0;
+			for (auto& entry : live) {
+				live_bytes += entry.second.size;
+			}
+			BlockAllocator::Stats stats = allocator.GetStats();
+			if (!Check(stats.used == live_bytes, "used bytes match the live allocations") ||
+				!Check(stats.allocation_count == live.size(), "allocation count matches")) {
+				return false;
+			}
+		}
+	}
+
+	for (auto& entry : live) {
+		allocator.Free(entry.second);
+	}
+
+	BlockAllocator::Stats stats = allocator.GetStats();
+	if (!Check(allocator.IsEmpty(), "allocator is empty after freeing everything") ||
+		!Check(stats.free_range_count == 1 && stats.largest_free_range == TEST_CAPACITY, "free ranges merged back into one")) {
+		return false;
+	}
+
+	//The whole block must still be usable in one piece, and nothing past it
+	BlockAllocator::Allocation whole = allocator.Allocate(TEST_CAPACITY, 256);
+	if (!Check(whole.IsValid() && whole.offset == 0, "whole block can be allocated") ||
+		!Check(!allocator.Allocate(1).IsValid(), "full block refuses more")) {
+		return false;
+	}
+
+	std::cout << "Allocator self test passed (" << OPERATIONS << " operations, "
+		<< failed_allocations << " allocations didn't fit)" << std::endl;
+	return true;
+}
+
+void RunAllocatorBenchmark(uint64_t operation_count) {
+	//Same pre-generated sequence for both, so only the allocator differs
+	struct Operation {
+		bool allocate;
+		uint64_t size;
+		uint64_t alignment;
+		size_t slot;
+	};
+
+	std::mt19937_64 random(42);
+	const size_t SLOTS = 4096;
+	std::vector<Operation> operations;
+	std::vector<bool> slot_used(SLOTS, false);
+	operations.reserve(operation_count);
+	while (operations.size() < operation_count) {
+		size_t slot = std::uniform_int_distribution<size_t>(0, SLOTS - 1)(random);
+		uint64_t size = std::uniform_int_distribution<uint64_t>(256, 64 * 1024)(random);
+		uint64_t alignment = uint64_t(1) << std::uniform_int_distribution<int>(4, 8)(random);
+		operations.push_back({ !slot_used[slot], size, alignment, slot });
+		slot_used[slot] = !slot_used[slot];
+	}
+
+	//Big enough that every slot fits, so only the bookkeeping is measured
+	BlockAllocator allocator(SLOTS * 128 * 1024);
+	std::vector<BlockAllocator::Allocation> tlsf_slots(SLOTS);
+	BenchClock::time_point start = BenchClock::now();
+	for (const Operation& operation : operations) {
+		if (operation.allocate) {
+			tlsf_slots[operation.slot] = allocator.Allocate(operation.size, operation.alignment);
+		}
+		else {
+			allocator.Free(tlsf_slots[operation.slot]);
+		}
+	}
+	double tlsf_ms = ElapsedMs(start);
+	BlockAllocator::Stats stats = allocator.GetStats();
+
+	std::vector<void*> malloc_slots(SLOTS, nullptr);
+	start = BenchClock::now();
+	for (const Operation& operation : operations) {
+		if (operation.allocate) {
+			malloc_slots[operation.slot] = std::malloc(operation.size);
+		}
+		else {
+			std::free(malloc_slots[operation.slot]);
+			malloc_slots[operation.slot] = nullptr;
+		}
+	}
+	double malloc_ms = ElapsedMs(start);
+	for (void* memory : malloc_slots) {
+		std::free(memory);
+	}
+
+	std::cout << std::fixed << std::setprecision(1)
+		<< "Allocator benchmark, " << operation_count << " operations:" << std::endl
+		<< "  BlockAllocator  " << std::setw(8) << tlsf_ms << " ms  " << std::setw(6) << tlsf_ms * 1e6 / operation_count << " ns/op" << std::endl
+		<< "  malloc/free     " << std::setw(8) << malloc_ms << " ms  " << std::setw(6) << malloc_ms * 1e6 / operation_count << " ns/op" << std::endl
+		<< "  left live: " << stats.allocation_count << " allocations in " << stats.free_range_count << " free ranges" << std::endl;
+}
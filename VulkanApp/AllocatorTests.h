@@ -0,0 +1,13 @@
+#pragma once
+
+#include <cstdint>
+
+//CPU only checks and timings of the allocators, no device needed.
+//Run with --alloc-test / --alloc-bench
+
+//Random allocate / free sequences checked for overlap, alignment, bounds and full coalescing, plus the descriptor set
+//cache keys (DescriptorSetDesc). Returns false on failure
+bool RunAllocatorSelfTest();
+
+//Allocate / free throughput of BlockAllocator next to malloc / free on the same sequence
+void RunAllocatorBenchmark(uint64_t operation_count);
@@ -0,0 +1,150 @@
+#include "Benchmark.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <stdexcept>
+
+namespace {
+	//Device names come from the driver, escape them so the output stays valid JSON
+	void WriteJsonString(std::ostream& out, const std::string& value) {
+		out << '"';
+		for (char c : value) {
+			unsigned char code = static_cast<unsigned char>(c);
+			if (c == '"' || c == '\\') {
+				out << '\\' << c;
+			}
+			else if (code < 0x20) {
+				out << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<int>(code)
+					<< std::dec << std::setfill(' ');
+			}
+			else {
+				out << c;
+			}
+		}
+		out << '"';
+	}
+}
+
+void Benchmark::Begin(uint64_t frame_count) {
+	for (auto& metric_samples : samples) {
+		metric_samples.clear();
+		metric_samples.reserve(static_cast<size_t>(frame_count));	//No allocations while frames are being timed
+	}
+	start_time = BenchClock::now();
+}
+
+void Benchmark::End() {
+	total_ms = ElapsedMs(start_time);
+}
+
+void Benchmark::Record(Metric metric, double milliseconds) {
+	samples[metric].push_back(milliseconds);
+}
+
+TimingSummary Benchmark::Summarise(Metric metric) const {
+	TimingSummary summary;
+	if (samples[metric].empty()) {
+		return summary;
+	}
+
+	std::vector<double> sorted = samples[metric];
+	std::sort(sorted.begin(), sorted.end());
+
+	//Nearest-rank percentile
+	auto percentile = [&sorted](double p) {
+		size_t rank = static_cast<size_t>(std::ceil(p / 100.0 * sorted.size()));
+		return sorted[std::max<size_t>(rank, 1) - 1];
+	};
+
+	double sum = 0.0;
+	for (double sample : sorted) {
+		sum += sample;
+	}
+
+	summary.min = sorted.front();
+	summary.p50 = percentile(50.0);
+	summary.p95 = percentile(95.0);
+	summary.p99 = percentile(99.0);
+	summary.max = sorted.back();
+	summary.mean = sum / sorted.size();
+	return summary;
+}
+
+void Benchmark::PrintReport(std::ostream& out) const {
+	size_t frames = samples[CPU_FRAME].size();
+
+	out << "Benchmark: " << frames << " frames in " << std::fixed << std::setprecision(1) << total_ms << " ms";
+	if (total_ms > 0.0) {
+		out << " (" << frames * 1000.0 / total_ms << " fps)";
+	}
+	out << std::endl;
+
+	out << std::left << std::setw(14) << "metric (ms)" << std::right
+		<< std::setw(10) << "min" << std::setw(10) << "p50" << std::setw(10) << "p95"
+		<< std::setw(10) << "p99" << std::setw(10) << "max" << std::setw(10) << "mean" << std::endl;
+
+	out << std::setprecision(3);
+	for (int i = 0; i < METRIC_COUNT; ++i) {
+		Metric metric = static_cast<Metric>(i);
+		if (samples[metric].empty()) {
+			continue;
+		}
+
+		TimingSummary summary = Summarise(metric);
+		out << std::left << std::setw(14) << MetricName(metric) << std::right
+			<< std::setw(10) << summary.min << std::setw(10) << summary.p50 << std::setw(10) << summary.p95
+			<< std::setw(10) << summary.p99 << std::setw(10) << summary.max << std::setw(10) << summary.mean << std::endl;
+	}
+}
+
+void Benchmark::WriteJson(const std::string& path, const std::string& device_name, bool headless, uint32_t frames_in_flight) const {
+	std::ofstream out(path);
+	if (!out.is_open()) {
+		throw std::runtime_error("Failed to open benchmark output : " + path);
+	}
+
+	size_t frames = samples[CPU_FRAME].size();
+
+	out << std::setprecision(6) << std::fixed;
+	out << "{\n";
+	out << "  \"device\": ";
+	WriteJsonString(out, device_name);
+	out << ",\n";
+	out << "  \"headless\": " << (headless ? "true" : "false") << ",\n";
+	out << "  \"frames_in_flight\": " << frames_in_flight << ",\n";
+	out << "  \"frames\": " << frames << ",\n";
+	out << "  \"total_ms\": " << total_ms << ",\n";
+	out << "  \"fps\": " << (total_ms > 0.0 ? frames * 1000.0 / total_ms : 0.0) << ",\n";
+	out << "  \"metrics_ms\": {";
+
+	bool first = true;
+	for (int i = 0; i < METRIC_COUNT; ++i) {
+		Metric metric = static_cast<Metric>(i);
+		if (samples[metric].empty()) {
+			continue;
+		}
+
+		TimingSummary summary = Summarise(metric);
+		out << (first ? "\n" : ",\n");
+		out << "    \"" << MetricName(metric) << "\": { "
+			<< "\"min\": " << summary.min << ", \"p50\": " << summary.p50 << ", \"p95\": " << summary.p95
+			<< ", \"p99\": " << summary.p99 << ", \"max\": " << summary.max << ", \"mean\": " << summary.mean << " }";
+		first = false;
+	}
+
+	out << "\n  }\n}\n";
+}
+
+const char* Benchmark::MetricName(Metric metric) {
+	switch (metric) {
+	case CPU_FRAME: return "cpu_frame";
+	case FENCE_WAIT: return "fence_wait";
+	case ACQUIRE_WAIT: return "acquire_wait";
+	case RECORD: return "record";
+	case SUBMIT: return "submit";
+	case PRESENT_WAIT: return "present_wait";
+	default: return "unknown";
+	}
+}
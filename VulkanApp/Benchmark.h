@@ -0,0 +1,60 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+//Frames run before recording starts so first-use costs (pipeline upload, page faults) don't skew results
+const uint32_t BENCH_WARMUP_FRAMES = 10;
+
+using BenchClock = std::chrono::steady_clock;
+
+static double ElapsedMs(BenchClock::time_point start, BenchClock::time_point end = BenchClock::now()) {
+	return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+//Distribution of one timed quantity over all recorded frames (milliseconds)
+struct TimingSummary {
+	double min = 0.0;
+	double p50 = 0.0;
+	double p95 = 0.0;
+	double p99 = 0.0;
+	double max = 0.0;
+	double mean = 0.0;
+};
+
+//Collects per-frame timings and reports them as min / percentiles / max
+class Benchmark
+{
+public:
+	enum Metric {
+		CPU_FRAME,			//Whole Draw call
+		FENCE_WAIT,			//Waiting for the GPU to release the frame slot
+		ACQUIRE_WAIT,		//Acquiring a swapchain image (and waiting for its previous user)
+		RECORD,				//Command buffer recording
+		SUBMIT,				//vkQueueSubmit
+		PRESENT_WAIT,		//vkQueuePresentKHR
+		METRIC_COUNT
+	};
+
+	void Begin(uint64_t frame_count);
+	void End();
+	void Record(Metric metric, double milliseconds);
+
+	//False until a timed frame has finished, Begin has not run when the loop stopped during warm-up
+	bool HasSamples() const { return !samples[CPU_FRAME].empty(); }
+
+	TimingSummary Summarise(Metric metric) const;
+	void PrintReport(std::ostream& out) const;
+	void WriteJson(const std::string& path, const std::string& device_name, bool headless, uint32_t frames_in_flight) const;
+
+	static const char* MetricName(Metric metric);
+
+private:
+	std::array<std::vector<double>, METRIC_COUNT> samples;
+	BenchClock::time_point start_time;
+	double total_ms = 0.0;
+};
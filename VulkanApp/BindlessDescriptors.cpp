@@ -0,0 +1,224 @@
+#include "BindlessDescriptors.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+bool BindlessDescriptors::IsSupported(VkPhysicalDevice physical_device) {
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(physical_device, &properties);
+	if (properties.apiVersion < VK_API_VERSION_1_2) {
+		return false;
+	}
+
+	VkPhysicalDeviceVulkan12Features vulkan12_features = {};
+	vulkan12_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+	VkPhysicalDeviceFeatures2 features = {};
+	features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	features.pNext = &vulkan12_features;
+	vkGetPhysicalDeviceFeatures2(physical_device, &features);
+	return vulkan12_features.runtimeDescriptorArray && vulkan12_features.descriptorBindingPartiallyBound &&
+		vulkan12_features.descriptorBindingSampledImageUpdateAfterBind && vulkan12_features.descriptorBindingStorageBufferUpdateAfterBind &&
+		features.features.shaderSampledImageArrayDynamicIndexing && features.features.shaderStorageBufferArrayDynamicIndexing;
+}
+
+void BindlessDescriptors::EnableFeatures(VkPhysicalDeviceFeatures& features, VkPhysicalDeviceVulkan12Features& vulkan12_features) {
+	features.shaderSampledImageArrayDynamicIndexing = VK_TRUE;
+	features.shaderStorageBufferArrayDynamicIndexing = VK_TRUE;
+	vulkan12_features.runtimeDescriptorArray = VK_TRUE;					//Unsized arrays in the shaders
+	vulkan12_features.descriptorBindingPartiallyBound = VK_TRUE;
+	vulkan12_features.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+	vulkan12_features.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+}
+
+void BindlessDescriptors::Init(VkPhysicalDevice physical_device, VkDevice logical_device, uint32_t frames_in_flight) {
+	device = logical_device;
+
+	//Update-after-bind bindings have their own, usually much higher, limits
+	VkPhysicalDeviceVulkan12Properties vulkan12_properties = {};
+	vulkan12_properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_PROPERTIES;
+	VkPhysicalDeviceProperties2 properties = {};
+	properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+	properties.pNext = &vulkan12_properties;
+	vkGetPhysicalDeviceProperties2(physical_device, &properties);
+
+	buffers.capacity = std::min({ MAX_BUFFERS, vulkan12_properties.maxPerStageDescriptorUpdateAfterBindStorageBuffers,
+		vulkan12_properties.maxDescriptorSetUpdateAfterBindStorageBuffers, vulkan12_properties.maxPerStageUpdateAfterBindResources / 4 });
+	images.capacity = std::min({ MAX_IMAGES, vulkan12_properties.maxPerStageDescriptorUpdateAfterBindSampledImages,
+		vulkan12_properties.maxDescriptorSetUpdateAfterBindSampledImages,
+		vulkan12_properties.maxPerStageUpdateAfterBindResources - buffers.capacity - 2 });		//The sampler and the colour output count too
+	if (images.capacity == 0 || buffers.capacity == 0) {
+		throw std::runtime_error("Update-after-bind descriptor limits are too low for bindless resources");
+	}
+	images.retired.resize(frames_in_flight);
+	buffers.retired.resize(frames_in_flight);
+
+	VkSamplerCreateInfo sampler_create_info = {};
+	sampler_create_info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	sampler_create_info.magFilter = VK_FILTER_LINEAR;
+	sampler_create_info.minFilter = VK_FILTER_LINEAR;
+	sampler_create_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+	sampler_create_info.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+	sampler_create_info.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+	sampler_create_info.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+	sampler_create_info.maxLod = VK_LOD_CLAMP_NONE;
+	if (vkCreateSampler(device, &sampler_create_info, nullptr, &sampler) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create the bindless sampler");
+	}
+
+	VkDescriptorSetLayoutBinding bindings[3] = {};
+	bindings[0].binding = 0;
+	bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+	bindings[0].descriptorCount = images.capacity;
+	bindings[0].stageFlags = VK_SHADER_STAGE_ALL;
+	bindings[1].binding = 1;
+	bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	bindings[1].descriptorCount = buffers.capacity;
+	bindings[1].stageFlags = VK_SHADER_STAGE_ALL;
+	bindings[2].binding = 2;
+	bindings[2].descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
+	bindings[2].descriptorCount = 1;
+	bindings[2].stageFlags = VK_SHADER_STAGE_ALL;
+	bindings[2].pImmutableSamplers = &sampler;
+
+	VkDescriptorBindingFlags binding_flags[3] = {
+		VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT | VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT,
+		VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT | VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT,
+		0
+	};
+	VkDescriptorSetLayoutBindingFlagsCreateInfo binding_flags_create_info = {};
+	binding_flags_create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+	binding_flags_create_info.bindingCount = 3;
+	binding_flags_create_info.pBindingFlags = binding_flags;
+
+	VkDescriptorSetLayoutCreateInfo layout_create_info = {};
+	layout_create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layout_create_info.pNext = &binding_flags_create_info;
+	layout_create_info.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+	layout_create_info.bindingCount = 3;
+	layout_create_info.pBindings = bindings;
+	if (vkCreateDescriptorSetLayout(device, &layout_create_info, nullptr, &set_layout) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create the bindless descriptor set layout");
+	}
+
+	//Exactly the one set, it is never freed or reset
+	VkDescriptorPoolSize pool_sizes[] = {
+		{ VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, images.capacity },
+		{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, buffers.capacity },
+		{ VK_DESCRIPTOR_TYPE_SAMPLER, 1 }
+	};
+	VkDescriptorPoolCreateInfo pool_create_info = {};
+	pool_create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	pool_create_info.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+	pool_create_info.maxSets = 1;
+	pool_create_info.poolSizeCount = 3;
+	pool_create_info.pPoolSizes = pool_sizes;
+	if (vkCreateDescriptorPool(device, &pool_create_info, nullptr, &pool) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create the bindless descriptor pool");
+	}
+
+	VkDescriptorSetAllocateInfo allocate_info = {};
+	allocate_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocate_info.descriptorPool = pool;
+	allocate_info.descriptorSetCount = 1;
+	allocate_info.pSetLayouts = &set_layout;
+	if (vkAllocateDescriptorSets(device, &allocate_info, &set) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to allocate the bindless descriptor set");
+	}
+}
+
+void BindlessDescriptors::Destroy() {
+	if (device == VK_NULL_HANDLE) {
+		return;
+	}
+
+	vkDestroyDescriptorPool(device, pool, nullptr);		//Frees the set
+	vkDestroyDescriptorSetLayout(device, set_layout, nullptr);
+	vkDestroySampler(device, sampler, nullptr);
+	images = {};
+	buffers = {};
+	device = VK_NULL_HANDLE;
+}
+
+uint32_t BindlessDescriptors::SlotArray::Take() {
+	uint32_t slot;
+	if (!free_slots.empty()) {
+		slot = free_slots.back();
+		free_slots.pop_back();
+	}
+	else if (next_unused < capacity) {
+		slot = next_unused++;
+	}
+	else {
+		throw std::runtime_error("Bindless descriptor array is full");
+	}
+
+	peak = std::max(peak, next_unused);
+	return slot;
+}
+
+void BindlessDescriptors::SlotArray::Release(uint32_t slot, uint32_t frame) {
+	if (slot >= next_unused) {
+		throw std::runtime_error("Released a bindless slot that was never handed out");
+	}
+	retired[frame].push_back(slot);
+}
+
+uint32_t BindlessDescriptors::AddImage(VkImageView view) {
+	uint32_t slot = images.Take();
+
+	VkDescriptorImageInfo image_info = { VK_NULL_HANDLE, view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+	VkWriteDescriptorSet write = {};
+	write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	write.dstSet = set;
+	write.dstBinding = 0;
+	write.dstArrayElement = slot;
+	write.descriptorCount = 1;
+	write.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+	write.pImageInfo = &image_info;
+	vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+	++writes;
+	return slot;
+}
+
+uint32_t BindlessDescriptors::AddBuffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range) {
+	uint32_t slot = buffers.Take();
+
+	VkDescriptorBufferInfo buffer_info = { buffer, offset, range };
+	VkWriteDescriptorSet write = {};
+	write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	write.dstSet = set;
+	write.dstBinding = 1;
+	write.dstArrayElement = slot;
+	write.descriptorCount = 1;
+	write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	write.pBufferInfo = &buffer_info;
+	vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+	++writes;
+	return slot;
+}
+
+void BindlessDescriptors::ReleaseImage(uint32_t slot) {
+	images.Release(slot, current_frame);
+}
+
+void BindlessDescriptors::ReleaseBuffer(uint32_t slot) {
+	buffers.Release(slot, current_frame);
+}
+
+void BindlessDescriptors::BeginFrame(uint32_t frame) {
+	current_frame = frame;
+	for (SlotArray* slots : { &images, &buffers }) {
+		std::vector<uint32_t>& retired = slots->retired[current_frame];
+		slots->free_slots.insert(slots->free_slots.end(), retired.begin(), retired.end());
+		retired.clear();
+	}
+}
+
+void BindlessDescriptors::Bind(VkCommandBuffer command_buffer, VkPipelineBindPoint bind_point, VkPipelineLayout layout) const {
+	vkCmdBindDescriptorSets(command_buffer, bind_point, layout, 0, 1, &set, 0, nullptr);
+}
+
+void BindlessDescriptors::PrintStats(std::ostream& out) const {
+	out << "Bindless descriptors: " << images.peak << "/" << images.capacity << " image slots, " << buffers.peak << "/"
+		<< buffers.capacity << " buffer slots used at most, " << writes << " descriptor writes" << std::endl;
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+#include "Utilities.h"
+
+//Bindless resources (descriptor indexing, core in Vulkan 1.2). Every texture and storage buffer lives in one big
+//update-after-bind set that is bound once per command buffer; shaders pick resources by index, so draws only push
+//the indices of what they use instead of binding sets:
+//  binding 0 - sampled images, AddImage
+//  binding 1 - storage buffers, AddBuffer
+//  binding 2 - the immutable linear sampler every image is read with
+//Slots are written straight into the bound set (UPDATE_AFTER_BIND), unwritten ones are never read (PARTIALLY_BOUND).
+//A released slot is only reused after every frame in flight has finished, since older command buffers may still read it.
+//Indices must be dynamically uniform (the same for a whole draw), non-uniform indexing is not requested.
+//
+//Per frame: BeginFrame after the frame slot's fence wait, Bind once in every command buffer that draws
+class BindlessDescriptors
+{
+public:
+	static const uint32_t INVALID_SLOT = UINT32_MAX;
+
+	//runtimeDescriptorArray, partiallyBound and update-after-bind for sampled images and storage buffers
+	static bool IsSupported(VkPhysicalDevice physical_device);
+	static void EnableFeatures(VkPhysicalDeviceFeatures& features, VkPhysicalDeviceVulkan12Features& vulkan12_features);
+
+	//The arrays are as large as the device's update-after-bind limits allow, up to MAX_IMAGES and MAX_BUFFERS
+	void Init(VkPhysicalDevice physical_device, VkDevice logical_device, uint32_t frames_in_flight);
+	void Destroy();
+
+	VkDescriptorSetLayout GetSetLayout() const { return set_layout; }
+
+	//view must be in SHADER_READ_ONLY_OPTIMAL whenever it is read. Throws std::runtime_error when the array is full
+	uint32_t AddImage(VkImageView view);
+	uint32_t AddBuffer(VkBuffer buffer, VkDeviceSize offset = 0, VkDeviceSize range = VK_WHOLE_SIZE);
+	void ReleaseImage(uint32_t slot);
+	void ReleaseBuffer(uint32_t slot);
+
+	//After the frame slot's fence wait: slots released the last time this slot was current become free
+	void BeginFrame(uint32_t frame);
+
+	//Set 0 of layout, which must have been created with GetSetLayout
+	void Bind(VkCommandBuffer command_buffer, VkPipelineBindPoint bind_point, VkPipelineLayout layout) const;
+
+	void PrintStats(std::ostream& out) const;
+
+private:
+	static const uint32_t MAX_IMAGES = 4096;
+	static const uint32_t MAX_BUFFERS = 1024;
+
+	//Slots of one binding: never used ones are handed out in order, released ones wait out the frames in flight first
+	struct SlotArray {
+		uint32_t capacity = 0;
+		uint32_t next_unused = 0;
+		std::vector<uint32_t> free_slots;
+		std::vector<std::vector<uint32_t>> retired;		//By frame slot, released while it was current
+		uint32_t peak = 0;
+
+		uint32_t Take();
+		void Release(uint32_t slot, uint32_t frame);
+	};
+
+	VkDevice device = VK_NULL_HANDLE;
+	VkSampler sampler = VK_NULL_HANDLE;
+	VkDescriptorSetLayout set_layout = VK_NULL_HANDLE;
+	VkDescriptorPool pool = VK_NULL_HANDLE;
+	VkDescriptorSet set = VK_NULL_HANDLE;
+
+	SlotArray images;
+	SlotArray buffers;
+	uint32_t current_frame = 0;
+	uint64_t writes = 0;
+};
+
+//std430 layout of Material in bindless.frag, an entry of the material table
+struct GpuMaterial {
+	glm::vec4 base_colour;
+	uint32_t texture = BindlessDescriptors::INVALID_SLOT;		//Image slot, INVALID_SLOT = untextured
+	uint32_t padding[3] = {};
+};
+
+//Fragment push constants of bindless.frag, after PositionDecode (the vertex stage's range starts at 0)
+struct MaterialPush {
+	static const uint32_t OFFSET = 32;
+
+	uint32_t material_buffer;	//Buffer slot of the material table
+	uint32_t material;			//Entry in it
+};
@@ -0,0 +1,280 @@
+#include "BlockAllocator.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace {
+	uint32_t HighestBit(uint64_t value) {
+#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanReverse64(&index, value);
+		return index;
+#else
+		return 63 - __builtin_clzll(value);
+#endif
+	}
+
+	uint32_t LowestBit(uint64_t value) {
+#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanForward64(&index, value);
+		return index;
+#else
+		return __builtin_ctzll(value);
+#endif
+	}
+}
+
+BlockAllocator::BlockAllocator(uint64_t capacity) {
+	Reset(capacity);
+}
+
+void BlockAllocator::Reset(uint64_t new_capacity) {
+	capacity = new_capacity;
+	used = 0;
+	allocation_count = 0;
+	nodes.clear();
+	unused_nodes.clear();
+	fl_bitmap = 0;
+	std::fill(std::begin(sl_bitmap), std::end(sl_bitmap), 0);
+	for (auto& fl_lists : free_lists) {
+		std::fill(std::begin(fl_lists), std::end(fl_lists), INVALID_NODE);
+	}
+
+	if (capacity != 0) {
+		InsertFree(NewNode(0, capacity));
+	}
+}
+
+void BlockAllocator::Mapping(uint64_t size, uint32_t& fl, uint32_t& sl) {
+	//Sizes below SL_COUNT get one class each, above that every power of two is split into SL_COUNT classes
+	if (size < SL_COUNT) {
+		fl = 0;
+		sl = static_cast<uint32_t>(size);
+		return;
+	}
+
+	uint32_t highest = HighestBit(size);
+	sl = static_cast<uint32_t>(size >> (highest - SL_BITS)) ^ SL_COUNT;
+	fl = highest - SL_BITS + 1;
+}
+
+uint32_t BlockAllocator::FindFree(uint64_t size) const {
+	//Round up to the next class, so any range found there is guaranteed to fit (good fit, not best fit)
+	if (size >= SL_COUNT) {
+		uint64_t round = (uint64_t(1) << (HighestBit(size) - SL_BITS)) - 1;
+		if (size > UINT64_MAX - round) {
+			return INVALID_NODE;
+		}
+		size += round;
+	}
+
+	uint32_t fl, sl;
+	Mapping(size, fl, sl);
+	if (fl >= FL_COUNT) {
+		return INVALID_NODE;
+	}
+
+	uint32_t sl_candidates = sl_bitmap[fl] & (~0u << sl);
+	if (sl_candidates == 0) {
+		uint64_t fl_candidates = fl + 1 < 64 ? fl_bitmap & (~uint64_t(0) << (fl + 1)) : 0;
+		if (fl_candidates == 0) {
+			return INVALID_NODE;
+		}
+		fl = LowestBit(fl_candidates);
+		sl_candidates = sl_bitmap[fl];
+	}
+
+	return free_lists[fl][LowestBit(sl_candidates)];
+}
+
+uint32_t BlockAllocator::FindFreeInClass(uint64_t size, uint64_t alignment) const {
+	uint32_t fl, sl;
+	Mapping(size, fl, sl);
+
+	for (uint32_t node = free_lists[fl][sl]; node != INVALID_NODE; node = nodes[node].next_free) {
+		uint64_t padding = ((nodes[node].offset + alignment - 1) & ~(alignment - 1)) - nodes[node].offset;
+		if (nodes[node].size >= size && nodes[node].size - size >= padding) {
+			return node;
+		}
+	}
+
+	return INVALID_NODE;
+}
+
+void BlockAllocator::InsertFree(uint32_t node) {
+	uint32_t fl, sl;
+	Mapping(nodes[node].size, fl, sl);
+
+	nodes[node].free = true;
+	nodes[node].prev_free = INVALID_NODE;
+	nodes[node].next_free = free_lists[fl][sl];
+	if (free_lists[fl][sl] != INVALID_NODE) {
+		nodes[free_lists[fl][sl]].prev_free = node;
+	}
+	free_lists[fl][sl] = node;
+
+	fl_bitmap |= uint64_t(1) << fl;
+	sl_bitmap[fl] |= 1u << sl;
+}
+
+void BlockAllocator::RemoveFree(uint32_t node) {
+	uint32_t fl, sl;
+	Mapping(nodes[node].size, fl, sl);
+
+	Node& removed = nodes[node];
+	if (removed.prev_free != INVALID_NODE) {
+		nodes[removed.prev_free].next_free = removed.next_free;
+	}
+	else {
+		free_lists[fl][sl] = removed.next_free;
+	}
+	if (removed.next_free != INVALID_NODE) {
+		nodes[removed.next_free].prev_free = removed.prev_free;
+	}
+	removed.free = false;
+
+	if (free_lists[fl][sl] == INVALID_NODE) {
+		sl_bitmap[fl] &= ~(1u << sl);
+		if (sl_bitmap[fl] == 0) {
+			fl_bitmap &= ~(uint64_t(1) << fl);
+		}
+	}
+}
+
+uint32_t BlockAllocator::NewNode(uint64_t offset, uint64_t size) {
+	Node node = { offset, size, INVALID_NODE, INVALID_NODE, INVALID_NODE, INVALID_NODE, false };
+	if (!unused_nodes.empty()) {
+		uint32_t index = unused_nodes.back();
+		unused_nodes.pop_back();
+		nodes[index] = node;
+		return index;
+	}
+
+	nodes.push_back(node);
+	return static_cast<uint32_t>(nodes.size() - 1);
+}
+
+void BlockAllocator::ReleaseNode(uint32_t node) {
+	//Size 0 marks a node merged into a neighbour, Free rejects it until NewNode reuses the entry
+	nodes[node].size = 0;
+	unused_nodes.push_back(node);
+}
+
+uint32_t BlockAllocator::SplitAfter(uint32_t node, uint64_t size) {
+	//Everything past the first size bytes becomes a new (not yet listed) range
+	uint32_t rest = NewNode(nodes[node].offset + size, nodes[node].size - size);
+	nodes[node].size = size;
+
+	nodes[rest].prev_physical = node;
+	nodes[rest].next_physical = nodes[node].next_physical;
+	if (nodes[rest].next_physical != INVALID_NODE) {
+		nodes[nodes[rest].next_physical].prev_physical = rest;
+	}
+	nodes[node].next_physical = rest;
+
+	return rest;
+}
+
+BlockAllocator::Allocation BlockAllocator::Allocate(uint64_t size, uint64_t alignment) {
+	if (size == 0 || alignment == 0 || (alignment & (alignment - 1)) != 0) {
+		throw std::runtime_error("Allocation needs a size and a power of two alignment");
+	}
+	if (size > capacity) {
+		return Allocation();
+	}
+
+	//Worst case padding is alignment - 1, ask for a range that fits it wherever the range starts.
+	//Near-full blocks may only have a tighter fit left, those are searched for in the exact size class
+	uint32_t node = FindFree(size + alignment - 1);
+	if (node == INVALID_NODE) {
+		node = FindFreeInClass(size, alignment);
+	}
+	if (node == INVALID_NODE) {
+		return Allocation();
+	}
+	RemoveFree(node);
+
+	//Front padding goes back to the free lists. Its left neighbour is in use (free neighbours are always merged)
+	uint64_t padding = ((nodes[node].offset + alignment - 1) & ~(alignment - 1)) - nodes[node].offset;
+	if (padding != 0) {
+		uint32_t aligned = SplitAfter(node, padding);
+		InsertFree(node);
+		node = aligned;
+	}
+
+	if (nodes[node].size > size) {
+		InsertFree(SplitAfter(node, size));
+	}
+
+	used += size;
+	++allocation_count;
+
+	Allocation allocation;
+	allocation.offset = nodes[node].offset;
+	allocation.size = size;
+	allocation.node = node;
+	return allocation;
+}
+
+void BlockAllocator::Free(const Allocation& allocation) {
+	if (!allocation.IsValid()) {
+		return;
+	}
+
+	uint32_t node = allocation.node;
+	if (node >= nodes.size() || nodes[node].free || nodes[node].size == 0 || nodes[node].offset != allocation.offset) {
+		throw std::runtime_error("Freeing a range that is not allocated");
+	}
+
+	used -= nodes[node].size;
+	--allocation_count;
+
+	//Merge with free neighbours so the free lists never hold two adjacent ranges
+	uint32_t next = nodes[node].next_physical;
+	if (next != INVALID_NODE && nodes[next].free) {
+		RemoveFree(next);
+		nodes[node].size += nodes[next].size;
+		nodes[node].next_physical = nodes[next].next_physical;
+		if (nodes[node].next_physical != INVALID_NODE) {
+			nodes[nodes[node].next_physical].prev_physical = node;
+		}
+		ReleaseNode(next);
+	}
+
+	uint32_t prev = nodes[node].prev_physical;
+	if (prev != INVALID_NODE && nodes[prev].free) {
+		RemoveFree(prev);
+		nodes[prev].size += nodes[node].size;
+		nodes[prev].next_physical = nodes[node].next_physical;
+		if (nodes[prev].next_physical != INVALID_NODE) {
+			nodes[nodes[prev].next_physical].prev_physical = prev;
+		}
+		ReleaseNode(node);
+		node = prev;
+	}
+
+	InsertFree(node);
+}
+
+BlockAllocator::Stats BlockAllocator::GetStats() const {
+	Stats stats;
+	stats.capacity = capacity;
+	stats.used = used;
+	stats.allocation_count = allocation_count;
+
+	for (uint32_t fl = 0; fl < FL_COUNT; ++fl) {
+		for (uint32_t sl = 0; sl < SL_COUNT; ++sl) {
+			for (uint32_t node = free_lists[fl][sl]; node != INVALID_NODE; node = nodes[node].next_free) {
+				++stats.free_range_count;
+				stats.largest_free_range = std::max(stats.largest_free_range, nodes[node].size);
+			}
+		}
+	}
+
+	return stats;
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+//Two-level segregated fit (TLSF) sub-allocator for ranges of one block. O(1) allocate and free, no Vulkan in here
+//so the algorithm can be tested and benchmarked on its own (see AllocatorTests)
+class BlockAllocator
+{
+public:
+	static constexpr uint32_t INVALID_NODE = UINT32_MAX;
+
+	struct Allocation {
+		uint64_t offset = 0;
+		uint64_t size = 0;
+		uint32_t node = INVALID_NODE;		//Handle for Free
+
+		bool IsValid() const { return node != INVALID_NODE; }
+	};
+
+	struct Stats {
+		uint64_t capacity = 0;
+		uint64_t used = 0;					//Bytes handed out, alignment padding stays free
+		uint32_t allocation_count = 0;
+		uint32_t free_range_count = 0;
+		uint64_t largest_free_range = 0;
+	};
+
+	explicit BlockAllocator(uint64_t capacity = 0);
+
+	//Forgets every allocation, the whole capacity becomes one free range
+	void Reset(uint64_t capacity);
+
+	//Alignment must be a power of two. Returns an invalid allocation when no free range is big enough
+	Allocation Allocate(uint64_t size, uint64_t alignment = 1);
+	void Free(const Allocation& allocation);
+
+	Stats GetStats() const;
+	uint64_t GetCapacity() const { return capacity; }
+	bool IsEmpty() const { return allocation_count == 0; }
+
+private:
+	static constexpr uint32_t SL_BITS = 4;						//Each power of two range is split into 16 size classes
+	static constexpr uint32_t SL_COUNT = 1 << SL_BITS;
+	static constexpr uint32_t FL_COUNT = 64 - SL_BITS + 1;
+
+	//Ranges in offset order (physical list), free ones also in their size class list
+	struct Node {
+		uint64_t offset;
+		uint64_t size;
+		uint32_t prev_physical;
+		uint32_t next_physical;
+		uint32_t prev_free;
+		uint32_t next_free;
+		bool free;
+	};
+
+	uint64_t capacity = 0;
+	uint64_t used = 0;
+	uint32_t allocation_count = 0;
+
+	std::vector<Node> nodes;
+	std::vector<uint32_t> unused_nodes;					//Recycled entries of nodes
+
+	uint64_t fl_bitmap = 0;								//Bit per first level with any free range
+	uint32_t sl_bitmap[FL_COUNT] = {};					//Bit per size class with any free range
+	uint32_t free_lists[FL_COUNT][SL_COUNT];
+
+	static void Mapping(uint64_t size, uint32_t& fl, uint32_t& sl);
+	uint32_t FindFree(uint64_t size) const;
+	uint32_t FindFreeInClass(uint64_t size, uint64_t alignment) const;
+	void InsertFree(uint32_t node);
+	void RemoveFree(uint32_t node);
+	uint32_t NewNode(uint64_t offset, uint64_t size);
+	void ReleaseNode(uint32_t node);
+	uint32_t SplitAfter(uint32_t node, uint64_t size);
+};
@@ -0,0 +1,134 @@
+#include "CullingBenchmark.h"
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "FrustumCulling.h"
+#include "JobSystem.h"
+#include "Benchmark.h"
+
+namespace {
+	//Objects culled per measurement, so small scenes are repeated enough to time
+	const uint64_t WORK_PER_MEASUREMENT = 50000000;
+
+	//Smallest range one job culls, below this the scheduling costs more than the culling
+	const size_t CULL_GRAIN = 4096;
+
+	//Culls [0, count) iterations times, each frame spread over the job system's threads with ParallelFor. Every range
+	//writes to its own part of the output. Returns ms per frame and the visible count of one frame
+	double TimeCulling(JobSystem& jobs, size_t count, uint64_t iterations, size_t& visible,
+		const std::function<size_t(size_t first, size_t range_count, uint32_t* out)>& cull) {
+		std::vector<uint32_t> output(count);
+		std::atomic<size_t> frame_visible{ 0 };
+
+		BenchClock::time_point start = BenchClock::now();
+		for (uint64_t i = 0; i < iterations; ++i) {
+			frame_visible.store(0, std::memory_order_relaxed);
+			jobs.ParallelFor(count, CULL_GRAIN, [&](size_t begin, size_t end) {
+				frame_visible.fetch_add(cull(begin, end - begin, &output[begin]), std::memory_order_relaxed);
+			});
+		}
+		double ms = ElapsedMs(start) / iterations;
+
+		visible = frame_visible.load();
+		return ms;
+	}
+}
+
+void RunCullingBenchmark(uint64_t max_objects) {
+	//Camera at the origin looking down +z, objects scattered in a cube around it - about a tenth is visible
+	glm::mat4 projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 100.0f);
+	glm::mat4 view = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, -1.0f, 0.0f));
+	Frustum frustum = ExtractFrustum(projection * view);
+
+	std::vector<uint64_t> sizes;
+	for (uint64_t size : { 10000ull, 100000ull, 1000000ull }) {
+		if (size <= max_objects) {
+			sizes.push_back(size);
+		}
+	}
+	if (sizes.empty() || sizes.back() < max_objects) {
+		sizes.push_back(max_objects);
+	}
+
+	std::vector<uint32_t> thread_counts;
+	uint32_t hardware_threads = std::max(1u, std::thread::hardware_concurrency());
+	for (uint32_t threads = 1; threads < hardware_threads; threads *= 2) {
+		thread_counts.push_back(threads);
+	}
+	thread_counts.push_back(hardware_threads);
+
+	std::vector<CullSimd> kernels = { CullSimd::SCALAR, CullSimd::SSE2 };
+	if (BestCullSimd() == CullSimd::AVX) {
+		kernels.push_back(CullSimd::AVX);
+	}
+
+	std::cout << std::fixed << std::setprecision(3)
+		<< "Culling benchmark, ms per frame (reference = glm::vec3 array of structures, the rest structure of arrays):" << std::endl
+		<< "  objects  threads  shape   visible  reference";
+	for (CullSimd kernel : kernels) {
+		std::cout << std::setw(11) << CullSimdName(kernel);
+	}
+	std::cout << "  speedup" << std::endl;
+
+	bool all_matched = true;
+	std::mt19937 random(7);
+	for (uint64_t size : sizes) {
+		std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+		std::uniform_real_distribution<float> extent(0.05f, 2.0f);
+
+		std::vector<BoundingVolume> reference_volumes(size);
+		CullingVolumes volumes;
+		volumes.Reserve(size);
+		for (BoundingVolume& volume : reference_volumes) {
+			volume.centre = glm::vec3(position(random), position(random), position(random));
+			volume.extents = glm::vec3(extent(random), extent(random), extent(random));
+			volume.radius = glm::length(volume.extents);
+			volumes.Add(volume.centre, volume.extents);
+		}
+
+		uint64_t iterations = std::max<uint64_t>(3, WORK_PER_MEASUREMENT / size);
+		for (uint32_t threads : thread_counts) {
+			JobSystem jobs;
+			jobs.Start(threads - 1);		//The calling thread works too
+
+			for (CullShape shape : { CullShape::SPHERE, CullShape::AABB }) {
+				size_t reference_visible = 0;
+				double reference_ms = TimeCulling(jobs, size, iterations, reference_visible,
+					[&](size_t first, size_t range_count, uint32_t* out) {
+						return CullReference(reference_volumes, frustum, shape, first, range_count, out);
+					});
+
+				std::cout << std::setw(9) << size << std::setw(9) << threads << "  " << std::setw(6) << std::left
+					<< (shape == CullShape::SPHERE ? "sphere" : "AABB") << std::right << std::setw(9) << reference_visible
+					<< std::setw(11) << reference_ms;
+
+				double best_ms = reference_ms;
+				for (CullSimd kernel : kernels) {
+					size_t kernel_visible = 0;
+					double kernel_ms = TimeCulling(jobs, size, iterations, kernel_visible,
+						[&](size_t first, size_t range_count, uint32_t* out) {
+							return volumes.Cull(frustum, shape, first, range_count, out, kernel);
+						});
+					best_ms = std::min(best_ms, kernel_ms);
+					std::cout << std::setw(11) << kernel_ms;
+					if (kernel_visible != reference_visible) {
+						std::cout << " MISMATCH";
+						all_matched = false;
+					}
+				}
+				std::cout << std::setw(8) << std::setprecision(1) << reference_ms / best_ms << "x" << std::setprecision(3) << std::endl;
+			}
+		}
+	}
+
+	std::cout << (all_matched ? "All kernels agree with the reference" : "FAILED: a kernel disagrees with the reference") << std::endl;
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+#include <cstdint>
+
+//CPU only timings of the frustum culling kernels, no device needed. Run with --cull-bench <max objects>
+
+//Every kernel of FrustumCulling.h next to the glm::vec3 reference, from 10k objects up to max_objects and from one
+//thread up to every hardware thread. Also checks that every kernel keeps the same objects as the reference
+void RunCullingBenchmark(uint64_t max_objects);
@@ -0,0 +1,281 @@
+#include "DescriptorAllocator.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+	//Sets per pool for each chain. Frame chains reset every frame and rarely need a second pool
+	const uint32_t FRAME_SETS_PER_POOL = 256;
+	const uint32_t CACHE_SETS_PER_POOL = 128;
+
+	//Descriptors of each type a pool gets per set it can hold, sized for an average set. A pool that runs out of one
+	//type is simply left behind for the next one
+	struct PoolRatio {
+		VkDescriptorType type;
+		uint32_t per_set;
+	};
+
+	const PoolRatio POOL_RATIOS[] = {
+		{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2 },
+		{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1 },
+		{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 5 },
+		{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 1 },
+		{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4 },
+		{ VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 4 },
+		{ VK_DESCRIPTOR_TYPE_SAMPLER, 1 },
+		{ VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1 }
+	};
+
+	bool IsBufferType(VkDescriptorType type) {
+		return type == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER || type == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC ||
+			type == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER || type == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+	}
+
+	//Handles are pointers on 64 bit builds and uint64_t on 32 bit ones
+	template<typename T>
+	uint64_t HandleBits(T handle) {
+		uint64_t bits = 0;
+		std::memcpy(&bits, &handle, sizeof(T));
+		return bits;
+	}
+
+	void HashCombine(size_t& seed, uint64_t value) {
+		seed ^= std::hash<uint64_t>()(value) + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2);
+	}
+}
+
+void DescriptorPoolChain::Init(VkDevice logical_device, uint32_t pool_sets) {
+	device = logical_device;
+	sets_per_pool = pool_sets;
+}
+
+void DescriptorPoolChain::Destroy() {
+	for (VkDescriptorPool pool : used_pools) {
+		vkDestroyDescriptorPool(device, pool, nullptr);
+	}
+	for (VkDescriptorPool pool : spare_pools) {
+		vkDestroyDescriptorPool(device, pool, nullptr);
+	}
+	used_pools.clear();
+	spare_pools.clear();
+}
+
+VkDescriptorSet DescriptorPoolChain::Allocate(VkDescriptorSetLayout layout) {
+	VkDescriptorSetAllocateInfo allocate_info = {};
+	allocate_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocate_info.descriptorSetCount = 1;
+	allocate_info.pSetLayouts = &layout;
+
+	//Current pool first, then one that has never been allocated from
+	for (int attempt = 0; attempt < 2; ++attempt) {
+		if (used_pools.empty() || attempt == 1) {
+			used_pools.push_back(NextPool());
+		}
+		allocate_info.descriptorPool = used_pools.back();
+
+		VkDescriptorSet set;
+		VkResult result = vkAllocateDescriptorSets(device, &allocate_info, &set);
+		if (result == VK_SUCCESS) {
+			return set;
+		}
+		if (result != VK_ERROR_OUT_OF_POOL_MEMORY && result != VK_ERROR_FRAGMENTED_POOL) {
+			break;
+		}
+	}
+	throw std::runtime_error("Failed to allocate a descriptor set");
+}
+
+void DescriptorPoolChain::Reset() {
+	for (VkDescriptorPool pool : used_pools) {
+		vkResetDescriptorPool(device, pool, 0);
+		spare_pools.push_back(pool);
+	}
+	used_pools.clear();
+}
+
+VkDescriptorPool DescriptorPoolChain::NextPool() {
+	if (!spare_pools.empty()) {
+		VkDescriptorPool pool = spare_pools.back();
+		spare_pools.pop_back();
+		return pool;
+	}
+
+	std::vector<VkDescriptorPoolSize> pool_sizes;
+	for (const PoolRatio& ratio : POOL_RATIOS) {
+		pool_sizes.push_back({ ratio.type, ratio.per_set * sets_per_pool });
+	}
+
+	//No FREE_DESCRIPTOR_SET_BIT: sets only go back with the whole pool, which lets the driver allocate linearly
+	VkDescriptorPoolCreateInfo pool_create_info = {};
+	pool_create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	pool_create_info.maxSets = sets_per_pool;
+	pool_create_info.poolSizeCount = static_cast<uint32_t>(pool_sizes.size());
+	pool_create_info.pPoolSizes = pool_sizes.data();
+
+	VkDescriptorPool pool;
+	if (vkCreateDescriptorPool(device, &pool_create_info, nullptr, &pool) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create a descriptor pool");
+	}
+	return pool;
+}
+
+void FrameDescriptorAllocator::Init(VkDevice logical_device, uint32_t frames_in_flight) {
+	frames.resize(frames_in_flight);
+	for (DescriptorPoolChain& frame : frames) {
+		frame.Init(logical_device, FRAME_SETS_PER_POOL);
+	}
+}
+
+void FrameDescriptorAllocator::Destroy() {
+	for (DescriptorPoolChain& frame : frames) {
+		frame.Destroy();
+	}
+	frames.clear();
+}
+
+void FrameDescriptorAllocator::BeginFrame(uint32_t frame) {
+	current_frame = frame;
+	frames[current_frame].Reset();
+}
+
+VkDescriptorSet FrameDescriptorAllocator::Allocate(VkDescriptorSetLayout layout) {
+	++allocated_sets;
+	return frames[current_frame].Allocate(layout);
+}
+
+void FrameDescriptorAllocator::PrintStats(std::ostream& out) const {
+	size_t pool_count = 0;
+	for (const DescriptorPoolChain& frame : frames) {
+		pool_count += frame.GetPoolCount();
+	}
+	out << "Frame descriptors: " << allocated_sets << " sets allocated, " << pool_count << " pools over "
+		<< frames.size() << " frames in flight" << std::endl;
+}
+
+DescriptorSetDesc& DescriptorSetDesc::Buffer(uint32_t binding, VkDescriptorType type, VkBuffer buffer, VkDeviceSize offset,
+	VkDeviceSize range) {
+	Binding entry = {};
+	entry.binding = binding;
+	entry.type = type;
+	entry.buffer = { buffer, offset, range };
+	Add(entry);
+	return *this;
+}
+
+DescriptorSetDesc& DescriptorSetDesc::Image(uint32_t binding, VkDescriptorType type, VkImageView view, VkSampler sampler,
+	VkImageLayout image_layout) {
+	Binding entry = {};
+	entry.binding = binding;
+	entry.type = type;
+	entry.image = { sampler, view, image_layout };
+	Add(entry);
+	return *this;
+}
+
+void DescriptorSetDesc::Add(const Binding& entry) {
+	auto position = std::lower_bound(bindings.begin(), bindings.end(), entry.binding,
+		[](const Binding& existing, uint32_t binding) { return existing.binding < binding; });
+	if (position != bindings.end() && position->binding == entry.binding) {
+		*position = entry;		//Rebinding replaces
+		return;
+	}
+	bindings.insert(position, entry);
+}
+
+void DescriptorSetDesc::Write(VkDevice device, VkDescriptorSet set) const {
+	std::vector<VkWriteDescriptorSet> writes(bindings.size());
+	for (size_t i = 0; i < bindings.size(); ++i) {
+		const Binding& entry = bindings[i];
+		writes[i] = {};
+		writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		writes[i].dstSet = set;
+		writes[i].dstBinding = entry.binding;
+		writes[i].descriptorCount = 1;
+		writes[i].descriptorType = entry.type;
+		if (IsBufferType(entry.type)) {
+			writes[i].pBufferInfo = &entry.buffer;
+		}
+		else {
+			writes[i].pImageInfo = &entry.image;
+		}
+	}
+	vkUpdateDescriptorSets(device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+}
+
+bool DescriptorSetDesc::operator==(const DescriptorSetDesc& other) const {
+	if (layout != other.layout || bindings.size() != other.bindings.size()) {
+		return false;
+	}
+
+	for (size_t i = 0; i < bindings.size(); ++i) {
+		const Binding& a = bindings[i];
+		const Binding& b = other.bindings[i];
+		if (a.binding != b.binding || a.type != b.type) {
+			return false;
+		}
+		if (IsBufferType(a.type)) {
+			if (a.buffer.buffer != b.buffer.buffer || a.buffer.offset != b.buffer.offset || a.buffer.range != b.buffer.range) {
+				return false;
+			}
+		}
+		else if (a.image.imageView != b.image.imageView || a.image.sampler != b.image.sampler || a.image.imageLayout != b.image.imageLayout) {
+			return false;
+		}
+	}
+	return true;
+}
+
+size_t DescriptorSetDesc::Hash() const {
+	size_t seed = 0;
+	HashCombine(seed, HandleBits(layout));
+	for (const Binding& entry : bindings) {
+		HashCombine(seed, (static_cast<uint64_t>(entry.binding) << 32) | static_cast<uint32_t>(entry.type));
+		if (IsBufferType(entry.type)) {
+			HashCombine(seed, HandleBits(entry.buffer.buffer));
+			HashCombine(seed, entry.buffer.offset);
+			HashCombine(seed, entry.buffer.range);
+		}
+		else {
+			HashCombine(seed, HandleBits(entry.image.imageView));
+			HashCombine(seed, HandleBits(entry.image.sampler));
+			HashCombine(seed, static_cast<uint64_t>(entry.image.imageLayout));
+		}
+	}
+	return seed;
+}
+
+void DescriptorSetCache::Init(VkDevice logical_device) {
+	device = logical_device;
+	pools.Init(logical_device, CACHE_SETS_PER_POOL);
+}
+
+void DescriptorSetCache::Destroy() {
+	sets.clear();
+	pools.Destroy();
+}
+
+VkDescriptorSet DescriptorSetCache::Get(const DescriptorSetDesc& desc) {
+	auto found = sets.find(desc);
+	if (found != sets.end()) {
+		++stats.hits;
+		return found->second;
+	}
+
+	++stats.misses;
+	VkDescriptorSet set = pools.Allocate(desc.GetLayout());
+	desc.Write(device, set);
+	sets.emplace(desc, set);
+	return set;
+}
+
+void DescriptorSetCache::Reset() {
+	++stats.resets;
+	sets.clear();
+	pools.Reset();
+}
+
+void DescriptorSetCache::PrintStats(std::ostream& out) const {
+	out << "Descriptor set cache: " << sets.size() << " sets, " << stats.hits << " hits, " << stats.misses << " misses, "
+		<< stats.resets << " resets, " << pools.GetPoolCount() << " pools" << std::endl;
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <cstdint>
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+
+//Descriptor sets are never freed one by one. Sets come out of a chain of pools in allocation order and go back all at
+//once when the chain is reset; when a pool runs out the chain moves on to a spare or a new one, so nothing has to be
+//sized up front. Two users:
+//  FrameDescriptorAllocator - sets that live for one frame, one chain per frame in flight, reset when the slot comes round
+//                             (GpuCulling's per-frame output buffers)
+//  DescriptorSetCache       - long-lived sets, looked up by layout and resources so identical sets are only written once
+//Neither is thread safe: they are used by the thread recording the primary command buffer
+
+//Growing list of pools sets are allocated from linearly
+class DescriptorPoolChain
+{
+public:
+	void Init(VkDevice logical_device, uint32_t sets_per_pool);
+	void Destroy();
+
+	//Throws std::runtime_error if a fresh pool can't hold the set either
+	VkDescriptorSet Allocate(VkDescriptorSetLayout layout);
+
+	//Every set allocated so far becomes invalid. The GPU must be done with them
+	void Reset();
+
+	size_t GetPoolCount() const { return used_pools.size() + spare_pools.size(); }
+
+private:
+	VkDevice device = VK_NULL_HANDLE;
+	uint32_t sets_per_pool = 0;
+	std::vector<VkDescriptorPool> used_pools;		//Back is the one being allocated from
+	std::vector<VkDescriptorPool> spare_pools;		//Reset, ready for reuse
+
+	VkDescriptorPool NextPool();
+};
+
+//Sets for one frame: allocate, write, bind and forget. BeginFrame hands the slot's whole chain back in one
+//vkResetDescriptorPool per pool, so the cost per set is a pointer bump in the driver
+class FrameDescriptorAllocator
+{
+public:
+	void Init(VkDevice logical_device, uint32_t frames_in_flight);
+	void Destroy();
+
+	//After the frame slot's fence wait: the sets allocated the last time this slot was used are released
+	void BeginFrame(uint32_t frame);
+	VkDescriptorSet Allocate(VkDescriptorSetLayout layout);
+
+	void PrintStats(std::ostream& out) const;
+
+private:
+	std::vector<DescriptorPoolChain> frames;
+	uint32_t current_frame = 0;
+	uint64_t allocated_sets = 0;
+};
+
+//Layout and bound resources of a set, the key of DescriptorSetCache. One descriptor per binding
+class DescriptorSetDesc
+{
+public:
+	explicit DescriptorSetDesc(VkDescriptorSetLayout layout) : layout(layout) {}
+
+	DescriptorSetDesc& Buffer(uint32_t binding, VkDescriptorType type, VkBuffer buffer, VkDeviceSize offset = 0,
+		VkDeviceSize range = VK_WHOLE_SIZE);
+	DescriptorSetDesc& Image(uint32_t binding, VkDescriptorType type, VkImageView view, VkSampler sampler = VK_NULL_HANDLE,
+		VkImageLayout image_layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+	VkDescriptorSetLayout GetLayout() const { return layout; }
+	void Write(VkDevice device, VkDescriptorSet set) const;
+
+	bool operator==(const DescriptorSetDesc& other) const;
+	size_t Hash() const;
+
+private:
+	struct Binding {
+		uint32_t binding;
+		VkDescriptorType type;
+		VkDescriptorBufferInfo buffer;
+		VkDescriptorImageInfo image;
+	};
+
+	VkDescriptorSetLayout layout;
+	std::vector<Binding> bindings;		//Sorted by binding, so the order they were added in doesn't matter
+
+	void Add(const Binding& binding);
+};
+
+//Long-lived sets by content. Get is cheap enough to call every time a set is bound (a hash lookup), so callers don't
+//keep sets around and an identical set is written once no matter how many frames or users ask for it.
+//Sets are only released by Reset, which must be called once a resource some set refers to is destroyed - a new
+//resource can get the old handle value, and would then hit a set still pointing at the old one
+class DescriptorSetCache
+{
+public:
+	struct Stats {
+		uint64_t hits = 0;
+		uint64_t misses = 0;		//Sets allocated and written
+		uint64_t resets = 0;
+	};
+
+	void Init(VkDevice logical_device);
+	void Destroy();
+
+	VkDescriptorSet Get(const DescriptorSetDesc& desc);
+
+	//Forgets every set. The GPU must be done with them
+	void Reset();
+
+	Stats GetStats() const { return stats; }
+	void PrintStats(std::ostream& out) const;
+
+private:
+	struct DescHash {
+		size_t operator()(const DescriptorSetDesc& desc) const { return desc.Hash(); }
+	};
+
+	VkDevice device = VK_NULL_HANDLE;
+	DescriptorPoolChain pools;
+	std::unordered_map<DescriptorSetDesc, VkDescriptorSet, DescHash> sets;
+	Stats stats;
+};
@@ -0,0 +1,256 @@
+#include "DeviceAllocator.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <stdexcept>
+
+#include "Utilities.h"
+
+namespace {
+	size_t PoolIndex(uint32_t memory_type, ResourceKind kind) {
+		return memory_type * 2 + (kind == ResourceKind::OPTIMAL ? 1 : 0);
+	}
+
+	double ToMiB(VkDeviceSize bytes) {
+		return bytes / (1024.0 * 1024.0);
+	}
+}
+
+void DeviceAllocator::Init(VkPhysicalDevice physical, VkDevice logical, VkDeviceSize preferred_block_size) {
+	physical_device = physical;
+	device = logical;
+	block_size = preferred_block_size;
+	vkGetPhysicalDeviceMemoryProperties(physical_device, &memory_properties);
+
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(physical_device, &properties);
+	non_coherent_atom_size = properties.limits.nonCoherentAtomSize;
+
+	pools.clear();
+	pools.resize(memory_properties.memoryTypeCount * 2);
+}
+
+void DeviceAllocator::Destroy() {
+	std::lock_guard<std::mutex> lock(allocator_mutex);
+
+	for (auto& pool : pools) {
+		for (auto& block : pool.blocks) {
+			vkFreeMemory(device, block->memory, nullptr);		//Unmaps implicitly
+		}
+		pool.blocks.clear();
+	}
+}
+
+VkDeviceSize DeviceAllocator::BlockSizeFor(uint32_t memory_type) const {
+	//Small heaps (e.g. the 256 MiB BAR on some GPUs) get smaller blocks so one block can't take most of it
+	VkDeviceSize heap_size = memory_properties.memoryHeaps[memory_properties.memoryTypes[memory_type].heapIndex].size;
+	return std::min(block_size, heap_size / 8);
+}
+
+VkDeviceMemory DeviceAllocator::AllocateMemory(VkDeviceSize size, uint32_t memory_type, const void* next, void** mapped) {
+	VkMemoryAllocateInfo allocate_info = {};
+	allocate_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocate_info.pNext = next;
+	allocate_info.allocationSize = size;
+	allocate_info.memoryTypeIndex = memory_type;
+
+	VkDeviceMemory memory;
+	if (vkAllocateMemory(device, &allocate_info, nullptr, &memory) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to allocate device memory");
+	}
+	++vk_allocate_calls;
+
+	*mapped = nullptr;
+	if (memory_properties.memoryTypes[memory_type].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+		if (vkMapMemory(device, memory, 0, VK_WHOLE_SIZE, 0, mapped) != VK_SUCCESS) {
+			vkFreeMemory(device, memory, nullptr);
+			throw std::runtime_error("Failed to map device memory");
+		}
+	}
+
+	return memory;
+}
+
+DeviceAllocation DeviceAllocator::Allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties,
+	ResourceKind kind, bool dedicated) {
+	return Allocate(requirements, properties, kind, dedicated, nullptr);
+}
+
+DeviceAllocation DeviceAllocator::Allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties,
+	ResourceKind kind, bool dedicated, const VkMemoryDedicatedAllocateInfo* dedicated_info) {
+	uint32_t memory_type = FindMemoryTypeIndex(physical_device, requirements.memoryTypeBits, properties);
+
+	std::lock_guard<std::mutex> lock(allocator_mutex);
+
+	DeviceAllocation allocation;
+	allocation.memory_type = memory_type;
+	allocation.size = requirements.size;
+
+	//Anything bigger than half a block would waste most of a new one
+	VkDeviceSize pool_block_size = BlockSizeFor(memory_type);
+	if (dedicated || requirements.size > pool_block_size / 2) {
+		allocation.memory = AllocateMemory(requirements.size, memory_type, dedicated_info, &allocation.mapped);
+		++dedicated_count;
+		dedicated_bytes += requirements.size;
+		return allocation;
+	}
+
+	allocation.pool = PoolIndex(memory_type, kind);
+	Pool& pool = pools[allocation.pool];
+
+	for (size_t i = 0; i < pool.blocks.size(); ++i) {
+		BlockAllocator::Allocation range = pool.blocks[i]->ranges.Allocate(requirements.size, requirements.alignment);
+		if (range.IsValid()) {
+			allocation.block = i;
+			allocation.range = range;
+			break;
+		}
+	}
+
+	if (!allocation.range.IsValid()) {
+		auto block = std::make_unique<Block>();
+		block->memory = AllocateMemory(pool_block_size, memory_type, nullptr, &block->mapped);
+		block->ranges.Reset(pool_block_size);
+
+		allocation.block = pool.blocks.size();
+		allocation.range = block->ranges.Allocate(requirements.size, requirements.alignment);
+		pool.blocks.push_back(std::move(block));
+	}
+
+	Block& block = *pool.blocks[allocation.block];
+	allocation.memory = block.memory;
+	allocation.offset = allocation.range.offset;
+	if (block.mapped != nullptr) {
+		allocation.mapped = static_cast<char*>(block.mapped) + allocation.offset;
+	}
+
+	return allocation;
+}
+
+void DeviceAllocator::Free(DeviceAllocation& allocation) {
+	if (allocation.memory == VK_NULL_HANDLE) {
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(allocator_mutex);
+
+	if (allocation.IsDedicated()) {
+		vkFreeMemory(device, allocation.memory, nullptr);
+		--dedicated_count;
+		dedicated_bytes -= allocation.size;
+	}
+	else {
+		//Empty blocks are kept - a level load frees and reallocates the same amount right after
+		pools[allocation.pool].blocks[allocation.block]->ranges.Free(allocation.range);
+	}
+
+	allocation = DeviceAllocation();
+}
+
+DeviceAllocation DeviceAllocator::AllocateForBuffer(VkBuffer buffer, VkMemoryPropertyFlags properties) {
+	VkMemoryDedicatedRequirements dedicated_requirements = {};
+	dedicated_requirements.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS;
+
+	VkMemoryRequirements2 requirements = {};
+	requirements.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+	requirements.pNext = &dedicated_requirements;
+
+	VkBufferMemoryRequirementsInfo2 requirements_info = {};
+	requirements_info.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_REQUIREMENTS_INFO_2;
+	requirements_info.buffer = buffer;
+	vkGetBufferMemoryRequirements2(device, &requirements_info, &requirements);
+
+	//The driver can place memory it knows belongs to one buffer better (e.g. render targets)
+	VkMemoryDedicatedAllocateInfo dedicated_info = {};
+	dedicated_info.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO;
+	dedicated_info.buffer = buffer;
+
+	bool dedicated = dedicated_requirements.prefersDedicatedAllocation || dedicated_requirements.requiresDedicatedAllocation;
+	DeviceAllocation allocation = Allocate(requirements.memoryRequirements, properties, ResourceKind::LINEAR, dedicated,
+		dedicated ? &dedicated_info : nullptr);
+
+	if (vkBindBufferMemory(device, buffer, allocation.memory, allocation.offset) != VK_SUCCESS) {
+		Free(allocation);
+		throw std::runtime_error("Failed to bind buffer memory");
+	}
+
+	return allocation;
+}
+
+DeviceAllocation DeviceAllocator::AllocateForImage(VkImage image, VkMemoryPropertyFlags properties, ResourceKind kind) {
+	VkMemoryDedicatedRequirements dedicated_requirements = {};
+	dedicated_requirements.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS;
+
+	VkMemoryRequirements2 requirements = {};
+	requirements.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+	requirements.pNext = &dedicated_requirements;
+
+	VkImageMemoryRequirementsInfo2 requirements_info = {};
+	requirements_info.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_REQUIREMENTS_INFO_2;
+	requirements_info.image = image;
+	vkGetImageMemoryRequirements2(device, &requirements_info, &requirements);
+
+	//The driver can place memory it knows belongs to one image better (e.g. render targets)
+	VkMemoryDedicatedAllocateInfo dedicated_info = {};
+	dedicated_info.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO;
+	dedicated_info.image = image;
+
+	bool dedicated = dedicated_requirements.prefersDedicatedAllocation || dedicated_requirements.requiresDedicatedAllocation;
+	DeviceAllocation allocation = Allocate(requirements.memoryRequirements, properties, kind, dedicated,
+		dedicated ? &dedicated_info : nullptr);
+
+	if (vkBindImageMemory(device, image, allocation.memory, allocation.offset) != VK_SUCCESS) {
+		Free(allocation);
+		throw std::runtime_error("Failed to bind image memory");
+	}
+
+	return allocation;
+}
+
+void DeviceAllocator::Flush(const DeviceAllocation& allocation, VkDeviceSize offset, VkDeviceSize size) {
+	if (memory_properties.memoryTypes[allocation.memory_type].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) {
+		return;
+	}
+
+	//Flushed ranges have to be aligned to nonCoherentAtomSize. Blocks are a multiple of it, so rounding out stays
+	//inside the memory, dedicated allocations flush to the end instead of past it
+	VkDeviceSize start = (allocation.offset + offset) / non_coherent_atom_size * non_coherent_atom_size;
+	VkDeviceSize end = size == VK_WHOLE_SIZE ? allocation.offset + allocation.size : allocation.offset + offset + size;
+	end = (end + non_coherent_atom_size - 1) / non_coherent_atom_size * non_coherent_atom_size;
+
+	VkMappedMemoryRange range = {};
+	range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+	range.memory = allocation.memory;
+	range.offset = start;
+	range.size = allocation.IsDedicated() && end >= allocation.size ? VK_WHOLE_SIZE : end - start;
+	vkFlushMappedMemoryRanges(device, 1, &range);
+}
+
+DeviceAllocator::Stats DeviceAllocator::GetStats() const {
+	std::lock_guard<std::mutex> lock(allocator_mutex);
+
+	Stats stats;
+	for (const auto& pool : pools) {
+		for (const auto& block : pool.blocks) {
+			BlockAllocator::Stats block_stats = block->ranges.GetStats();
+			++stats.block_count;
+			stats.block_bytes += block_stats.capacity;
+			stats.used_bytes += block_stats.used;
+			stats.sub_allocation_count += block_stats.allocation_count;
+		}
+	}
+	stats.dedicated_count = dedicated_count;
+	stats.dedicated_bytes = dedicated_bytes;
+	stats.vk_allocate_calls = vk_allocate_calls;
+
+	return stats;
+}
+
+void DeviceAllocator::PrintStats(std::ostream& out) const {
+	Stats stats = GetStats();
+	out << std::fixed << std::setprecision(1)
+		<< "Device memory: " << stats.sub_allocation_count << " sub-allocations using " << ToMiB(stats.used_bytes)
+		<< " of " << ToMiB(stats.block_bytes) << " MiB in " << stats.block_count << " blocks, "
+		<< stats.dedicated_count << " dedicated (" << ToMiB(stats.dedicated_bytes) << " MiB), "
+		<< stats.vk_allocate_calls << " vkAllocateMemory calls" << std::endl;
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+#include "BlockAllocator.h"
+
+//Buffers and linear images never share a block with optimal tiling images,
+//so bufferImageGranularity can't make neighbouring resources alias
+enum class ResourceKind { LINEAR, OPTIMAL };
+
+struct DeviceAllocation {
+	VkDeviceMemory memory = VK_NULL_HANDLE;
+	VkDeviceSize offset = 0;
+	VkDeviceSize size = 0;
+	void* mapped = nullptr;					//Host visible memory stays mapped for its whole life
+	uint32_t memory_type = 0;
+
+	//Where it came from, for Free
+	size_t pool = SIZE_MAX;					//SIZE_MAX = dedicated allocation
+	size_t block = 0;
+	BlockAllocator::Allocation range;
+
+	bool IsDedicated() const { return pool == SIZE_MAX; }
+};
+
+//Allocates large blocks per memory type and sub-allocates resources from them with BlockAllocator.
+//Large resources, and the ones the driver asks for, get a dedicated allocation. Thread safe
+class DeviceAllocator
+{
+public:
+	struct Stats {
+		uint32_t block_count = 0;
+		VkDeviceSize block_bytes = 0;
+		VkDeviceSize used_bytes = 0;		//Sub-allocated from blocks
+		uint32_t sub_allocation_count = 0;
+		uint32_t dedicated_count = 0;
+		VkDeviceSize dedicated_bytes = 0;
+		uint64_t vk_allocate_calls = 0;		//Over the allocator's lifetime
+	};
+
+	static const VkDeviceSize DEFAULT_BLOCK_SIZE = 64ull * 1024 * 1024;
+
+	void Init(VkPhysicalDevice physical_device, VkDevice logical_device, VkDeviceSize block_size = DEFAULT_BLOCK_SIZE);
+	void Destroy();
+
+	DeviceAllocation Allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties,
+		ResourceKind kind, bool dedicated = false);
+	void Free(DeviceAllocation& allocation);
+
+	//Allocate with the requirements of the resource (including the driver's dedicated hint) and bind it
+	DeviceAllocation AllocateForBuffer(VkBuffer buffer, VkMemoryPropertyFlags properties);
+	DeviceAllocation AllocateForImage(VkImage image, VkMemoryPropertyFlags properties, ResourceKind kind = ResourceKind::OPTIMAL);
+
+	//Needed after writing to mapped memory that isn't host coherent
+	void Flush(const DeviceAllocation& allocation, VkDeviceSize offset = 0, VkDeviceSize size = VK_WHOLE_SIZE);
+
+	Stats GetStats() const;
+	void PrintStats(std::ostream& out) const;
+
+private:
+	struct Block {
+		VkDeviceMemory memory;
+		void* mapped;
+		BlockAllocator ranges;
+	};
+
+	//One pool per memory type and resource kind
+	struct Pool {
+		std::vector<std::unique_ptr<Block>> blocks;
+	};
+
+	VkPhysicalDevice physical_device = VK_NULL_HANDLE;
+	VkDevice device = VK_NULL_HANDLE;
+	VkPhysicalDeviceMemoryProperties memory_properties = {};
+	VkDeviceSize non_coherent_atom_size = 1;
+	VkDeviceSize block_size = DEFAULT_BLOCK_SIZE;
+
+	std::vector<Pool> pools;
+	uint32_t dedicated_count = 0;
+	VkDeviceSize dedicated_bytes = 0;
+	uint64_t vk_allocate_calls = 0;
+	mutable std::mutex allocator_mutex;
+
+	DeviceAllocation Allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties,
+		ResourceKind kind, bool dedicated, const VkMemoryDedicatedAllocateInfo* dedicated_info);
+	VkDeviceMemory AllocateMemory(VkDeviceSize size, uint32_t memory_type, const void* next, void** mapped);
+	VkDeviceSize BlockSizeFor(uint32_t memory_type) const;
+};
@@ -0,0 +1,174 @@
+#include "DeviceSelection.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+
+const std::vector<const char*> optional_device_extensions = {
+	"VK_EXT_memory_budget",
+	"VK_EXT_memory_priority"
+};
+
+namespace {
+	const VkDeviceSize MIB = 1024 * 1024;
+
+	//Type score is larger than everything else combined, so a discrete GPU always beats an integrated one
+	long long TypeScore(VkPhysicalDeviceType type) {
+		switch (type) {
+		case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:		return 100000;
+		case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:	return 50000;
+		case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:		return 25000;
+		case VK_PHYSICAL_DEVICE_TYPE_CPU:				return 10000;
+		default:										return 0;
+		}
+	}
+
+	std::string ToLower(std::string text) {
+		std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+		return text;
+	}
+}
+
+DeviceCandidate DescribeDevice(VkPhysicalDevice device) {
+	DeviceCandidate candidate;
+	candidate.device = device;
+	vkGetPhysicalDeviceProperties(device, &candidate.properties);
+	vkGetPhysicalDeviceFeatures(device, &candidate.features);
+
+	//Device UUID is core from 1.1, older drivers just can't be picked by UUID
+	if (candidate.properties.apiVersion >= VK_API_VERSION_1_1) {
+		VkPhysicalDeviceIDProperties id_properties = {};
+		id_properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES;
+
+		VkPhysicalDeviceProperties2 properties2 = {};
+		properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+		properties2.pNext = &id_properties;
+		vkGetPhysicalDeviceProperties2(device, &properties2);
+
+		std::memcpy(candidate.device_uuid, id_properties.deviceUUID, VK_UUID_SIZE);
+	}
+
+	VkPhysicalDeviceMemoryProperties memory_properties;
+	vkGetPhysicalDeviceMemoryProperties(device, &memory_properties);
+	for (uint32_t i = 0; i < memory_properties.memoryHeapCount; ++i) {
+		if (memory_properties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) {
+			candidate.device_local_memory = std::max(candidate.device_local_memory, memory_properties.memoryHeaps[i].size);
+		}
+	}
+
+	uint32_t extension_count = 0;
+	vkEnumerateDeviceExtensionProperties(device, nullptr, &extension_count, nullptr);
+	std::vector<VkExtensionProperties> extensions(extension_count);
+	vkEnumerateDeviceExtensionProperties(device, nullptr, &extension_count, extensions.data());
+	for (const char* optional_extension : optional_device_extensions) {
+		for (const auto& extension : extensions) {
+			if (strcmp(optional_extension, extension.extensionName) == 0) {
+				++candidate.optional_extension_count;
+				break;
+			}
+		}
+	}
+
+	uint32_t queue_family_count = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(device, &queue_family_count, nullptr);
+	std::vector<VkQueueFamilyProperties> queue_family_list(queue_family_count);
+	vkGetPhysicalDeviceQueueFamilyProperties(device, &queue_family_count, queue_family_list.data());
+	for (const auto& queue_family : queue_family_list) {
+		if (queue_family.queueCount == 0) {
+			continue;
+		}
+
+		//Dedicated = runs next to graphics instead of sharing its queues
+		bool graphics = queue_family.queueFlags & VK_QUEUE_GRAPHICS_BIT;
+		bool compute = queue_family.queueFlags & VK_QUEUE_COMPUTE_BIT;
+		if (!graphics && compute) {
+			candidate.dedicated_compute_family = true;
+		}
+		if (!graphics && !compute && (queue_family.queueFlags & VK_QUEUE_TRANSFER_BIT)) {
+			candidate.dedicated_transfer_family = true;
+		}
+	}
+
+	return candidate;
+}
+
+DeviceScore ScoreDevice(const DeviceCandidate& candidate) {
+	DeviceScore score;
+	auto add = [&score](long long points, const std::string& reason) {
+		score.total += points;
+		score.reasons.push_back("+" + std::to_string(points) + " " + reason);
+	};
+
+	add(TypeScore(candidate.properties.deviceType), DeviceTypeName(candidate.properties.deviceType));
+
+	//1 point per 64 MiB, capped at 32 GiB so memory never outweighs the device type
+	VkDeviceSize memory_mib = candidate.device_local_memory / MIB;
+	add(static_cast<long long>(std::min<VkDeviceSize>(memory_mib, 32 * 1024) / 64), std::to_string(memory_mib) + " MiB device local");
+
+	//Features later work can take advantage of
+	const VkPhysicalDeviceFeatures& features = candidate.features;
+	int feature_count = (features.multiDrawIndirect ? 1 : 0) + (features.drawIndirectFirstInstance ? 1 : 0) +
+		(features.samplerAnisotropy ? 1 : 0) + (features.shaderInt16 ? 1 : 0);
+	if (feature_count > 0) {
+		add(feature_count * 50, std::to_string(feature_count) + " optional features");
+	}
+	if (candidate.optional_extension_count > 0) {
+		add(candidate.optional_extension_count * 50, std::to_string(candidate.optional_extension_count) + " optional extensions");
+	}
+
+	if (candidate.unified_graphics_present) {
+		add(200, "graphics+present family");
+	}
+	if (candidate.dedicated_transfer_family) {
+		add(100, "dedicated transfer family");
+	}
+	if (candidate.dedicated_compute_family) {
+		add(100, "dedicated compute family");
+	}
+
+	return score;
+}
+
+bool MatchesDeviceOverride(const DeviceCandidate& candidate, const std::string& device_override) {
+	std::string hex;
+	for (char c : device_override) {
+		if (c != '-') {
+			hex += static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+		}
+	}
+
+	bool is_uuid = hex.size() == VK_UUID_SIZE * 2 &&
+		std::all_of(hex.begin(), hex.end(), [](unsigned char c) { return std::isxdigit(c) != 0; });
+	if (is_uuid) {
+		std::string device_hex = FormatUuid(candidate.device_uuid);
+		device_hex.erase(std::remove(device_hex.begin(), device_hex.end(), '-'), device_hex.end());
+		return hex == device_hex;
+	}
+
+	return ToLower(candidate.properties.deviceName).find(ToLower(device_override)) != std::string::npos;
+}
+
+std::string DeviceTypeName(VkPhysicalDeviceType type) {
+	switch (type) {
+	case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:		return "discrete GPU";
+	case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:	return "integrated GPU";
+	case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:		return "virtual GPU";
+	case VK_PHYSICAL_DEVICE_TYPE_CPU:				return "CPU";
+	default:										return "other device";
+	}
+}
+
+std::string FormatUuid(const uint8_t (&uuid)[VK_UUID_SIZE]) {
+	//8-4-4-4-12 like every other tool prints them
+	std::string text;
+	char byte_text[3];
+	for (int i = 0; i < VK_UUID_SIZE; ++i) {
+		if (i == 4 || i == 6 || i == 8 || i == 10) {
+			text += '-';
+		}
+		std::snprintf(byte_text, sizeof(byte_text), "%02x", uuid[i]);
+		text += byte_text;
+	}
+	return text;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <string>
+#include <vector>
+
+//Everything the selection policy looks at for one physical device
+struct DeviceCandidate {
+	VkPhysicalDevice device = VK_NULL_HANDLE;
+	VkPhysicalDeviceProperties properties = {};
+	VkPhysicalDeviceFeatures features = {};
+	uint8_t device_uuid[VK_UUID_SIZE] = {};		//Stable across runs, unlike the enumeration order
+	VkDeviceSize device_local_memory = 0;		//Size of the largest device local heap
+	uint32_t optional_extension_count = 0;		//How many of optional_device_extensions are supported
+	bool dedicated_transfer_family = false;
+	bool dedicated_compute_family = false;
+
+	//Filled in by the renderer, they depend on the surface
+	bool suitable = false;
+	bool unified_graphics_present = false;		//One queue family can both draw and present
+};
+
+struct DeviceScore {
+	long long total = 0;
+	std::vector<std::string> reasons;		//What each part of the score came from, for the log
+};
+
+//Extensions that aren't required but make a device more attractive
+extern const std::vector<const char*> optional_device_extensions;
+
+//Queries properties, features, memory heaps, extensions and queue families (no surface needed)
+DeviceCandidate DescribeDevice(VkPhysicalDevice device);
+
+//Device type dominates, then memory, features, extensions and queue layout
+DeviceScore ScoreDevice(const DeviceCandidate& candidate);
+
+//Override is either a device UUID (32 hex digits, dashes allowed) or part of the device name (case insensitive)
+bool MatchesDeviceOverride(const DeviceCandidate& candidate, const std::string& device_override);
+
+std::string DeviceTypeName(VkPhysicalDeviceType type);
+std::string FormatUuid(const uint8_t (&uuid)[VK_UUID_SIZE]);
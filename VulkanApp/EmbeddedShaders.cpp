@@ -0,0 +1,45 @@
+#include "EmbeddedShaders.h"
+
+#include <cstdint>
+#include <iterator>
+
+//Generated arrays have internal linkage, include them in this file only.
+//None of them are tracked, Shaders/shader_compile.bat writes all of them in the pre-build step
+#if !__has_include("Shaders/Generated/vert_spv.h") || !__has_include("Shaders/Generated/quantized_vert_spv.h") || \
+	!__has_include("Shaders/Generated/frag_spv.h") || !__has_include("Shaders/Generated/bindless_frag_spv.h") || \
+	!__has_include("Shaders/Generated/cull_comp_spv.h")
+#error "Embedded shader headers are missing, run Shaders/shader_compile.bat (the pre-build step) first"
+#endif
+#include "Shaders/Generated/vert_spv.h"
+#include "Shaders/Generated/quantized_vert_spv.h"
+#include "Shaders/Generated/frag_spv.h"
+#include "Shaders/Generated/bindless_frag_spv.h"
+#include "Shaders/Generated/cull_comp_spv.h"
+
+namespace {
+	constexpr SpirvView MakeView(const uint32_t* words, size_t size) {
+		SpirvView view;
+		view.words = words;
+		view.size = size;
+		return view;
+	}
+
+	//Lives in static read-only data, no load or copy at startup
+	constexpr EmbeddedShader embedded_shaders[] = {
+		{ "vert", MakeView(vert_spv, sizeof(vert_spv)) },
+		{ "quantized_vert", MakeView(quantized_vert_spv, sizeof(quantized_vert_spv)) },
+		{ "frag", MakeView(frag_spv, sizeof(frag_spv)) },
+		{ "bindless_frag", MakeView(bindless_frag_spv, sizeof(bindless_frag_spv)) },
+		{ "cull_comp", MakeView(cull_comp_spv, sizeof(cull_comp_spv)) },
+	};
+}
+
+const EmbeddedShader* FindEmbeddedShader(std::string_view name) {
+	for (const auto& shader : embedded_shaders) {
+		if (shader.name == name) {
+			return &shader;
+		}
+	}
+
+	return nullptr;
+}
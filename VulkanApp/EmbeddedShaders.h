@@ -0,0 +1,14 @@
+#pragma once
+
+#include <string_view>
+
+#include "ShaderFile.h"
+
+//SPIR-V compiled into the executable by shader_compile.bat (pre-build step, outputs are not tracked), keyed by the .spv file name
+struct EmbeddedShader {
+	std::string_view name;
+	SpirvView code;
+};
+
+//nullptr when no shader with that name was embedded
+const EmbeddedShader* FindEmbeddedShader(std::string_view name);
@@ -0,0 +1,265 @@
+#include "FrustumCulling.h"
+
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <immintrin.h>
+#define FRUSTUM_CULLING_SSE2
+//AVX is not part of the baseline: its kernel is compiled for AVX on its own and only called after a runtime check
+#define FRUSTUM_CULLING_AVX
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define AVX_TARGET
+#else
+#define AVX_TARGET __attribute__((target("avx")))
+#endif
+#endif
+
+namespace {
+	//Extra floats after the last volume, so 8 wide loads starting at any volume stay inside the arrays
+	const size_t PADDING = 8;
+
+	//Same operation order in every kernel, so they all agree bit for bit with CullReference
+	inline bool IsVisible(const Frustum& frustum, CullShape shape, const glm::vec3& centre, const glm::vec3& extents, float radius) {
+		for (const glm::vec4& plane : frustum.planes) {
+			glm::vec3 normal = glm::vec3(plane);
+			float distance = glm::dot(normal, centre) + plane.w;
+			if (shape == CullShape::SPHERE ? distance < -radius : distance + glm::dot(glm::abs(normal), extents) < 0.0f) {
+				return false;
+			}
+		}
+		return true;
+	}
+}
+
+Frustum ExtractFrustum(const glm::mat4& view_projection) {
+	//Gribb/Hartmann on the rows of the matrix (glm is column major), clip space z runs from 0 to w
+	glm::mat4 m = glm::transpose(view_projection);
+	Frustum frustum;
+	frustum.planes[0] = m[3] + m[0];	//Left
+	frustum.planes[1] = m[3] - m[0];	//Right
+	frustum.planes[2] = m[3] + m[1];	//Bottom (top on screen, y points down)
+	frustum.planes[3] = m[3] - m[1];
+	frustum.planes[4] = m[2];			//Near
+	frustum.planes[5] = m[3] - m[2];	//Far
+
+	for (glm::vec4& plane : frustum.planes) {
+		plane /= glm::length(glm::vec3(plane));
+	}
+	return frustum;
+}
+
+void CullingVolumes::Reserve(size_t reserve_count) {
+	for (std::vector<float>* field : { &centre_x, &centre_y, &centre_z, &extent_x, &extent_y, &extent_z, &radius }) {
+		field->reserve(reserve_count + PADDING);
+	}
+}
+
+void CullingVolumes::Clear() {
+	Resize(0);
+}
+
+void CullingVolumes::Resize(size_t new_count) {
+	count = new_count;
+	for (std::vector<float>* field : { &centre_x, &centre_y, &centre_z, &extent_x, &extent_y, &extent_z, &radius }) {
+		field->resize(count + PADDING, 0.0f);
+	}
+}
+
+uint32_t CullingVolumes::Add(const glm::vec3& centre, const glm::vec3& extents) {
+	uint32_t index = static_cast<uint32_t>(count);
+	Resize(count + 1);
+	Set(index, centre, extents);
+	return index;
+}
+
+void CullingVolumes::Set(uint32_t index, const glm::vec3& centre, const glm::vec3& extents) {
+	centre_x[index] = centre.x;
+	centre_y[index] = centre.y;
+	centre_z[index] = centre.z;
+	extent_x[index] = extents.x;
+	extent_y[index] = extents.y;
+	extent_z[index] = extents.z;
+	radius[index] = glm::length(extents);
+}
+
+size_t CullingVolumes::Cull(const Frustum& frustum, CullShape shape, size_t first, size_t range_count, uint32_t* visible,
+	CullSimd simd) const {
+	range_count = std::min(range_count, count - std::min(first, count));
+	if (simd == CullSimd::BEST) {
+		simd = BestCullSimd();
+	}
+
+	switch (simd) {
+#ifdef FRUSTUM_CULLING_SSE2
+	case CullSimd::SSE2:
+		return CullSse2(frustum, shape, first, range_count, visible);
+#endif
+#ifdef FRUSTUM_CULLING_AVX
+	case CullSimd::AVX:
+		//Asking for AVX on a CPU without it gets the widest kernel it has
+		if (BestCullSimd() == CullSimd::AVX) {
+			return CullAvx(frustum, shape, first, range_count, visible);
+		}
+		return CullSse2(frustum, shape, first, range_count, visible);
+#endif
+	default:
+		break;
+	}
+	return CullScalar(frustum, shape, first, range_count, visible);
+}
+
+size_t CullingVolumes::CullScalar(const Frustum& frustum, CullShape shape, size_t first, size_t range_count, uint32_t* visible) const {
+	size_t written = 0;
+	for (size_t i = first; i < first + range_count; ++i) {
+		glm::vec3 centre(centre_x[i], centre_y[i], centre_z[i]);
+		glm::vec3 extents(extent_x[i], extent_y[i], extent_z[i]);
+		if (IsVisible(frustum, shape, centre, extents, radius[i])) {
+			visible[written++] = static_cast<uint32_t>(i);
+		}
+	}
+	return written;
+}
+
+#ifdef FRUSTUM_CULLING_SSE2
+size_t CullingVolumes::CullSse2(const Frustum& frustum, CullShape shape, size_t first, size_t range_count, uint32_t* visible) const {
+	const __m128 sign_mask = _mm_set1_ps(-0.0f);
+	size_t written = 0;
+	size_t end = first + range_count;
+
+	for (size_t i = first; i < end; i += 4) {
+		__m128 cx = _mm_loadu_ps(&centre_x[i]);
+		__m128 cy = _mm_loadu_ps(&centre_y[i]);
+		__m128 cz = _mm_loadu_ps(&centre_z[i]);
+		__m128 ex = _mm_loadu_ps(&extent_x[i]);
+		__m128 ey = _mm_loadu_ps(&extent_y[i]);
+		__m128 ez = _mm_loadu_ps(&extent_z[i]);
+		__m128 negative_radius = _mm_xor_ps(_mm_loadu_ps(&radius[i]), sign_mask);
+
+		//Lanes outside any plane, no early out - six planes are cheaper than the branches
+		__m128 culled = _mm_setzero_ps();
+		for (const glm::vec4& plane : frustum.planes) {
+			__m128 px = _mm_set1_ps(plane.x);
+			__m128 py = _mm_set1_ps(plane.y);
+			__m128 pz = _mm_set1_ps(plane.z);
+			__m128 distance = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(px, cx), _mm_mul_ps(py, cy)), _mm_mul_ps(pz, cz)), _mm_set1_ps(plane.w));
+			if (shape == CullShape::SPHERE) {
+				culled = _mm_or_ps(culled, _mm_cmplt_ps(distance, negative_radius));
+			}
+			else {
+				__m128 reach = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_andnot_ps(sign_mask, px), ex), _mm_mul_ps(_mm_andnot_ps(sign_mask, py), ey)),
+					_mm_mul_ps(_mm_andnot_ps(sign_mask, pz), ez));
+				culled = _mm_or_ps(culled, _mm_cmplt_ps(_mm_add_ps(distance, reach), _mm_setzero_ps()));
+			}
+		}
+
+		int mask = ~_mm_movemask_ps(culled);
+		size_t lanes = std::min<size_t>(4, end - i);
+		for (size_t lane = 0; lane < lanes; ++lane) {
+			visible[written] = static_cast<uint32_t>(i + lane);
+			written += (mask >> lane) & 1;
+		}
+	}
+	return written;
+}
+#else
+size_t CullingVolumes::CullSse2(const Frustum& frustum, CullShape shape, size_t first, size_t range_count, uint32_t* visible) const {
+	return CullScalar(frustum, shape, first, range_count, visible);
+}
+#endif
+
+#ifdef FRUSTUM_CULLING_AVX
+AVX_TARGET size_t CullingVolumes::CullAvx(const Frustum& frustum, CullShape shape, size_t first, size_t range_count, uint32_t* visible) const {
+	const __m256 sign_mask = _mm256_set1_ps(-0.0f);
+	size_t written = 0;
+	size_t end = first + range_count;
+
+	//The SSE2 kernel with 8 lanes. Only float arithmetic is needed, which AVX already has at this width
+	for (size_t i = first; i < end; i += 8) {
+		__m256 cx = _mm256_loadu_ps(&centre_x[i]);
+		__m256 cy = _mm256_loadu_ps(&centre_y[i]);
+		__m256 cz = _mm256_loadu_ps(&centre_z[i]);
+		__m256 ex = _mm256_loadu_ps(&extent_x[i]);
+		__m256 ey = _mm256_loadu_ps(&extent_y[i]);
+		__m256 ez = _mm256_loadu_ps(&extent_z[i]);
+		__m256 negative_radius = _mm256_xor_ps(_mm256_loadu_ps(&radius[i]), sign_mask);
+
+		__m256 culled = _mm256_setzero_ps();
+		for (const glm::vec4& plane : frustum.planes) {
+			__m256 px = _mm256_set1_ps(plane.x);
+			__m256 py = _mm256_set1_ps(plane.y);
+			__m256 pz = _mm256_set1_ps(plane.z);
+			__m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(px, cx), _mm256_mul_ps(py, cy)), _mm256_mul_ps(pz, cz)),
+				_mm256_set1_ps(plane.w));
+			if (shape == CullShape::SPHERE) {
+				culled = _mm256_or_ps(culled, _mm256_cmp_ps(distance, negative_radius, _CMP_LT_OQ));
+			}
+			else {
+				__m256 reach = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_andnot_ps(sign_mask, px), ex), _mm256_mul_ps(_mm256_andnot_ps(sign_mask, py), ey)),
+					_mm256_mul_ps(_mm256_andnot_ps(sign_mask, pz), ez));
+				culled = _mm256_or_ps(culled, _mm256_cmp_ps(_mm256_add_ps(distance, reach), _mm256_setzero_ps(), _CMP_LT_OQ));
+			}
+		}
+
+		int mask = ~_mm256_movemask_ps(culled);
+		size_t lanes = std::min<size_t>(8, end - i);
+		for (size_t lane = 0; lane < lanes; ++lane) {
+			visible[written] = static_cast<uint32_t>(i + lane);
+			written += (mask >> lane) & 1;
+		}
+	}
+	return written;
+}
+#else
+size_t CullingVolumes::CullAvx(const Frustum& frustum, CullShape shape, size_t first, size_t range_count, uint32_t* visible) const {
+	return CullSse2(frustum, shape, first, range_count, visible);
+}
+#endif
+
+CullSimd BestCullSimd() {
+#ifdef FRUSTUM_CULLING_AVX
+	static const bool has_avx = [] {
+#if defined(_MSC_VER) && !defined(__clang__)
+		//CPU support (leaf 1 ECX bit 28) and the OS saving the YMM registers (OSXSAVE, XCR0 bits 1 and 2)
+		int registers[4];
+		__cpuid(registers, 1);
+		bool cpu_avx = (registers[2] & (1 << 28)) != 0;
+		bool os_xsave = (registers[2] & (1 << 27)) != 0;
+		return cpu_avx && os_xsave && (_xgetbv(0) & 6) == 6;
+#else
+		return __builtin_cpu_supports("avx") != 0;		//Includes the OS check
+#endif
+	}();
+	if (has_avx) {
+		return CullSimd::AVX;
+	}
+#endif
+#ifdef FRUSTUM_CULLING_SSE2
+	return CullSimd::SSE2;
+#else
+	return CullSimd::SCALAR;
+#endif
+}
+
+const char* CullSimdName(CullSimd simd) {
+	switch (simd) {
+	case CullSimd::SCALAR: return "scalar";
+	case CullSimd::SSE2: return "SSE2";
+	case CullSimd::AVX: return "AVX";
+	case CullSimd::BEST: return CullSimdName(BestCullSimd());
+	}
+	return "unknown";
+}
+
+size_t CullReference(const std::vector<BoundingVolume>& volumes, const Frustum& frustum, CullShape shape,
+	size_t first, size_t range_count, uint32_t* visible) {
+	size_t written = 0;
+	size_t end = std::min(first + range_count, volumes.size());
+	for (size_t i = first; i < end; ++i) {
+		const BoundingVolume& volume = volumes[i];
+		if (IsVisible(frustum, shape, volume.centre, volume.extents, volume.radius)) {
+			visible[written++] = static_cast<uint32_t>(i);
+		}
+	}
+	return written;
+}
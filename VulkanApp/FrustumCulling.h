@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "Utilities.h"
+
+//CPU frustum culling over structure-of-arrays bounds. Every field has its own array, so the SIMD paths load one
+//field of 4 (SSE2) or 8 (AVX) objects with a single instruction and test them against a plane at once.
+//Used when the device can't cull on the GPU (see GpuCulling.h)
+
+//Instruction set of the culling kernel. BEST is the widest one the CPU supports
+enum class CullSimd { SCALAR, SSE2, AVX, BEST };
+
+enum class CullShape {
+	SPHERE,		//Centre and radius, the cheapest test
+	AABB		//Centre and half extents, tighter for long or flat objects
+};
+
+//Normalised planes pointing into the frustum: a point p is inside plane i when dot(xyz, p) + w >= 0
+struct Frustum {
+	glm::vec4 planes[6];
+};
+
+//Frustum planes of a (Vulkan, depth 0 to 1) view projection matrix, normalised so distances are in world units
+Frustum ExtractFrustum(const glm::mat4& view_projection);
+
+//World space bounds of every object, index order is the caller's object order
+class CullingVolumes
+{
+public:
+	void Reserve(size_t count);
+	void Clear();
+
+	//The sphere encloses the box, so both shapes can be tested on the same volumes
+	uint32_t Add(const glm::vec3& centre, const glm::vec3& extents);
+	void Set(uint32_t index, const glm::vec3& centre, const glm::vec3& extents);
+
+	size_t Size() const { return count; }
+
+	//Indices of the volumes in [first, first + range_count) that touch the frustum, written to visible (which must have
+	//room for range_count). Returns how many were written
+	size_t Cull(const Frustum& frustum, CullShape shape, size_t first, size_t range_count, uint32_t* visible,
+		CullSimd simd = CullSimd::BEST) const;
+
+private:
+	//Each array is padded to a multiple of 8 so the SIMD loops never load past the end
+	std::vector<float> centre_x;
+	std::vector<float> centre_y;
+	std::vector<float> centre_z;
+	std::vector<float> extent_x;
+	std::vector<float> extent_y;
+	std::vector<float> extent_z;
+	std::vector<float> radius;
+	size_t count = 0;
+
+	void Resize(size_t new_count);
+	size_t CullScalar(const Frustum& frustum, CullShape shape, size_t first, size_t range_count, uint32_t* visible) const;
+	size_t CullSse2(const Frustum& frustum, CullShape shape, size_t first, size_t range_count, uint32_t* visible) const;
+	size_t CullAvx(const Frustum& frustum, CullShape shape, size_t first, size_t range_count, uint32_t* visible) const;
+};
+
+//Widest kernel this build and CPU can run (AVX is checked at runtime, including OS support for the wider registers)
+CullSimd BestCullSimd();
+const char* CullSimdName(CullSimd simd);
+
+//Array of structures bounds, the layout objects usually have. Only for CullReference
+struct BoundingVolume {
+	glm::vec3 centre;
+	glm::vec3 extents;
+	float radius;
+};
+
+//Plain glm::vec3 implementation of the same tests, one object at a time. Gives the same results as every kernel
+size_t CullReference(const std::vector<BoundingVolume>& volumes, const Frustum& frustum, CullShape shape,
+	size_t first, size_t range_count, uint32_t* visible);
@@ -0,0 +1,361 @@
+#include "GpuCulling.h"
+
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+
+//Workgroup size of cull.comp
+static const uint32_t CULL_GROUP_SIZE = 64;
+
+//Objects this close to a plane may land on either side depending on rounding (FMA contraction on the GPU),
+//VerifyFrame accepts both outcomes for them
+static const float VERIFY_SLACK = 1e-4f;
+
+bool GpuCulling::IsSupported(VkPhysicalDevice physical_device, uint32_t graphics_family) {
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(physical_device, &properties);
+	if (properties.apiVersion < VK_API_VERSION_1_2) {
+		return false;
+	}
+
+	VkPhysicalDeviceVulkan12Features vulkan12_features = {};
+	vulkan12_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+	VkPhysicalDeviceFeatures2 features = {};
+	features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	features.pNext = &vulkan12_features;
+	vkGetPhysicalDeviceFeatures2(physical_device, &features);
+	if (!vulkan12_features.drawIndirectCount || !features.features.multiDrawIndirect || !features.features.drawIndirectFirstInstance) {
+		return false;
+	}
+
+	uint32_t family_count = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &family_count, nullptr);
+	std::vector<VkQueueFamilyProperties> families(family_count);
+	vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &family_count, families.data());
+	return graphics_family < family_count && (families[graphics_family].queueFlags & VK_QUEUE_COMPUTE_BIT);
+}
+
+void GpuCulling::EnableFeatures(VkPhysicalDeviceFeatures& features, VkPhysicalDeviceVulkan12Features& vulkan12_features) {
+	features.multiDrawIndirect = VK_TRUE;
+	features.drawIndirectFirstInstance = VK_TRUE;		//Commands select their object's InstanceData
+	vulkan12_features.drawIndirectCount = VK_TRUE;
+}
+
+void GpuCulling::Init(VkDevice logical_device, DeviceAllocator& device_allocator, DescriptorSetCache& descriptor_cache,
+	FrameDescriptorAllocator& frame_descriptor_allocator, uint32_t frames_in_flight, bool verify_counts) {
+	device = logical_device;
+	allocator = &device_allocator;
+	descriptors = &descriptor_cache;
+	frame_descriptors = &frame_descriptor_allocator;
+	verify = verify_counts;
+
+	//Set 0: objects, instances, meshes. Set 1: commands, counts
+	VkDescriptorSetLayoutBinding bindings[3] = {};
+	for (uint32_t i = 0; i < 3; ++i) {
+		bindings[i].binding = i;
+		bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[i].descriptorCount = 1;
+		bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	}
+
+	VkDescriptorSetLayoutCreateInfo layout_create_info = {};
+	layout_create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layout_create_info.bindingCount = 3;
+	layout_create_info.pBindings = bindings;
+	if (vkCreateDescriptorSetLayout(device, &layout_create_info, nullptr, &scene_set_layout) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create the culling descriptor set layout");
+	}
+
+	layout_create_info.bindingCount = 2;
+	if (vkCreateDescriptorSetLayout(device, &layout_create_info, nullptr, &frame_set_layout) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create the culling descriptor set layout");
+	}
+	VkDescriptorSetLayout set_layouts[] = { scene_set_layout, frame_set_layout };
+
+	VkPushConstantRange push_constant_range = {};
+	push_constant_range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	push_constant_range.offset = 0;
+	push_constant_range.size = sizeof(CullParams);
+
+	VkPipelineLayoutCreateInfo pipeline_layout_create_info = {};
+	pipeline_layout_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipeline_layout_create_info.setLayoutCount = 2;
+	pipeline_layout_create_info.pSetLayouts = set_layouts;
+	pipeline_layout_create_info.pushConstantRangeCount = 1;
+	pipeline_layout_create_info.pPushConstantRanges = &push_constant_range;
+	if (vkCreatePipelineLayout(device, &pipeline_layout_create_info, nullptr, &pipeline_layout) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create the culling pipeline layout");
+	}
+
+	frames.resize(frames_in_flight);
+}
+
+void GpuCulling::Destroy() {
+	if (device == VK_NULL_HANDLE) {
+		return;
+	}
+
+	DestroySceneBuffers();
+	vkDestroyPipeline(device, pipeline, nullptr);
+	vkDestroyPipelineLayout(device, pipeline_layout, nullptr);
+	vkDestroyDescriptorSetLayout(device, scene_set_layout, nullptr);
+	vkDestroyDescriptorSetLayout(device, frame_set_layout, nullptr);
+	frames.clear();
+	device = VK_NULL_HANDLE;
+}
+
+void GpuCulling::AddMesh(uint32_t index_count, const glm::vec4& bounding_sphere) {
+	MeshInfo mesh = {};
+	mesh.index_count = index_count;
+	mesh.bounding_sphere = bounding_sphere;
+	meshes.push_back(mesh);
+}
+
+uint32_t GpuCulling::AddObjects(uint32_t mesh, const std::vector<InstanceData>& new_instances) {
+	if (mesh >= meshes.size()) {
+		throw std::runtime_error("Objects added for an unknown mesh");
+	}
+
+	for (const InstanceData& instance : new_instances) {
+		GpuObject object = {};
+		object.sphere = meshes[mesh].bounding_sphere;
+		object.mesh = mesh;
+		objects.push_back(object);
+		instances.push_back(instance);
+	}
+	meshes[mesh].object_count += static_cast<uint32_t>(new_instances.size());
+	dirty = true;
+	return batch_count++;
+}
+
+VkBuffer GpuCulling::CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, DeviceAllocation& memory) {
+	VkBufferCreateInfo buffer_create_info = {};
+	buffer_create_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	buffer_create_info.size = size;
+	buffer_create_info.usage = usage;
+	buffer_create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	VkBuffer buffer;
+	if (vkCreateBuffer(device, &buffer_create_info, nullptr, &buffer) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create a culling buffer");
+	}
+
+	try {
+		memory = allocator->AllocateForBuffer(buffer, properties);
+	}
+	catch (...) {
+		vkDestroyBuffer(device, buffer, nullptr);
+		throw;
+	}
+
+	return buffer;
+}
+
+void GpuCulling::Upload(StagingRing& staging) {
+	//Cached sets still point at the old buffers, and new ones may get their handle values
+	DestroySceneBuffers();
+	descriptors->Reset();
+	dirty = false;
+	for (FrameBuffers& frame : frames) {
+		frame.recorded = false;
+	}
+	if (objects.empty()) {
+		return;
+	}
+
+	//Each mesh owns a range of commands big enough for all of its objects, so no draw can overflow into another
+	std::vector<GpuMeshDraw> mesh_draws(meshes.size());
+	uint32_t command_offset = 0;
+	for (size_t m = 0; m < meshes.size(); ++m) {
+		meshes[m].command_offset = command_offset;
+		mesh_draws[m] = { meshes[m].index_count, command_offset, { 0, 0 } };
+		command_offset += meshes[m].object_count;
+	}
+	uploaded_objects = static_cast<uint32_t>(objects.size());
+
+	VkDeviceSize object_size = sizeof(GpuObject) * objects.size();
+	VkDeviceSize instance_size = sizeof(InstanceData) * instances.size();
+	VkDeviceSize mesh_size = sizeof(GpuMeshDraw) * mesh_draws.size();
+	VkDeviceSize command_size = sizeof(VkDrawIndexedIndirectCommand) * objects.size();
+	VkDeviceSize count_size = sizeof(uint32_t) * meshes.size();
+
+	object_buffer = CreateDeviceLocalBuffer(device, *allocator, object_size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, object_memory);
+	instance_buffer = CreateDeviceLocalBuffer(device, *allocator, instance_size,
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, instance_memory);
+	mesh_buffer = CreateDeviceLocalBuffer(device, *allocator, mesh_size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, mesh_memory);
+
+	staging.UploadBuffer(object_buffer, 0, objects.data(), object_size, VK_ACCESS_SHADER_READ_BIT);
+	staging.UploadBuffer(instance_buffer, 0, instances.data(), instance_size,
+		VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
+	staging.UploadBuffer(mesh_buffer, 0, mesh_draws.data(), mesh_size, VK_ACCESS_SHADER_READ_BIT);
+
+	//Counts are read back by VerifyFrame, keep them host visible then
+	VkMemoryPropertyFlags count_properties = verify
+		? VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+		: VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+
+	for (FrameBuffers& frame : frames) {
+		frame.commands = CreateBuffer(command_size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, frame.commands_memory);
+		frame.counts = CreateBuffer(count_size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT
+			| VK_BUFFER_USAGE_TRANSFER_DST_BIT, count_properties, frame.counts_memory);
+	}
+}
+
+void GpuCulling::DestroySceneBuffers() {
+	VkBuffer* buffers[] = { &object_buffer, &instance_buffer, &mesh_buffer };
+	DeviceAllocation* allocations[] = { &object_memory, &instance_memory, &mesh_memory };
+	for (size_t i = 0; i < 3; ++i) {
+		if (*buffers[i] != VK_NULL_HANDLE) {
+			vkDestroyBuffer(device, *buffers[i], nullptr);
+			allocator->Free(*allocations[i]);
+			*buffers[i] = VK_NULL_HANDLE;
+		}
+	}
+
+	for (FrameBuffers& frame : frames) {
+		if (frame.commands != VK_NULL_HANDLE) {
+			vkDestroyBuffer(device, frame.commands, nullptr);
+			allocator->Free(frame.commands_memory);
+			frame.commands = VK_NULL_HANDLE;
+		}
+		if (frame.counts != VK_NULL_HANDLE) {
+			vkDestroyBuffer(device, frame.counts, nullptr);
+			allocator->Free(frame.counts_memory);
+			frame.counts = VK_NULL_HANDLE;
+		}
+	}
+	uploaded_objects = 0;
+}
+
+void GpuCulling::RecordCulling(VkCommandBuffer command_buffer, uint32_t frame_index, const glm::mat4& view_projection) {
+	FrameBuffers& frame = frames[frame_index];
+	if (uploaded_objects == 0) {
+		return;
+	}
+
+	CullParams params = {};
+	Frustum frustum = ExtractFrustum(view_projection);
+	std::copy(std::begin(frustum.planes), std::end(frustum.planes), params.planes);
+	params.object_count = uploaded_objects;
+	frame.params = params;
+	frame.recorded = true;
+
+	//The previous use of these buffers (indirect reads of the frame before) is covered by the frame slot's fence
+	vkCmdFillBuffer(command_buffer, frame.counts, 0, VK_WHOLE_SIZE, 0);
+
+	VkMemoryBarrier clear_barrier = {};
+	clear_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	clear_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	clear_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+	vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+		1, &clear_barrier, 0, nullptr, 0, nullptr);
+
+	//The scene set is written the first time anything culls after an upload, a lookup from then on
+	DescriptorSetDesc scene_desc(scene_set_layout);
+	scene_desc.Buffer(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, object_buffer)
+		.Buffer(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, instance_buffer)
+		.Buffer(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, mesh_buffer);
+
+	//The frame's outputs get a throwaway set, released with the rest of the slot's sets after its fence wait
+	VkDescriptorSet descriptor_sets[] = { descriptors->Get(scene_desc), frame_descriptors->Allocate(frame_set_layout) };
+	DescriptorSetDesc frame_desc(frame_set_layout);
+	frame_desc.Buffer(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, frame.commands)
+		.Buffer(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, frame.counts);
+	frame_desc.Write(device, descriptor_sets[1]);
+
+	vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+	vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_layout, 0, 2, descriptor_sets, 0, nullptr);
+	vkCmdPushConstants(command_buffer, pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(CullParams), &params);
+	vkCmdDispatch(command_buffer, (uploaded_objects + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+
+	VkMemoryBarrier cull_barrier = {};
+	cull_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	cull_barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	cull_barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+	VkPipelineStageFlags dst_stages = VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT;
+	if (verify) {
+		cull_barrier.dstAccessMask |= VK_ACCESS_HOST_READ_BIT;
+		dst_stages |= VK_PIPELINE_STAGE_HOST_BIT;
+	}
+	vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, dst_stages, 0,
+		1, &cull_barrier, 0, nullptr, 0, nullptr);
+}
+
+void GpuCulling::RecordDraws(VkCommandBuffer command_buffer, uint32_t frame_index, const std::vector<Mesh>& scene_meshes,
+	VkPipelineLayout graphics_layout) const {
+	const FrameBuffers& frame = frames[frame_index];
+	if (uploaded_objects == 0) {
+		return;
+	}
+
+	//One call per mesh whatever the object count, the GPU reads how many of the range's commands survived
+	for (size_t m = 0; m < meshes.size(); ++m) {
+		if (meshes[m].object_count == 0) {
+			continue;
+		}
+
+		scene_meshes[m].Bind(command_buffer, graphics_layout, instance_buffer);
+		vkCmdDrawIndexedIndirectCount(command_buffer, frame.commands, sizeof(VkDrawIndexedIndirectCommand) * meshes[m].command_offset,
+			frame.counts, sizeof(uint32_t) * m, meshes[m].object_count, sizeof(VkDrawIndexedIndirectCommand));
+	}
+}
+
+void GpuCulling::VerifyFrame(uint32_t frame_index) {
+	FrameBuffers& frame = frames[frame_index];
+	if (!verify || !frame.recorded) {
+		return;
+	}
+	frame.recorded = false;
+
+	//Objects near a plane are allowed either way, so the GPU count must lie between the strict and lenient counts
+	std::vector<uint32_t> strict(meshes.size(), 0);
+	std::vector<uint32_t> lenient(meshes.size(), 0);
+	for (uint32_t i = 0; i < frame.params.object_count; ++i) {
+		const GpuObject& object = objects[i];
+		if (IsSphereVisible(frame.params.planes, object.sphere, instances[i].model, -VERIFY_SLACK)) {
+			++strict[object.mesh];
+		}
+		if (IsSphereVisible(frame.params.planes, object.sphere, instances[i].model, VERIFY_SLACK)) {
+			++lenient[object.mesh];
+		}
+	}
+
+	const uint32_t* counts = static_cast<const uint32_t*>(frame.counts_memory.mapped);
+	bool matched = true;
+	uint64_t visible = 0;
+	for (size_t m = 0; m < meshes.size(); ++m) {
+		visible += counts[m];
+		if (counts[m] < strict[m] || counts[m] > lenient[m]) {
+			matched = false;
+		}
+	}
+
+	++stats.verified_frames;
+	stats.last_visible = visible;
+	if (!matched) {
+		++stats.mismatched_frames;
+	}
+}
+
+void GpuCulling::PrintStats(std::ostream& out) const {
+	out << "GPU culling: " << objects.size() << " objects, " << meshes.size() << " meshes";
+	if (verify) {
+		out << ", verified " << stats.verified_frames << " frames against the CPU reference, "
+			<< stats.mismatched_frames << " mismatched, " << stats.last_visible << " objects visible in the last";
+	}
+	out << std::endl;
+}
+
+bool IsSphereVisible(const glm::vec4 planes[6], const glm::vec4& sphere, const glm::mat4& model, float slack) {
+	glm::vec3 centre = glm::vec3(model * glm::vec4(glm::vec3(sphere), 1.0f));
+	float scale = std::max(glm::length(glm::vec3(model[0])), std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+	float radius = sphere.w * scale + slack;
+
+	for (int i = 0; i < 6; ++i) {
+		if (glm::dot(glm::vec3(planes[i]), centre) + planes[i].w < -radius) {
+			return false;
+		}
+	}
+	return true;
+}
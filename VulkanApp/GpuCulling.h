@@ -0,0 +1,137 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <ostream>
+#include <vector>
+
+#include "Utilities.h"
+#include "DeviceAllocator.h"
+#include "StagingRing.h"
+#include "Mesh.h"
+#include "FrustumCulling.h"
+#include "DescriptorAllocator.h"
+
+//GPU-driven drawing. Object bounds, transforms and per-mesh draw arguments live in storage buffers; each frame a
+//compute pass (cull.comp) tests every object against the frustum and appends a VkDrawIndexedIndirectCommand for the
+//survivors to its mesh's range, counting them per mesh. The render pass then issues one vkCmdDrawIndexedIndirectCount
+//per mesh, so the CPU cost of a frame does not depend on the number of objects.
+//
+//Per frame: VerifyFrame + (Upload when NeedsUpload) after the fence wait, RecordCulling before the render pass,
+//RecordDraws inside it
+class GpuCulling
+{
+public:
+	struct Stats {
+		uint64_t verified_frames = 0;
+		uint64_t mismatched_frames = 0;		//GPU survivor counts differing from the CPU reference
+		uint64_t last_visible = 0;			//Survivors of the last verified frame
+	};
+
+	//Matches the push constants of cull.comp
+	struct CullParams {
+		glm::vec4 planes[6];		//xyz = inward normal (unit length), w = distance
+		uint32_t object_count = 0;
+		uint32_t padding[3] = {};
+	};
+
+	//drawIndirectCount (Vulkan 1.2), multiDrawIndirect and drawIndirectFirstInstance, and compute on the graphics family
+	static bool IsSupported(VkPhysicalDevice physical_device, uint32_t graphics_family);
+	static void EnableFeatures(VkPhysicalDeviceFeatures& features, VkPhysicalDeviceVulkan12Features& vulkan12_features);
+
+	//verify = false keeps the count buffers device local, VerifyFrame does nothing then.
+	//The scene set (set 0) comes from descriptor_cache, which Upload resets after replacing the scene buffers.
+	//The set of the frame's output buffers (set 1) is allocated from frame_descriptors every frame
+	void Init(VkDevice logical_device, DeviceAllocator& device_allocator, DescriptorSetCache& descriptor_cache,
+		FrameDescriptorAllocator& frame_descriptors, uint32_t frames_in_flight, bool verify);
+	void Destroy();
+
+	VkPipelineLayout GetPipelineLayout() const { return pipeline_layout; }
+	void SetPipeline(VkPipeline compute_pipeline) { pipeline = compute_pipeline; }		//Destroyed by Destroy
+
+	//Scene, mesh indices match the renderer's meshes. Objects reach the GPU with the next Upload
+	void AddMesh(uint32_t index_count, const glm::vec4& bounding_sphere);
+	uint32_t AddObjects(uint32_t mesh, const std::vector<InstanceData>& instances);
+	bool NeedsUpload() const { return dirty; }
+
+	//Rebuilds the scene buffers. None of the old ones may still be in use by the GPU
+	void Upload(StagingRing& staging);
+
+	//Outside a render pass
+	void RecordCulling(VkCommandBuffer command_buffer, uint32_t frame, const glm::mat4& view_projection);
+	//Inside the render pass, with the scene pipeline bound
+	void RecordDraws(VkCommandBuffer command_buffer, uint32_t frame, const std::vector<Mesh>& meshes, VkPipelineLayout graphics_layout) const;
+
+	//Call after the frame slot's fence wait: compares what the GPU kept in that slot's last frame with a CPU cull
+	void VerifyFrame(uint32_t frame);
+
+	Stats GetStats() const { return stats; }
+	void PrintStats(std::ostream& out) const;
+
+private:
+	//std430 layouts of cull.comp
+	struct GpuObject {
+		glm::vec4 sphere;		//Object space bounding sphere of the mesh
+		uint32_t mesh;
+		uint32_t padding[3];
+	};
+
+	struct GpuMeshDraw {
+		uint32_t index_count;
+		uint32_t command_offset;	//First VkDrawIndexedIndirectCommand of the mesh's range
+		uint32_t padding[2];
+	};
+
+	struct MeshInfo {
+		uint32_t index_count;
+		glm::vec4 bounding_sphere;
+		uint32_t object_count = 0;
+		uint32_t command_offset = 0;
+	};
+
+	struct FrameBuffers {
+		VkBuffer commands = VK_NULL_HANDLE;
+		DeviceAllocation commands_memory;
+		VkBuffer counts = VK_NULL_HANDLE;		//One uint per mesh
+		DeviceAllocation counts_memory;
+		CullParams params;						//Of the last recorded frame, for VerifyFrame
+		bool recorded = false;
+	};
+
+	VkDevice device = VK_NULL_HANDLE;
+	DeviceAllocator* allocator = nullptr;
+	DescriptorSetCache* descriptors = nullptr;
+	FrameDescriptorAllocator* frame_descriptors = nullptr;
+	bool verify = false;
+
+	VkDescriptorSetLayout scene_set_layout = VK_NULL_HANDLE;		//objects, instances, meshes
+	VkDescriptorSetLayout frame_set_layout = VK_NULL_HANDLE;		//commands, counts
+	VkPipelineLayout pipeline_layout = VK_NULL_HANDLE;
+	VkPipeline pipeline = VK_NULL_HANDLE;
+
+	std::vector<MeshInfo> meshes;
+	std::vector<GpuObject> objects;
+	std::vector<InstanceData> instances;
+	uint32_t batch_count = 0;
+	bool dirty = false;
+
+	//Uploaded scene
+	uint32_t uploaded_objects = 0;
+	VkBuffer object_buffer = VK_NULL_HANDLE;
+	DeviceAllocation object_memory;
+	VkBuffer instance_buffer = VK_NULL_HANDLE;		//Also the per-instance vertex buffer, indexed by firstInstance
+	DeviceAllocation instance_memory;
+	VkBuffer mesh_buffer = VK_NULL_HANDLE;
+	DeviceAllocation mesh_memory;
+
+	std::vector<FrameBuffers> frames;
+	Stats stats;
+
+	void DestroySceneBuffers();
+	VkBuffer CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, DeviceAllocation& memory);
+};
+
+//Same test as cull.comp: the object's bounding sphere moved by its model matrix and scaled by its largest axis scale.
+//slack grows (or with a negative value shrinks) the radius
+bool IsSphereVisible(const glm::vec4 planes[6], const glm::vec4& sphere, const glm::mat4& model, float slack = 0.0f);
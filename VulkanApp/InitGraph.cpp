@@ -0,0 +1,182 @@
+#include "InitGraph.h"
+
+#include <condition_variable>
+#include <exception>
+#include <iomanip>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+namespace {
+	double ToMs(InitGraph::Clock::duration duration) {
+		return std::chrono::duration<double, std::milli>(duration).count();
+	}
+}
+
+InitGraph::TaskId InitGraph::Add(const std::string& name, std::function<void()> work,
+	const std::vector<TaskId>& dependencies, bool main_thread) {
+	for (TaskId dependency : dependencies) {
+		if (dependency >= tasks.size()) {
+			throw std::runtime_error("Init stage " + name + " depends on a stage that was not added yet");
+		}
+	}
+
+	Task task;
+	task.name = name;
+	task.work = std::move(work);
+	task.dependencies = dependencies;
+	task.main_thread = main_thread;
+	tasks.push_back(std::move(task));
+
+	return tasks.size() - 1;
+}
+
+void InitGraph::Run(bool parallel) {
+	run_start = Clock::now();
+
+	if (parallel) {
+		RunParallel();
+	}
+	else {
+		RunSerial();
+	}
+}
+
+void InitGraph::RunSerial() {
+	//Dependencies always have lower ids, so insertion order is a valid order
+	for (Task& task : tasks) {
+		task.start = Clock::now();
+		task.work();
+		task.end = Clock::now();
+		task.state = State::DONE;
+	}
+}
+
+void InitGraph::RunParallel() {
+	std::mutex state_mutex;
+	std::condition_variable state_changed;
+	std::vector<std::thread> threads;
+	std::exception_ptr first_error;
+	size_t running = 0;
+
+	auto run_task = [&](Task& task) {
+		std::exception_ptr error;
+		try {
+			task.work();
+		}
+		catch (...) {
+			error = std::current_exception();
+		}
+
+		std::lock_guard<std::mutex> lock(state_mutex);
+		task.end = Clock::now();
+		task.state = error ? State::FAILED : State::DONE;
+		if (error && !first_error) {
+			first_error = error;
+		}
+		--running;
+		state_changed.notify_all();
+	};
+
+	std::unique_lock<std::mutex> lock(state_mutex);
+	while (true) {
+		Task* main_thread_task = nullptr;
+		bool all_settled = true;
+
+		for (Task& task : tasks) {
+			if (task.state != State::PENDING) {
+				continue;
+			}
+
+			bool ready = true;
+			bool blocked = false;
+			for (TaskId dependency : task.dependencies) {
+				State dependency_state = tasks[dependency].state;
+				ready = ready && dependency_state == State::DONE;
+				blocked = blocked || dependency_state == State::FAILED || dependency_state == State::SKIPPED;
+			}
+
+			//Nothing new starts once a stage failed
+			if (blocked || (first_error && ready)) {
+				task.state = State::SKIPPED;
+				continue;
+			}
+
+			all_settled = false;
+			if (!ready || (task.main_thread && main_thread_task != nullptr)) {
+				continue;
+			}
+
+			task.state = State::RUNNING;
+			task.start = Clock::now();
+			++running;
+
+			if (task.main_thread) {
+				main_thread_task = &task;		//Run once every ready worker stage has been started
+				continue;
+			}
+			threads.emplace_back(run_task, std::ref(task));
+		}
+
+		if (main_thread_task != nullptr) {
+			lock.unlock();
+			run_task(*main_thread_task);
+			lock.lock();
+			continue;
+		}
+
+		if (all_settled && running == 0) {
+			break;
+		}
+
+		state_changed.wait(lock);
+	}
+	lock.unlock();
+
+	for (auto& thread : threads) {
+		thread.join();
+	}
+
+	if (first_error) {
+		std::rethrow_exception(first_error);
+	}
+}
+
+void InitGraph::PrintCriticalPath(std::ostream& out) const {
+	if (tasks.empty()) {
+		return;
+	}
+
+	//Start from the stage that finished last and keep following the dependency that finished last
+	const Task* current = &tasks[0];
+	for (const Task& task : tasks) {
+		if (task.end > current->end) {
+			current = &task;
+		}
+	}
+
+	std::vector<const Task*> path;
+	while (current != nullptr) {
+		path.push_back(current);
+
+		const Task* latest = nullptr;
+		for (TaskId dependency : current->dependencies) {
+			if (latest == nullptr || tasks[dependency].end > latest->end) {
+				latest = &tasks[dependency];
+			}
+		}
+		current = latest;
+	}
+
+	double total_ms = ToMs(path.front()->end - run_start);
+	double busy_ms = 0.0;
+	for (const Task* task : path) {
+		busy_ms += ToMs(task->end - task->start);
+	}
+
+	out << "Init critical path: " << std::fixed << std::setprecision(2) << total_ms << " ms ("
+		<< busy_ms << " ms in stages, the rest waiting to be scheduled)" << std::endl;
+	for (auto it = path.rbegin(); it != path.rend(); ++it) {
+		out << std::setw(10) << ToMs((*it)->end - (*it)->start) << " ms  " << (*it)->name << std::endl;
+	}
+}
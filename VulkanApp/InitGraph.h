@@ -0,0 +1,44 @@
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+//Runs startup stages as a dependency graph: every stage starts as soon as the stages it depends on are done.
+//Stages flagged main_thread (GLFW window calls) run on the thread that called Run, the rest get their own thread
+class InitGraph
+{
+public:
+	using TaskId = size_t;
+	using Clock = std::chrono::steady_clock;
+
+	TaskId Add(const std::string& name, std::function<void()> work,
+		const std::vector<TaskId>& dependencies = {}, bool main_thread = false);
+
+	//parallel = false runs every stage on the calling thread in the order they were added (for comparison)
+	void Run(bool parallel = true);
+
+	//Chain of stages that decided when the last one finished, with the total time
+	void PrintCriticalPath(std::ostream& out) const;
+
+private:
+	enum class State { PENDING, RUNNING, DONE, FAILED, SKIPPED };
+
+	struct Task {
+		std::string name;
+		std::function<void()> work;
+		std::vector<TaskId> dependencies;
+		bool main_thread;
+		State state = State::PENDING;
+		Clock::time_point start;
+		Clock::time_point end;
+	};
+
+	std::vector<Task> tasks;
+	Clock::time_point run_start;
+
+	void RunSerial();
+	void RunParallel();
+};
@@ -0,0 +1,244 @@
+#include "JobSystem.h"
+
+#include <algorithm>
+
+namespace {
+	//Ranges ParallelFor makes per thread, so a thread that finishes early can steal the rest of a slow one's share
+	const size_t RANGES_PER_THREAD = 4;
+
+	//Which worker of which system the current thread is, for queuing onto its own deque
+	thread_local const JobSystem* current_system = nullptr;
+	thread_local uint32_t current_worker = 0;
+
+	bool PopBack(std::deque<QueuedJob>& jobs, QueuedJob& job) {
+		if (jobs.empty()) {
+			return false;
+		}
+		job = std::move(jobs.back());
+		jobs.pop_back();
+		return true;
+	}
+
+	bool PopFront(std::deque<QueuedJob>& jobs, QueuedJob& job) {
+		if (jobs.empty()) {
+			return false;
+		}
+		job = std::move(jobs.front());
+		jobs.pop_front();
+		return true;
+	}
+}
+
+JobSystem::~JobSystem() {
+	Stop();
+}
+
+void JobSystem::Start() {
+	uint32_t hardware_threads = std::thread::hardware_concurrency();		//0 when unknown
+	Start(hardware_threads > 1 ? hardware_threads - 1 : 0);
+}
+
+void JobSystem::Start(uint32_t worker_count) {
+	Stop();
+
+	stopping = false;
+	for (uint32_t i = 0; i < worker_count + 1; ++i) {
+		queues.push_back(std::make_unique<WorkerQueue>());
+	}
+	for (uint32_t i = 0; i < worker_count; ++i) {
+		workers.emplace_back(&JobSystem::WorkerLoop, this, i);
+	}
+}
+
+void JobSystem::Stop() {
+	{
+		std::lock_guard<std::mutex> lock(sleep_mutex);
+		stopping = true;
+	}
+	jobs_available.notify_all();
+
+	for (auto& worker : workers) {
+		worker.join();
+	}
+	workers.clear();
+
+	//A job still running when the others left may have queued more, finish them here
+	while (TryRun()) {
+	}
+	queues.clear();
+}
+
+void JobSystem::Run(Job job, JobCounter* counter) {
+	if (counter != nullptr) {
+		counter->pending.fetch_add(1, std::memory_order_relaxed);
+	}
+	Push({ std::move(job), counter });
+}
+
+void JobSystem::RunAfter(JobCounter& dependency, Job job, JobCounter* counter) {
+	{
+		//The last job of dependency releases the continuations under this lock, so a job added here can't be missed
+		std::lock_guard<std::mutex> lock(dependency.mutex);
+		if (!dependency.IsDone()) {
+			if (counter != nullptr) {
+				counter->pending.fetch_add(1, std::memory_order_relaxed);
+			}
+			dependency.continuations.push_back({ std::move(job), counter });
+			return;
+		}
+	}
+	Run(std::move(job), counter);
+}
+
+void JobSystem::Wait(JobCounter& counter) {
+	while (!counter.IsDone()) {
+		if (!TryRun()) {
+			std::this_thread::yield();		//The rest is running elsewhere
+		}
+	}
+
+	//The thread that finished the last job may still hold the lock, the counter must not go away before it lets go
+	std::lock_guard<std::mutex> lock(counter.mutex);
+}
+
+void JobSystem::ParallelFor(size_t count, size_t grain, const std::function<void(size_t begin, size_t end)>& body) {
+	if (count == 0) {
+		return;
+	}
+
+	grain = std::max<size_t>(1, grain);
+	size_t thread_count = queues.empty() ? 1 : queues.size();
+	size_t range_count = std::min((count + grain - 1) / grain, thread_count * RANGES_PER_THREAD);
+	size_t range_size = (count + range_count - 1) / range_count;
+
+	//The first range runs here, the caller would only wait otherwise
+	JobCounter counter;
+	for (size_t begin = range_size; begin < count; begin += range_size) {
+		size_t end = std::min(count, begin + range_size);
+		Run([&body, begin, end]() { body(begin, end); }, &counter);
+	}
+	body(0, std::min(count, range_size));
+	Wait(counter);
+}
+
+JobSystem::Stats JobSystem::GetStats() const {
+	Stats result;
+	result.jobs_run = jobs_run.load(std::memory_order_relaxed);
+	result.steals = steals.load(std::memory_order_relaxed);
+	return result;
+}
+
+void JobSystem::Push(QueuedJob job) {
+	if (queues.empty()) {
+		//Not started - run on the calling thread
+		job.work();
+		jobs_run.fetch_add(1, std::memory_order_relaxed);
+		Finish(job.counter);
+		return;
+	}
+
+	WorkerQueue& queue = *queues[CurrentWorker()];
+	{
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		queued.fetch_add(1);
+		queue.jobs.push_back(std::move(job));
+	}
+
+	//A worker going to sleep counts itself before it checks queued, so one of the two sees the other
+	if (sleeping.load() > 0) {
+		{
+			std::lock_guard<std::mutex> lock(sleep_mutex);
+		}
+		jobs_available.notify_one();
+	}
+}
+
+bool JobSystem::TryRun() {
+	QueuedJob job;
+	if (!TryTake(job)) {
+		return false;
+	}
+
+	job.work();
+	jobs_run.fetch_add(1, std::memory_order_relaxed);
+	Finish(job.counter);
+	return true;
+}
+
+bool JobSystem::TryTake(QueuedJob& job) {
+	if (queues.empty() || queued.load() == 0) {
+		return false;
+	}
+
+	uint32_t self = CurrentWorker();
+	uint32_t shared = static_cast<uint32_t>(queues.size() - 1);
+	auto take = [this, &job](WorkerQueue& queue, bool newest) {
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (!(newest ? PopBack(queue.jobs, job) : PopFront(queue.jobs, job))) {
+			return false;
+		}
+		queued.fetch_sub(1);
+		return true;
+	};
+
+	if (self != shared && take(*queues[self], true)) {
+		return true;
+	}
+	if (take(*queues[shared], false)) {
+		return true;
+	}
+
+	//Other workers, starting after this one so thieves spread over the victims
+	for (uint32_t i = 1; i <= shared; ++i) {
+		uint32_t victim = (self + i) % shared;
+		if (victim != self && take(*queues[victim], false)) {
+			steals.fetch_add(1, std::memory_order_relaxed);
+			return true;
+		}
+	}
+	return false;
+}
+
+void JobSystem::Finish(JobCounter* counter) {
+	if (counter == nullptr) {
+		return;
+	}
+
+	std::vector<QueuedJob> released;
+	{
+		std::lock_guard<std::mutex> lock(counter->mutex);
+		if (counter->pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+			released.swap(counter->continuations);
+		}
+	}
+
+	//counter may be gone from here on, a waiter can return as soon as the lock is released
+	for (QueuedJob& job : released) {
+		Push(std::move(job));
+	}
+}
+
+void JobSystem::WorkerLoop(uint32_t worker) {
+	current_system = this;
+	current_worker = worker;
+
+	while (true) {
+		if (TryRun()) {
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(sleep_mutex);
+		sleeping.fetch_add(1);
+		jobs_available.wait(lock, [this]() { return stopping || queued.load() > 0; });
+		sleeping.fetch_sub(1);
+
+		if (stopping && queued.load() == 0) {
+			return;		//Drained
+		}
+	}
+}
+
+uint32_t JobSystem::CurrentWorker() const {
+	//queues, not workers: it is complete before the first worker starts, workers is still growing then
+	return current_system == this ? current_worker : static_cast<uint32_t>(queues.size() - 1);
+}
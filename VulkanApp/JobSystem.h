@@ -0,0 +1,107 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using Job = std::function<void()>;
+
+class JobCounter;
+
+//A job and the counter it decrements when done
+struct QueuedJob {
+	Job work;
+	JobCounter* counter = nullptr;
+};
+
+//Counts the unfinished jobs of a group. Wait on it, or make other jobs depend on it with JobSystem::RunAfter.
+//Can be reused once it reaches zero, must outlive the jobs counted by it
+class JobCounter
+{
+public:
+	JobCounter() = default;
+	JobCounter(const JobCounter&) = delete;
+	JobCounter& operator=(const JobCounter&) = delete;
+
+	bool IsDone() const { return pending.load(std::memory_order_acquire) == 0; }
+
+private:
+	friend class JobSystem;
+
+	std::atomic<uint32_t> pending{ 0 };
+	std::mutex mutex;					//Guards continuations, and is held while the last job finishes
+	std::vector<QueuedJob> continuations;	//Queued by RunAfter, released when pending reaches zero
+};
+
+//Work-stealing scheduler for per-frame CPU work (culling, transform updates, command recording, asset loading).
+//Every worker owns a deque: jobs it queues go on the back and it takes from the back (the newest, still in cache),
+//idle workers steal from the front of the others (the oldest, usually the biggest piece left). Jobs queued from
+//other threads go to a shared queue every worker takes from. A thread waiting on a counter runs jobs meanwhile,
+//so jobs can queue and wait on other jobs without blocking a worker.
+//Jobs must not throw
+class JobSystem
+{
+public:
+	struct Stats {
+		uint64_t jobs_run = 0;
+		uint64_t steals = 0;		//Jobs taken from another worker's deque
+	};
+
+	~JobSystem();
+
+	//One worker per hardware thread except the caller's
+	void Start();
+	//Exactly worker_count workers. The caller helps whenever it waits, so 0 workers is valid and runs every job
+	//on the waiting thread
+	void Start(uint32_t worker_count);
+	void Stop();
+
+	uint32_t GetWorkerCount() const { return static_cast<uint32_t>(workers.size()); }
+
+	//Queues job. counter (optional) goes up now and down once the job has finished
+	void Run(Job job, JobCounter* counter = nullptr);
+
+	//Queues job once dependency reaches zero, right away if it already has
+	void RunAfter(JobCounter& dependency, Job job, JobCounter* counter = nullptr);
+
+	//Runs queued jobs on the calling thread until counter reaches zero
+	void Wait(JobCounter& counter);
+
+	//Calls body(begin, end) over [0, count) in ranges of at least grain items, on the workers and the calling thread.
+	//Returns when every range is done
+	void ParallelFor(size_t count, size_t grain, const std::function<void(size_t begin, size_t end)>& body);
+
+	Stats GetStats() const;
+
+private:
+	struct WorkerQueue {
+		std::mutex mutex;
+		std::deque<QueuedJob> jobs;
+	};
+
+	//Per worker, then the shared queue for every other thread
+	std::vector<std::unique_ptr<WorkerQueue>> queues;
+	std::vector<std::thread> workers;
+
+	std::atomic<uint32_t> queued{ 0 };		//Jobs in all queues, so idle workers can sleep
+	std::atomic<uint32_t> sleeping{ 0 };	//Pushes only take sleep_mutex to wake someone when this is not zero
+	std::mutex sleep_mutex;
+	std::condition_variable jobs_available;
+	bool stopping = false;
+
+	std::atomic<uint64_t> jobs_run{ 0 };
+	std::atomic<uint64_t> steals{ 0 };
+
+	void Push(QueuedJob job);
+	bool TryRun();
+	bool TryTake(QueuedJob& job);
+	void Finish(JobCounter* counter);
+	void WorkerLoop(uint32_t worker);
+	uint32_t CurrentWorker() const;
+};
@@ -0,0 +1,296 @@
+#include "JobSystemTests.h"
+
+#include <algorithm>
+#include <atomic>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "JobSystem.h"
+#include "FrustumCulling.h"
+#include "SceneGraph.h"
+#include "Benchmark.h"
+
+namespace {
+	const uint32_t BENCH_FRAMES = 50;
+
+	bool Check(bool condition, const std::string& what) {
+		if (!condition) {
+			std::cout << "FAILED: " << what << std::endl;
+		}
+		return condition;
+	}
+
+	bool TestIndependentJobs(JobSystem& jobs) {
+		const int JOB_COUNT = 20000;
+		std::atomic<int> done{ 0 };
+		JobCounter counter;
+		for (int i = 0; i < JOB_COUNT; ++i) {
+			jobs.Run([&done]() { done.fetch_add(1, std::memory_order_relaxed); }, &counter);
+		}
+		jobs.Wait(counter);
+		return Check(done.load() == JOB_COUNT && counter.IsDone(), "every independent job ran once before Wait returned");
+	}
+
+	bool TestParallelFor(JobSystem& jobs) {
+		for (size_t count : { 0, 1, 7, 1000, 100003 }) {
+			for (size_t grain : { 1, 16, 4096 }) {
+				//Plain writes: ranges must not overlap, or ThreadSanitizer reports the race
+				std::vector<uint8_t> hits(count, 0);
+				jobs.ParallelFor(count, grain, [&hits](size_t begin, size_t end) {
+					for (size_t i = begin; i < end; ++i) {
+						++hits[i];
+					}
+				});
+				if (!Check(std::all_of(hits.begin(), hits.end(), [](uint8_t hit) { return hit == 1; }),
+					"ParallelFor visits every index once (count " + std::to_string(count) + ", grain " + std::to_string(grain) + ")")) {
+					return false;
+				}
+			}
+		}
+		return true;
+	}
+
+	bool TestDependencies(JobSystem& jobs) {
+		//Producers fill plain memory, the consumer may only start once all of them are done
+		const size_t VALUES = 256;
+		std::vector<uint64_t> values(VALUES, 0);
+		uint64_t sum = 0;
+		uint64_t doubled = 0;
+
+		JobCounter produced;
+		JobCounter consumed;
+		JobCounter finished;
+		for (size_t i = 0; i < VALUES; ++i) {
+			jobs.Run([&values, i]() { values[i] = i + 1; }, &produced);
+		}
+		jobs.RunAfter(produced, [&values, &sum]() {
+			for (uint64_t value : values) {
+				sum += value;
+			}
+		}, &consumed);
+		jobs.RunAfter(consumed, [&sum, &doubled]() { doubled = sum * 2; }, &finished);
+		jobs.Wait(finished);
+
+		uint64_t expected = VALUES * (VALUES + 1) / 2;
+		if (!Check(sum == expected && doubled == expected * 2, "dependent jobs see their dependencies' results")) {
+			return false;
+		}
+
+		//A dependency that is already done doesn't hold anything back
+		bool ran = false;
+		JobCounter after_done;
+		jobs.RunAfter(produced, [&ran]() { ran = true; }, &after_done);
+		jobs.Wait(after_done);
+		return Check(ran, "job after a finished dependency runs");
+	}
+
+	bool TestNestedWaits(JobSystem& jobs) {
+		//Every outer job waits on inner jobs: waiting threads must run jobs, or the workers all block each other
+		const size_t OUTER = 64;
+		const size_t INNER = 1000;
+		std::vector<uint64_t> sums(OUTER, 0);
+		JobCounter outer;
+		for (size_t o = 0; o < OUTER; ++o) {
+			jobs.Run([&jobs, &sums, o]() {
+				std::vector<uint64_t> partial(INNER, 0);
+				jobs.ParallelFor(INNER, 10, [&partial](size_t begin, size_t end) {
+					for (size_t i = begin; i < end; ++i) {
+						partial[i] = i;
+					}
+				});
+				for (uint64_t value : partial) {
+					sums[o] += value;
+				}
+			}, &outer);
+		}
+		jobs.Wait(outer);
+
+		uint64_t expected = INNER * (INNER - 1) / 2;
+		return Check(std::all_of(sums.begin(), sums.end(), [expected](uint64_t sum) { return sum == expected; }),
+			"jobs waiting on their own jobs finish");
+	}
+
+	bool TestStopDrains(uint32_t worker_count) {
+		std::atomic<int> done{ 0 };
+		{
+			JobSystem jobs;
+			jobs.Start(worker_count);
+			for (int i = 0; i < 1000; ++i) {
+				jobs.Run([&jobs, &done]() {
+					//Queued while Stop may already be waiting for the workers
+					jobs.Run([&done]() { done.fetch_add(1, std::memory_order_relaxed); });
+					done.fetch_add(1, std::memory_order_relaxed);
+				});
+			}
+			jobs.Stop();
+		}
+		return Check(done.load() == 2000, "Stop runs every queued job");
+	}
+
+	//Per frame work the renderer does on the CPU, for the scaling table
+	struct Workload {
+		CullingVolumes volumes;
+		Frustum frustum;
+		std::vector<glm::vec3> positions;
+		std::vector<glm::quat> rotations;
+		std::vector<glm::mat4> world;
+		std::vector<uint32_t> visible;
+	};
+
+	//Each range culls into its own part of visible, the counts are added up at the end
+	size_t CullFrame(JobSystem& jobs, Workload& workload) {
+		std::atomic<size_t> visible_count{ 0 };
+		jobs.ParallelFor(workload.volumes.Size(), 4096, [&workload, &visible_count](size_t begin, size_t end) {
+			size_t written = workload.volumes.Cull(workload.frustum, CullShape::AABB, begin, end - begin, &workload.visible[begin]);
+			visible_count.fetch_add(written, std::memory_order_relaxed);
+		});
+		return visible_count.load();
+	}
+
+	void TransformFrame(JobSystem& jobs, Workload& workload) {
+		const glm::mat4 parent = glm::translate(glm::mat4(1.0f), glm::vec3(1.0f, 2.0f, 3.0f));
+		jobs.ParallelFor(workload.world.size(), 1024, [&workload, &parent](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; ++i) {
+				workload.world[i] = ComposeTransform(parent, workload.positions[i], workload.rotations[i], glm::vec3(1.0f));
+			}
+		});
+	}
+}
+
+bool RunJobSystemSelfTest() {
+	std::vector<uint32_t> worker_counts = { 0, 1, 3 };
+	uint32_t hardware_threads = std::thread::hardware_concurrency();
+	if (hardware_threads > 4) {
+		worker_counts.push_back(hardware_threads - 1);
+	}
+
+	//Never started: everything runs on the calling thread
+	{
+		JobSystem jobs;
+		if (!TestIndependentJobs(jobs) || !TestParallelFor(jobs) || !TestDependencies(jobs) || !TestNestedWaits(jobs)) {
+			std::cout << "  with the job system not started" << std::endl;
+			return false;
+		}
+	}
+
+	for (uint32_t worker_count : worker_counts) {
+		JobSystem jobs;
+		jobs.Start(worker_count);
+		if (!Check(jobs.GetWorkerCount() == worker_count, "Start(n) starts exactly n workers") ||
+			!TestIndependentJobs(jobs) || !TestParallelFor(jobs) || !TestDependencies(jobs) || !TestNestedWaits(jobs) ||
+			!TestStopDrains(worker_count)) {
+			std::cout << "  with " << worker_count << " workers" << std::endl;
+			return false;
+		}
+	}
+
+	//Start() sizes itself to the machine, the caller's thread is the one not given a worker
+	{
+		JobSystem jobs;
+		jobs.Start();
+		uint32_t expected = hardware_threads > 1 ? hardware_threads - 1 : 0;
+		if (!Check(jobs.GetWorkerCount() == expected, "Start() uses one worker per hardware thread but the caller's") ||
+			!TestParallelFor(jobs)) {
+			std::cout << "  with the auto-sized job system" << std::endl;
+			return false;
+		}
+	}
+
+	std::cout << "Job system self test passed (worker counts";
+	for (uint32_t worker_count : worker_counts) {
+		std::cout << " " << worker_count;
+	}
+	std::cout << ")" << std::endl;
+	return true;
+}
+
+void RunJobSystemBenchmark(uint64_t object_count) {
+	std::mt19937 random(5);
+	std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+	std::uniform_real_distribution<float> extent(0.05f, 2.0f);
+	std::uniform_real_distribution<float> angle(0.0f, 6.2831853f);
+
+	Workload workload;
+	glm::mat4 projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 100.0f);
+	glm::mat4 view = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, -1.0f, 0.0f));
+	workload.frustum = ExtractFrustum(projection * view);
+	workload.volumes.Reserve(object_count);
+	workload.positions.reserve(object_count);
+	workload.rotations.reserve(object_count);
+	for (uint64_t i = 0; i < object_count; ++i) {
+		glm::vec3 centre(position(random), position(random), position(random));
+		workload.volumes.Add(centre, glm::vec3(extent(random), extent(random), extent(random)));
+		workload.positions.push_back(centre);
+		workload.rotations.push_back(glm::angleAxis(angle(random), glm::normalize(glm::vec3(1.0f, 2.0f, 3.0f))));
+	}
+	workload.world.resize(object_count);
+	workload.visible.resize(object_count);
+
+	std::vector<uint32_t> thread_counts;
+	uint32_t hardware_threads = std::max(1u, std::thread::hardware_concurrency());
+	for (uint32_t threads = 1; threads < hardware_threads; threads *= 2) {
+		thread_counts.push_back(threads);
+	}
+	thread_counts.push_back(hardware_threads);
+
+	std::cout << std::fixed << std::setprecision(3)
+		<< "Job system benchmark, " << object_count << " objects, ms per frame over " << BENCH_FRAMES << " frames:" << std::endl
+		<< "  threads     cull  speedup  transforms  speedup  steals/frame  empty job (ns)" << std::endl;
+
+	double single_cull_ms = 0.0;
+	double single_transform_ms = 0.0;
+	size_t single_visible = 0;
+	bool all_matched = true;
+	for (uint32_t threads : thread_counts) {
+		JobSystem jobs;
+		jobs.Start(threads - 1);		//The calling thread works too
+
+		size_t visible = CullFrame(jobs, workload);
+		TransformFrame(jobs, workload);
+		JobSystem::Stats before = jobs.GetStats();
+
+		BenchClock::time_point start = BenchClock::now();
+		for (uint32_t frame = 0; frame < BENCH_FRAMES; ++frame) {
+			visible = CullFrame(jobs, workload);
+		}
+		double cull_ms = ElapsedMs(start) / BENCH_FRAMES;
+
+		start = BenchClock::now();
+		for (uint32_t frame = 0; frame < BENCH_FRAMES; ++frame) {
+			TransformFrame(jobs, workload);
+		}
+		double transform_ms = ElapsedMs(start) / BENCH_FRAMES;
+		double steals_per_frame = static_cast<double>(jobs.GetStats().steals - before.steals) / (2 * BENCH_FRAMES);
+
+		//Scheduling overhead alone: queue, run and count jobs that do nothing
+		const int EMPTY_JOBS = 100000;
+		JobCounter counter;
+		start = BenchClock::now();
+		for (int i = 0; i < EMPTY_JOBS; ++i) {
+			jobs.Run([]() {}, &counter);
+		}
+		jobs.Wait(counter);
+		double empty_ns = ElapsedMs(start) * 1e6 / EMPTY_JOBS;
+
+		if (threads == 1) {
+			single_cull_ms = cull_ms;
+			single_transform_ms = transform_ms;
+			single_visible = visible;
+		}
+		bool matched = visible == single_visible;
+		all_matched = all_matched && matched;
+
+		std::cout << std::setw(9) << threads << std::setw(9) << cull_ms << std::setw(8) << std::setprecision(2)
+			<< single_cull_ms / cull_ms << "x" << std::setprecision(3) << std::setw(12) << transform_ms << std::setw(8)
+			<< std::setprecision(2) << single_transform_ms / transform_ms << "x" << std::setprecision(1) << std::setw(14)
+			<< steals_per_frame << std::setw(16) << empty_ns << std::setprecision(3) << (matched ? "" : "  MISMATCH") << std::endl;
+	}
+
+	std::cout << (all_matched ? "Visible counts match at every thread count" : "FAILED: visible count depends on the thread count") << std::endl;
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <cstdint>
+
+//CPU only checks and timings of the job scheduler, no device needed. Run with --job-test / --job-bench.
+//Build with -fsanitize=thread (clang, gcc) to run the self test under ThreadSanitizer
+
+//Independent jobs, parallel-for coverage, dependencies, jobs waiting on jobs and Stop draining the queues, each with
+//several worker counts. Returns false on failure
+bool RunJobSystemSelfTest();
+
+//Frustum culling and transform composition of object_count objects spread with ParallelFor, from one thread up to
+//every hardware thread, plus the cost of an empty job
+void RunJobSystemBenchmark(uint64_t object_count);
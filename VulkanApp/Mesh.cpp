@@ -0,0 +1,187 @@
+#include "Mesh.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+Mesh::Mesh(VkDevice logical_device, DeviceAllocator& device_allocator, StagingRing& staging,
+	const void* vertex_data, uint32_t count, VkDeviceSize stride, const std::vector<uint32_t>& indices,
+	const PositionDecode& decode) {
+	device = logical_device;
+	allocator = &device_allocator;
+	vertex_count = count;
+	index_count = static_cast<uint32_t>(indices.size());
+	position_decode = decode;
+
+	VkDeviceSize vertex_size = stride * count;
+	VkDeviceSize index_size = sizeof(uint32_t) * indices.size();
+
+	vertex_buffer = CreateDeviceLocalBuffer(device, device_allocator, vertex_size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, vertex_memory);
+	index_buffer = CreateDeviceLocalBuffer(device, device_allocator, index_size, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, index_memory);
+
+	staging.UploadBuffer(vertex_buffer, 0, vertex_data, vertex_size, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
+	staging.UploadBuffer(index_buffer, 0, indices.data(), index_size, VK_ACCESS_INDEX_READ_BIT);
+}
+
+VkBuffer CreateDeviceLocalBuffer(VkDevice logical_device, DeviceAllocator& device_allocator, VkDeviceSize size,
+	VkBufferUsageFlags usage, DeviceAllocation& memory) {
+	VkBufferCreateInfo buffer_create_info = {};
+	buffer_create_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	buffer_create_info.size = size;
+	buffer_create_info.usage = usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT;		//Filled by the staging ring
+	buffer_create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;				//The ring transfers ownership to graphics
+
+	VkBuffer buffer;
+	if (vkCreateBuffer(logical_device, &buffer_create_info, nullptr, &buffer) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create a mesh buffer");
+	}
+
+	try {
+		memory = device_allocator.AllocateForBuffer(buffer, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	}
+	catch (...) {
+		vkDestroyBuffer(logical_device, buffer, nullptr);
+		throw;
+	}
+
+	return buffer;
+}
+
+void Mesh::Bind(VkCommandBuffer command_buffer, VkPipelineLayout pipeline_layout, VkBuffer instance_buffer) const {
+	vkCmdPushConstants(command_buffer, pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(PositionDecode), &position_decode);
+
+	VkBuffer buffers[] = { vertex_buffer, instance_buffer };
+	VkDeviceSize offsets[] = { 0, 0 };
+	vkCmdBindVertexBuffers(command_buffer, 0, 2, buffers, offsets);
+	vkCmdBindIndexBuffer(command_buffer, index_buffer, 0, VK_INDEX_TYPE_UINT32);
+}
+
+void Mesh::Draw(VkCommandBuffer command_buffer, VkPipelineLayout pipeline_layout, VkBuffer instance_buffer, uint32_t instance_count) const {
+	Bind(command_buffer, pipeline_layout, instance_buffer);
+	vkCmdDrawIndexed(command_buffer, index_count, instance_count, 0, 0, 0);
+}
+
+void Mesh::DestroyBuffers() {
+	vkDestroyBuffer(device, vertex_buffer, nullptr);
+	vkDestroyBuffer(device, index_buffer, nullptr);
+	if (allocator != nullptr) {
+		allocator->Free(vertex_memory);
+		allocator->Free(index_memory);
+	}
+	vertex_buffer = VK_NULL_HANDLE;
+	index_buffer = VK_NULL_HANDLE;
+}
+
+InstanceBatch::InstanceBatch(VkDevice logical_device, DeviceAllocator& device_allocator, StagingRing& staging,
+	uint32_t mesh, const std::vector<InstanceData>& instances) {
+	device = logical_device;
+	allocator = &device_allocator;
+	mesh_index = mesh;
+	instance_count = static_cast<uint32_t>(instances.size());
+
+	VkDeviceSize size = sizeof(InstanceData) * instances.size();
+	instance_buffer = CreateDeviceLocalBuffer(device, device_allocator, size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, instance_memory);
+	staging.UploadBuffer(instance_buffer, 0, instances.data(), size, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
+}
+
+void InstanceBatch::DestroyBuffer() {
+	vkDestroyBuffer(device, instance_buffer, nullptr);
+	if (allocator != nullptr) {
+		allocator->Free(instance_memory);
+	}
+	instance_buffer = VK_NULL_HANDLE;
+}
+
+void GenerateTriangleGrid(uint64_t triangle_count, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices) {
+	vertices.clear();
+	indices.clear();
+
+	if (triangle_count <= 1) {
+		vertices = {
+			{ { 0.0f, -0.4f, 0.0f }, { 0.0f, 0.0f, -1.0f }, { 0.5f, 0.0f }, { 1.0f, 0.0f, 0.0f } },
+			{ { 0.4f, 0.4f, 0.0f }, { 0.0f, 0.0f, -1.0f }, { 1.0f, 1.0f }, { 0.0f, 1.0f, 0.0f } },
+			{ { -0.4f, 0.4f, 0.0f }, { 0.0f, 0.0f, -1.0f }, { 0.0f, 1.0f }, { 0.0f, 0.0f, 1.0f } }
+		};
+		indices = { 0, 1, 2 };
+		return;
+	}
+
+	//Two triangles per cell, the last cell may only get one
+	uint64_t cell_count = (triangle_count + 1) / 2;
+	uint32_t columns = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(cell_count))));
+	uint32_t rows = static_cast<uint32_t>((cell_count + columns - 1) / columns);
+	if (static_cast<uint64_t>(columns + 1) * (rows + 1) > UINT32_MAX) {
+		throw std::runtime_error("Too many triangles for 32 bit indices");
+	}
+
+	const float extent = 0.9f;
+	vertices.reserve(static_cast<size_t>(columns + 1) * (rows + 1));
+	for (uint32_t y = 0; y <= rows; ++y) {
+		for (uint32_t x = 0; x <= columns; ++x) {
+			float u = static_cast<float>(x) / columns;
+			float v = static_cast<float>(y) / rows;
+			vertices.push_back({ { (u * 2.0f - 1.0f) * extent, (v * 2.0f - 1.0f) * extent, 0.0f }, { 0.0f, 0.0f, -1.0f }, { u, v }, { u, v, 1.0f - u } });
+		}
+	}
+
+	//Clockwise on screen (y points down), matching the pipeline's front face
+	indices.reserve(static_cast<size_t>(triangle_count * 3));
+	for (uint64_t cell = 0; cell < cell_count; ++cell) {
+		uint32_t x = static_cast<uint32_t>(cell % columns);
+		uint32_t y = static_cast<uint32_t>(cell / columns);
+		uint32_t top_left = y * (columns + 1) + x;
+		uint32_t top_right = top_left + 1;
+		uint32_t bottom_left = top_left + columns + 1;
+		uint32_t bottom_right = bottom_left + 1;
+
+		indices.insert(indices.end(), { top_left, top_right, bottom_right });
+		if (indices.size() < triangle_count * 3) {
+			indices.insert(indices.end(), { top_left, bottom_right, bottom_left });
+		}
+	}
+}
+
+void GenerateInstanceGrid(uint32_t instance_count, std::vector<InstanceData>& instances, float spread) {
+	instances.clear();
+	if (instance_count <= 1) {
+		instances.push_back({ glm::mat4(1.0f), glm::vec4(1.0f) });
+		return;
+	}
+
+	uint32_t columns = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(instance_count))));
+	float cell_size = 2.0f / columns;
+
+	instances.reserve(instance_count);
+	for (uint32_t i = 0; i < instance_count; ++i) {
+		float u = (static_cast<float>(i % columns) + 0.5f) / columns;
+		float v = (static_cast<float>(i / columns) + 0.5f) / columns;
+
+		glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3((u * 2.0f - 1.0f) * spread, (v * 2.0f - 1.0f) * spread, 0.0f));
+		model = glm::scale(model, glm::vec3(cell_size * 0.5f));
+		instances.push_back({ model, glm::vec4(1.0f - 0.5f * u, 0.5f + 0.5f * v, 1.0f, 1.0f) });
+	}
+}
+
+glm::vec4 ComputeBoundingSphere(const std::vector<Vertex>& vertices, float padding) {
+	if (vertices.empty()) {
+		return glm::vec4(0.0f);
+	}
+
+	//Centred on the AABB, not minimal but close enough for culling
+	glm::vec3 min = vertices[0].pos;
+	glm::vec3 max = vertices[0].pos;
+	for (const Vertex& vertex : vertices) {
+		min = glm::min(min, vertex.pos);
+		max = glm::max(max, vertex.pos);
+	}
+	glm::vec3 centre = (min + max) * 0.5f;
+
+	float radius_squared = 0.0f;
+	for (const Vertex& vertex : vertices) {
+		glm::vec3 offset = vertex.pos - centre;
+		radius_squared = std::max(radius_squared, glm::dot(offset, offset));
+	}
+	return glm::vec4(centre, std::sqrt(radius_squared) + padding);
+}
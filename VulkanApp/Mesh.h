@@ -0,0 +1,107 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <vector>
+
+#include "Utilities.h"
+#include "DeviceAllocator.h"
+#include "StagingRing.h"
+#include "MeshQuantizer.h"
+
+//Device local vertex + index buffer pair. Contents go through the staging ring,
+//so they are ready for the first frame that waits on the ring's semaphores
+class Mesh
+{
+public:
+	Mesh() {}
+	Mesh(VkDevice logical_device, DeviceAllocator& device_allocator, StagingRing& staging,
+		const void* vertex_data, uint32_t count, VkDeviceSize stride, const std::vector<uint32_t>& indices,
+		const PositionDecode& decode = {});
+
+	//Any vertex type with VertexTraits (Vertex, QuantizedVertex<P>), the pipeline must use the same one
+	template<typename V>
+	Mesh(VkDevice logical_device, DeviceAllocator& device_allocator, StagingRing& staging,
+		const std::vector<V>& vertices, const std::vector<uint32_t>& indices, const PositionDecode& decode = {})
+		: Mesh(logical_device, device_allocator, staging, vertices.data(), static_cast<uint32_t>(vertices.size()), sizeof(V), indices, decode) {}
+
+	uint32_t GetVertexCount() const { return vertex_count; }
+	uint32_t GetIndexCount() const { return index_count; }
+	VkBuffer GetVertexBuffer() const { return vertex_buffer; }
+	VkBuffer GetIndexBuffer() const { return index_buffer; }
+
+	const PositionDecode& GetPositionDecode() const { return position_decode; }
+
+	//Pushes the position decode and binds the mesh and instance buffers, ready for indexed draws
+	void Bind(VkCommandBuffer command_buffer, VkPipelineLayout pipeline_layout, VkBuffer instance_buffer) const;
+	//Bind, then draws every index once per instance
+	void Draw(VkCommandBuffer command_buffer, VkPipelineLayout pipeline_layout, VkBuffer instance_buffer, uint32_t instance_count) const;
+
+	void DestroyBuffers();
+
+private:
+	VkDevice device = VK_NULL_HANDLE;
+	DeviceAllocator* allocator = nullptr;
+
+	uint32_t vertex_count = 0;
+	VkBuffer vertex_buffer = VK_NULL_HANDLE;
+	DeviceAllocation vertex_memory;
+
+	uint32_t index_count = 0;
+	VkBuffer index_buffer = VK_NULL_HANDLE;
+	DeviceAllocation index_memory;
+
+	PositionDecode position_decode;
+};
+
+//Copies of one mesh drawn by a single instanced draw. The instance data is uploaded once through the staging ring
+class InstanceBatch
+{
+public:
+	InstanceBatch() {}
+	InstanceBatch(VkDevice logical_device, DeviceAllocator& device_allocator, StagingRing& staging,
+		uint32_t mesh_index, const std::vector<InstanceData>& instances);
+
+	uint32_t GetMeshIndex() const { return mesh_index; }
+	uint32_t GetInstanceCount() const { return instance_count; }
+	VkBuffer GetInstanceBuffer() const { return instance_buffer; }
+
+	void DestroyBuffer();
+
+private:
+	VkDevice device = VK_NULL_HANDLE;
+	DeviceAllocator* allocator = nullptr;
+
+	uint32_t mesh_index = 0;
+	uint32_t instance_count = 0;
+	VkBuffer instance_buffer = VK_NULL_HANDLE;
+	DeviceAllocation instance_memory;
+};
+
+//One draw call over a range of a batch's instances. Batches split into many draws stand in for scenes of separate objects
+struct BatchDraw {
+	uint32_t batch;
+	uint32_t first_instance;
+	uint32_t instance_count;
+	uint32_t material;			//Entry of the material table, pushed per draw when drawing bindless
+};
+
+//Vertex input of the scene pipelines: mesh vertices on binding 0, InstanceData on binding 1
+template<typename V>
+using SceneVertexInput = VertexInput<VertexBinding<V>, VertexBinding<InstanceData, VK_VERTEX_INPUT_RATE_INSTANCE>>;
+
+//Device local buffer, filled by the staging ring (usage gets TRANSFER_DST added)
+VkBuffer CreateDeviceLocalBuffer(VkDevice logical_device, DeviceAllocator& device_allocator, VkDeviceSize size,
+	VkBufferUsageFlags usage, DeviceAllocation& memory);
+
+//Grid of small triangles covering most of the screen, for pushing large triangle counts through the pipeline.
+//A count of 1 gives the original coloured triangle
+void GenerateTriangleGrid(uint64_t triangle_count, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+
+//Square grid of scaled down copies covering the same area as one, tinted by position. A count of 1 is the identity.
+//spread > 1 moves the copies apart (keeping their size), pushing part of the grid off screen
+void GenerateInstanceGrid(uint32_t instance_count, std::vector<InstanceData>& instances, float spread = 1.0f);
+
+//Sphere around the vertices (xyz centre, w radius), grown by padding, e.g. the mesh's quantization error
+glm::vec4 ComputeBoundingSphere(const std::vector<Vertex>& vertices, float padding = 0.0f);
@@ -0,0 +1,257 @@
+#include "MeshQuantizer.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <iomanip>
+#include <type_traits>
+
+#include <glm/gtc/packing.hpp>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MESH_QUANTIZER_SSE2
+#endif
+
+namespace {
+	//How each position type maps the mesh AABB, see QuantizedVertex
+	template<typename P> struct PositionEncoding;
+
+	template<> struct PositionEncoding<glm::u16vec4> {
+		static PositionDecode Decode(const MeshBounds& bounds) {
+			PositionDecode decode;
+			decode.offset = glm::vec4(bounds.min, 0.0f);
+			decode.scale = glm::vec4(bounds.max - bounds.min, 0.0f);
+			return decode;
+		}
+		static glm::u16vec4 Encode(const glm::vec3& unit) { return glm::packUnorm<uint16_t>(glm::vec4(unit, 0.0f)); }
+		static glm::vec3 Fetch(const glm::u16vec4& position) { return glm::vec3(glm::unpackUnorm<float>(position)); }
+	};
+
+	template<> struct PositionEncoding<PackedHalf4> {
+		static PositionDecode Decode(const MeshBounds& bounds) {
+			PositionDecode decode;
+			decode.offset = glm::vec4((bounds.min + bounds.max) * 0.5f, 0.0f);
+			decode.scale = glm::vec4((bounds.max - bounds.min) * 0.5f, 0.0f);
+			return decode;
+		}
+		static PackedHalf4 Encode(const glm::vec3& unit) { return PackedHalf4(glm::vec4(unit, 0.0f)); }
+		static glm::vec3 Fetch(const PackedHalf4& position) { return glm::vec3(glm::unpackHalf(position.bits)); }
+	};
+
+	//Flat axes (extent 0) quantize to 0 and decode back to the offset
+	glm::vec3 InverseScale(const PositionDecode& decode) {
+		glm::vec3 inverse;
+		for (int axis = 0; axis < 3; ++axis) {
+			inverse[axis] = decode.scale[axis] > 0.0f ? 1.0f / decode.scale[axis] : 0.0f;
+		}
+		return inverse;
+	}
+
+	template<typename P>
+	QuantizedVertex<P> QuantizeVertex(const Vertex& vertex, const glm::vec3& offset, const glm::vec3& inverse_scale) {
+		QuantizedVertex<P> quantized;
+		quantized.pos = PositionEncoding<P>::Encode((vertex.pos - offset) * inverse_scale);
+		quantized.normal = glm::packSnorm<int16_t>(OctahedralEncode(vertex.normal));
+		quantized.uv = PackedHalf2(vertex.uv);
+		quantized.col = glm::packUnorm<uint8_t>(glm::vec4(vertex.col, 1.0f));
+		return quantized;
+	}
+
+#ifdef MESH_QUANTIZER_SSE2
+	const __m128 SIGN_MASK = _mm_set1_ps(-0.0f);
+	const __m128 ONE = _mm_set1_ps(1.0f);
+
+	//std::round (half away from zero) like glm::packUnorm/packSnorm, so both paths give the same bits
+	__m128i RoundToInt(__m128 value) {
+		__m128 truncated = _mm_cvtepi32_ps(_mm_cvttps_epi32(value));
+		__m128 fraction = _mm_andnot_ps(SIGN_MASK, _mm_sub_ps(value, truncated));
+		__m128 away = _mm_or_ps(_mm_and_ps(value, SIGN_MASK), ONE);
+		__m128 round_up = _mm_cmpge_ps(fraction, _mm_set1_ps(0.5f));
+		return _mm_cvttps_epi32(_mm_add_ps(truncated, _mm_and_ps(round_up, away)));
+	}
+
+	__m128i PackUnorm(__m128 value, float max_value) {
+		value = _mm_min_ps(_mm_max_ps(value, _mm_setzero_ps()), ONE);
+		return RoundToInt(_mm_mul_ps(value, _mm_set1_ps(max_value)));
+	}
+
+	__m128i PackSnorm(__m128 value, float max_value) {
+		value = _mm_min_ps(_mm_max_ps(value, _mm_set1_ps(-1.0f)), ONE);
+		return RoundToInt(_mm_mul_ps(value, _mm_set1_ps(max_value)));
+	}
+
+	//Four vertices per iteration, one per lane. Half conversion stays scalar: F16C is not part of the SSE2 baseline
+	template<typename P>
+	void QuantizeBatch(const Vertex* vertices, QuantizedVertex<P>* quantized, size_t count, const glm::vec3& offset, const glm::vec3& inverse_scale) {
+		alignas(16) int32_t position[3][4];
+		alignas(16) float unit[3][4];
+		alignas(16) int32_t normal[2][4];
+		alignas(16) int32_t colour[3][4];
+
+		for (size_t i = 0; i + 4 <= count; i += 4) {
+			const Vertex* v = vertices + i;
+
+			for (int axis = 0; axis < 3; ++axis) {
+				__m128 p = _mm_setr_ps(v[0].pos[axis], v[1].pos[axis], v[2].pos[axis], v[3].pos[axis]);
+				p = _mm_mul_ps(_mm_sub_ps(p, _mm_set1_ps(offset[axis])), _mm_set1_ps(inverse_scale[axis]));
+				if constexpr (std::is_same_v<P, glm::u16vec4>) {
+					_mm_store_si128(reinterpret_cast<__m128i*>(position[axis]), PackUnorm(p, 65535.0f));
+				}
+				else {
+					_mm_store_ps(unit[axis], p);
+				}
+			}
+
+			//Octahedral encoding, same operations as OctahedralEncode
+			__m128 nx = _mm_setr_ps(v[0].normal.x, v[1].normal.x, v[2].normal.x, v[3].normal.x);
+			__m128 ny = _mm_setr_ps(v[0].normal.y, v[1].normal.y, v[2].normal.y, v[3].normal.y);
+			__m128 nz = _mm_setr_ps(v[0].normal.z, v[1].normal.z, v[2].normal.z, v[3].normal.z);
+			__m128 sum = _mm_add_ps(_mm_add_ps(_mm_andnot_ps(SIGN_MASK, nx), _mm_andnot_ps(SIGN_MASK, ny)), _mm_andnot_ps(SIGN_MASK, nz));
+			__m128 inverse_sum = _mm_div_ps(ONE, _mm_max_ps(sum, _mm_set1_ps(FLT_MIN)));
+			__m128 ex = _mm_mul_ps(nx, inverse_sum);
+			__m128 ey = _mm_mul_ps(ny, inverse_sum);
+			__m128 folded_x = _mm_mul_ps(_mm_sub_ps(ONE, _mm_andnot_ps(SIGN_MASK, ey)), _mm_or_ps(_mm_and_ps(ex, SIGN_MASK), ONE));
+			__m128 folded_y = _mm_mul_ps(_mm_sub_ps(ONE, _mm_andnot_ps(SIGN_MASK, ex)), _mm_or_ps(_mm_and_ps(ey, SIGN_MASK), ONE));
+			__m128 lower = _mm_cmplt_ps(nz, _mm_setzero_ps());
+			ex = _mm_or_ps(_mm_and_ps(lower, folded_x), _mm_andnot_ps(lower, ex));
+			ey = _mm_or_ps(_mm_and_ps(lower, folded_y), _mm_andnot_ps(lower, ey));
+			_mm_store_si128(reinterpret_cast<__m128i*>(normal[0]), PackSnorm(ex, 32767.0f));
+			_mm_store_si128(reinterpret_cast<__m128i*>(normal[1]), PackSnorm(ey, 32767.0f));
+
+			for (int channel = 0; channel < 3; ++channel) {
+				__m128 c = _mm_setr_ps(v[0].col[channel], v[1].col[channel], v[2].col[channel], v[3].col[channel]);
+				_mm_store_si128(reinterpret_cast<__m128i*>(colour[channel]), PackUnorm(c, 255.0f));
+			}
+
+			for (int lane = 0; lane < 4; ++lane) {
+				QuantizedVertex<P>& out = quantized[i + lane];
+				if constexpr (std::is_same_v<P, glm::u16vec4>) {
+					out.pos = glm::u16vec4(position[0][lane], position[1][lane], position[2][lane], 0);
+				}
+				else {
+					out.pos = PositionEncoding<P>::Encode(glm::vec3(unit[0][lane], unit[1][lane], unit[2][lane]));
+				}
+				out.normal = glm::i16vec2(normal[0][lane], normal[1][lane]);
+				out.uv = PackedHalf2(v[lane].uv);
+				out.col = glm::u8vec4(colour[0][lane], colour[1][lane], colour[2][lane], 255);
+			}
+		}
+	}
+#endif
+}
+
+glm::vec2 OctahedralEncode(const glm::vec3& normal) {
+	//Project onto the octahedron |x| + |y| + |z| = 1, then fold the lower half over the diagonals.
+	//Zero normals come out as (0, 0)
+	float sum = std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+	float inverse_sum = 1.0f / std::max(sum, FLT_MIN);
+	glm::vec2 encoded = glm::vec2(normal.x, normal.y) * inverse_sum;
+	if (normal.z < 0.0f) {
+		encoded = glm::vec2((1.0f - std::abs(encoded.y)) * std::copysign(1.0f, encoded.x),
+			(1.0f - std::abs(encoded.x)) * std::copysign(1.0f, encoded.y));
+	}
+	return encoded;
+}
+
+glm::vec3 OctahedralDecode(const glm::vec2& encoded) {
+	glm::vec3 normal(encoded.x, encoded.y, 1.0f - std::abs(encoded.x) - std::abs(encoded.y));
+	float fold = std::max(-normal.z, 0.0f);
+	normal.x += normal.x >= 0.0f ? -fold : fold;
+	normal.y += normal.y >= 0.0f ? -fold : fold;
+	return glm::normalize(normal);
+}
+
+MeshBounds ComputeMeshBounds(const std::vector<Vertex>& vertices) {
+	MeshBounds bounds;
+	if (vertices.empty()) {
+		return bounds;
+	}
+
+	bounds.min = vertices[0].pos;
+	bounds.max = vertices[0].pos;
+	for (const Vertex& vertex : vertices) {
+		bounds.min = glm::min(bounds.min, vertex.pos);
+		bounds.max = glm::max(bounds.max, vertex.pos);
+	}
+	return bounds;
+}
+
+template<typename P>
+PositionDecode QuantizeVertices(const std::vector<Vertex>& vertices, std::vector<QuantizedVertex<P>>& quantized, bool use_simd) {
+	PositionDecode decode = PositionEncoding<P>::Decode(ComputeMeshBounds(vertices));
+	glm::vec3 offset = glm::vec3(decode.offset);
+	glm::vec3 inverse_scale = InverseScale(decode);
+
+	quantized.resize(vertices.size());
+	size_t done = 0;
+#ifdef MESH_QUANTIZER_SSE2
+	if (use_simd) {
+		done = vertices.size() & ~size_t(3);
+		QuantizeBatch(vertices.data(), quantized.data(), done, offset, inverse_scale);
+	}
+#endif
+	for (size_t i = done; i < vertices.size(); ++i) {
+		quantized[i] = QuantizeVertex<P>(vertices[i], offset, inverse_scale);
+	}
+
+	return decode;
+}
+
+template<typename P>
+QuantizationReport MeasureQuantizationError(const std::vector<Vertex>& vertices, const std::vector<QuantizedVertex<P>>& quantized,
+	const PositionDecode& decode) {
+	QuantizationReport report;
+	report.vertex_count = vertices.size();
+	report.source_bytes = vertices.size() * sizeof(Vertex);
+	report.quantized_bytes = quantized.size() * sizeof(QuantizedVertex<P>);
+
+	MeshBounds bounds = ComputeMeshBounds(vertices);
+	float diagonal = glm::length(bounds.max - bounds.min);
+
+	double squared_error_sum = 0.0;
+	float min_normal_cos = 1.0f;
+	for (size_t i = 0; i < vertices.size() && i < quantized.size(); ++i) {
+		const Vertex& source = vertices[i];
+		const QuantizedVertex<P>& packed = quantized[i];
+
+		glm::vec3 position = glm::vec3(decode.offset) + PositionEncoding<P>::Fetch(packed.pos) * glm::vec3(decode.scale);
+		float position_error = glm::length(position - source.pos);
+		report.max_position_error = std::max(report.max_position_error, position_error);
+		squared_error_sum += static_cast<double>(position_error) * position_error;
+
+		if (glm::length(source.normal) > 0.0f) {
+			glm::vec3 normal = OctahedralDecode(glm::unpackSnorm<float>(packed.normal));
+			min_normal_cos = std::min(min_normal_cos, glm::dot(normal, glm::normalize(source.normal)));
+		}
+
+		glm::vec2 uv_error = glm::abs(glm::unpackHalf(packed.uv.bits) - source.uv);
+		report.max_uv_error = std::max(report.max_uv_error, std::max(uv_error.x, uv_error.y));
+
+		glm::vec3 colour_error = glm::abs(glm::vec3(glm::unpackUnorm<float>(packed.col)) - glm::clamp(source.col, 0.0f, 1.0f));
+		report.max_colour_error = std::max(report.max_colour_error, std::max(colour_error.x, std::max(colour_error.y, colour_error.z)));
+	}
+
+	if (!vertices.empty()) {
+		report.rms_position_error = static_cast<float>(std::sqrt(squared_error_sum / vertices.size()));
+	}
+	report.max_position_error_relative = diagonal > 0.0f ? report.max_position_error / diagonal : 0.0f;
+	report.max_normal_error_degrees = glm::degrees(std::acos(glm::clamp(min_normal_cos, -1.0f, 1.0f)));
+	return report;
+}
+
+void PrintQuantizationReport(std::ostream& out, const std::string& mesh_name, const QuantizationReport& report) {
+	double ratio = report.source_bytes > 0 ? 100.0 * report.quantized_bytes / report.source_bytes : 0.0;
+	out << "Quantized " << mesh_name << ": " << report.vertex_count << " vertices, "
+		<< report.source_bytes << " -> " << report.quantized_bytes << " bytes (" << std::fixed << std::setprecision(1) << ratio << "%) in "
+		<< std::setprecision(2) << report.quantize_ms << " ms" << std::defaultfloat << std::setprecision(4) << std::endl;
+	out << "  position error max " << report.max_position_error << " (" << report.max_position_error_relative * 100.0f
+		<< "% of AABB diagonal), rms " << report.rms_position_error << std::endl;
+	out << "  normal error max " << report.max_normal_error_degrees << " deg, uv error max " << report.max_uv_error
+		<< ", colour error max " << report.max_colour_error << std::setprecision(6) << std::endl;
+}
+
+template PositionDecode QuantizeVertices<glm::u16vec4>(const std::vector<Vertex>&, std::vector<QuantizedVertexUnorm16>&, bool);
+template PositionDecode QuantizeVertices<PackedHalf4>(const std::vector<Vertex>&, std::vector<QuantizedVertexHalf>&, bool);
+template QuantizationReport MeasureQuantizationError<glm::u16vec4>(const std::vector<Vertex>&, const std::vector<QuantizedVertexUnorm16>&, const PositionDecode&);
+template QuantizationReport MeasureQuantizationError<PackedHalf4>(const std::vector<Vertex>&, const std::vector<QuantizedVertexHalf>&, const PositionDecode&);
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "Utilities.h"
+
+//Compact vertex for large meshes, 20 bytes against the 44 of Vertex. Layout and locations match Vertex,
+//shader_quantized.vert decodes it:
+//	pos    - P = glm::u16vec4 (UNORM16 across the mesh AABB) or PackedHalf4 (half, AABB centre +-1), w unused
+//	normal - octahedral encoding, SNORM16
+//	uv     - half
+//	col    - UNORM8, alpha unused
+template<typename P>
+struct QuantizedVertex {
+	P pos;
+	glm::i16vec2 normal;
+	PackedHalf2 uv;
+	glm::u8vec4 col;
+};
+
+template<typename P> struct VertexTraits<QuantizedVertex<P>> {
+	static constexpr VertexAttribute attributes[] = {
+		VERTEX_ATTRIBUTE(QuantizedVertex<P>, pos), VERTEX_ATTRIBUTE(QuantizedVertex<P>, normal),
+		VERTEX_ATTRIBUTE(QuantizedVertex<P>, uv), VERTEX_ATTRIBUTE(QuantizedVertex<P>, col)
+	};
+};
+
+using QuantizedVertexUnorm16 = QuantizedVertex<glm::u16vec4>;
+using QuantizedVertexHalf = QuantizedVertex<PackedHalf4>;
+
+//Push constant block of shader_quantized.vert: position = offset + fetched position * scale.
+//The defaults leave full precision positions untouched
+struct PositionDecode {
+	glm::vec4 offset = glm::vec4(0.0f);
+	glm::vec4 scale = glm::vec4(1.0f);
+};
+
+struct MeshBounds {
+	glm::vec3 min = glm::vec3(0.0f);
+	glm::vec3 max = glm::vec3(0.0f);
+};
+
+//Precision lost by quantizing one mesh, measured by decoding every vertex again
+struct QuantizationReport {
+	size_t vertex_count = 0;
+	size_t source_bytes = 0;
+	size_t quantized_bytes = 0;
+	float max_position_error = 0.0f;		//Object space units
+	float rms_position_error = 0.0f;
+	float max_position_error_relative = 0.0f;	//Fraction of the AABB diagonal
+	float max_normal_error_degrees = 0.0f;
+	float max_uv_error = 0.0f;
+	float max_colour_error = 0.0f;
+	double quantize_ms = 0.0;
+};
+
+MeshBounds ComputeMeshBounds(const std::vector<Vertex>& vertices);
+
+//Quantizes every vertex and returns the decode for the mesh's push constants. The batch path uses SSE2
+//four vertices at a time when available, use_simd = false forces the scalar glm::pack* path
+template<typename P>
+PositionDecode QuantizeVertices(const std::vector<Vertex>& vertices, std::vector<QuantizedVertex<P>>& quantized, bool use_simd = true);
+
+template<typename P>
+QuantizationReport MeasureQuantizationError(const std::vector<Vertex>& vertices, const std::vector<QuantizedVertex<P>>& quantized,
+	const PositionDecode& decode);
+
+void PrintQuantizationReport(std::ostream& out, const std::string& mesh_name, const QuantizationReport& report);
+
+//Octahedral mapping of a normal to [-1, 1]^2, decoded the same way by shader_quantized.vert
+glm::vec2 OctahedralEncode(const glm::vec3& normal);
+glm::vec3 OctahedralDecode(const glm::vec2& encoded);
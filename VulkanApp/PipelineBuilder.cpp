@@ -0,0 +1,242 @@
+#include "PipelineBuilder.h"
+#include "StartupProfiler.h"
+
+#include <stdexcept>
+
+PipelineBuilder::~PipelineBuilder() {
+	Stop();
+}
+
+void PipelineBuilder::Start(VkDevice logical_device, VkPipelineCache pipeline_cache, uint32_t thread_count) {
+	device = logical_device;
+	cache = pipeline_cache;
+	stopping = false;
+
+	if (thread_count == 0) {
+		uint32_t hardware_threads = std::thread::hardware_concurrency();		//0 when unknown
+		thread_count = hardware_threads > 1 ? hardware_threads - 1 : 1;
+	}
+
+	for (uint32_t i = 0; i < thread_count; ++i) {
+		workers.emplace_back(&PipelineBuilder::WorkerLoop, this);
+	}
+}
+
+void PipelineBuilder::Stop() {
+	{
+		std::lock_guard<std::mutex> lock(tasks_mutex);
+		stopping = true;
+	}
+	tasks_available.notify_all();
+
+	//Workers drain the queue before exiting, so no future is left without a value
+	for (auto& worker : workers) {
+		worker.join();
+	}
+	workers.clear();
+}
+
+std::future<VkPipeline> PipelineBuilder::Submit(const GraphicsPipelineDesc& desc) {
+	return Enqueue(std::packaged_task<VkPipeline()>([this, desc]() {
+		return BuildGraphicsPipeline(desc);
+	}));
+}
+
+std::future<VkPipeline> PipelineBuilder::Submit(const ComputePipelineDesc& desc) {
+	return Enqueue(std::packaged_task<VkPipeline()>([this, desc]() {
+		return BuildComputePipeline(desc);
+	}));
+}
+
+std::future<VkPipeline> PipelineBuilder::Enqueue(std::packaged_task<VkPipeline()> task) {
+	std::future<VkPipeline> result = task.get_future();
+
+	if (workers.empty()) {
+		task();		//Not started - build on the calling thread
+		return result;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(tasks_mutex);
+		tasks.push(std::move(task));
+	}
+	tasks_available.notify_one();
+
+	return result;
+}
+
+void PipelineBuilder::WorkerLoop() {
+	while (true) {
+		std::packaged_task<VkPipeline()> task;
+		{
+			std::unique_lock<std::mutex> lock(tasks_mutex);
+			tasks_available.wait(lock, [this]() { return stopping || !tasks.empty(); });
+
+			if (tasks.empty()) {
+				return;		//Stopping and nothing left to build
+			}
+
+			task = std::move(tasks.front());
+			tasks.pop();
+		}
+
+		//Exceptions end up in the task's future
+		task();
+	}
+}
+
+VkPipeline PipelineBuilder::BuildGraphicsPipeline(const GraphicsPipelineDesc& desc) {
+	//Shader stage creation information
+	//Vertex stage creation information
+	VkPipelineShaderStageCreateInfo vertex_shader_create_info = {};
+	vertex_shader_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	vertex_shader_create_info.stage = VK_SHADER_STAGE_VERTEX_BIT;				//Shader stage name
+	vertex_shader_create_info.module = desc.vertex_shader;						//shader module to be used by stage
+	vertex_shader_create_info.pName = "main";									//Entry point in to shader
+
+	//Fragment stage creation information
+	VkPipelineShaderStageCreateInfo fragment_shader_create_info = {};
+	fragment_shader_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	fragment_shader_create_info.stage = VK_SHADER_STAGE_FRAGMENT_BIT;				//Shader stage name
+	fragment_shader_create_info.module = desc.fragment_shader;					//shader module to be used by stage
+	fragment_shader_create_info.pName = "main";										//Entry point in to shader
+
+	VkPipelineShaderStageCreateInfo shader_stages[] = { vertex_shader_create_info, fragment_shader_create_info };
+
+	//Create pipeline
+	// -- Vertex input -- 
+	VkPipelineVertexInputStateCreateInfo vertex_input_create_info = {};
+	vertex_input_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+	vertex_input_create_info.vertexBindingDescriptionCount = desc.vertex_input.binding_count;
+	vertex_input_create_info.pVertexBindingDescriptions = desc.vertex_input.bindings;		//List of vertex binding descriptions (data spacing / stride information)
+	vertex_input_create_info.vertexAttributeDescriptionCount = desc.vertex_input.attribute_count;
+	vertex_input_create_info.pVertexAttributeDescriptions = desc.vertex_input.attributes;	//List of vertex attribute descriptions (data format and where to bind to/from)
+
+	// -- Input Assembly -- 
+	VkPipelineInputAssemblyStateCreateInfo input_assembly = {};
+	input_assembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+	input_assembly.topology = desc.topology;										// like GL_TRIANGLE / GL_LINE / ...
+	input_assembly.primitiveRestartEnable = VK_FALSE;								// Allow overriding of "strip" topology to start new primitives
+
+	// -- Viewport & Scissor --
+	//Create a viewport info struct
+	VkViewport viewport = {};
+	viewport.x = 0.f;																//X start coordinate
+	viewport.y = 0.f;																//Y start coordinate
+	viewport.width = (float)desc.extent.width;									//Width of viewport
+	viewport.height = (float)desc.extent.height;								//Height of viewport
+	viewport.minDepth = 0.f;														//Min framebuffer depth
+	viewport.maxDepth = 1.f;														//Max framebuffer depth
+
+	//Create a scissor info struct
+	VkRect2D scissor = {};
+	scissor.offset = { 0, 0 };														//Offset to use region from
+	scissor.extent = desc.extent;												//Extent to decribe region to use, starting at offset
+
+	VkPipelineViewportStateCreateInfo viewport_state_create_info = {};
+	viewport_state_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+	viewport_state_create_info.viewportCount = 1;
+	viewport_state_create_info.pViewports = &viewport;
+	viewport_state_create_info.scissorCount = 1;
+	viewport_state_create_info.pScissors = &scissor;
+
+	//// -- Dynamic State --
+	////Dynamic states to enable
+	//std::vector<VkDynamicState> dynamic_state_enables;
+	//dynamic_state_enables.push_back(VK_DYNAMIC_STATE_VIEWPORT); // dynamic viewport : can resize in command buffer with vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+	//dynamic_state_enables.push_back(VK_DYNAMIC_STATE_SCISSOR);	// dynamic scissors : can resize in command buffer with vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+	////Dynamic state creation info
+	//VkPipelineDynamicStateCreateInfo dynamic_state_create_info;
+	//dynamic_state_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+	//dynamic_state_create_info.dynamicStateCount = static_cast<uint32_t>(dynamic_state_enables.size());
+	//dynamic_state_create_info.pDynamicStates = dynamic_state_enables.data();
+
+	// -- Rasterizer -- 
+	VkPipelineRasterizationStateCreateInfo rasterization_create_info = {};
+	rasterization_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+	rasterization_create_info.depthClampEnable = VK_FALSE;							//Change if fragment beyond near / far plane are clipped (default) or clamped to plane -> NEED GPU FEATURE
+	rasterization_create_info.rasterizerDiscardEnable = VK_FALSE;					//Whether to discard data and skip rasterization - only suitable for pipeline without framebuffer output
+	rasterization_create_info.polygonMode = VK_POLYGON_MODE_FILL;					//Wireframe mode / ... -> NEED GPU FEATURE
+	rasterization_create_info.lineWidth = 1.f;										//Thickness of line
+	rasterization_create_info.cullMode = desc.cull_mode;							//Which face of a triangle to cull
+	rasterization_create_info.frontFace = desc.front_face;						//Winding to determine which side is front
+	rasterization_create_info.depthBiasEnable = VK_FALSE;							//Whether to add depth bias to fragments
+
+	// -- Multisampling --
+	VkPipelineMultisampleStateCreateInfo multisampling_create_info = {};
+	multisampling_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+	multisampling_create_info.sampleShadingEnable = VK_FALSE;						//Enable multisample shading or not
+	multisampling_create_info.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;			//Number of samples to use per fragment
+
+	// -- Blending --
+	//Blend attachment state (how blending is handled)
+	VkPipelineColorBlendAttachmentState colour_state = {};
+	colour_state.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |	//Colours to apply blending to
+		VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+	colour_state.blendEnable = VK_FALSE;											//Opaque triangle, blending not needed
+
+	VkPipelineColorBlendStateCreateInfo colour_blending_create_info = {};
+	colour_blending_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+	colour_blending_create_info.logicOpEnable = VK_FALSE;							//Alternative to calculations is to use logical operations
+	colour_blending_create_info.attachmentCount = 1;
+	colour_blending_create_info.pAttachments = &colour_state;
+
+	// -- Graphics pipeline creation --
+	VkGraphicsPipelineCreateInfo pipeline_create_info = {};
+	pipeline_create_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+	pipeline_create_info.stageCount = 2;											//Number of shader stages
+	pipeline_create_info.pStages = shader_stages;									//List of shader stages
+	pipeline_create_info.pVertexInputState = &vertex_input_create_info;
+	pipeline_create_info.pInputAssemblyState = &input_assembly;
+	pipeline_create_info.pViewportState = &viewport_state_create_info;
+	pipeline_create_info.pDynamicState = nullptr;
+	pipeline_create_info.pRasterizationState = &rasterization_create_info;
+	pipeline_create_info.pMultisampleState = &multisampling_create_info;
+	pipeline_create_info.pColorBlendState = &colour_blending_create_info;
+	pipeline_create_info.pDepthStencilState = nullptr;
+	pipeline_create_info.layout = desc.layout;										//Pipeline layout pipeline should use
+	pipeline_create_info.renderPass = desc.render_pass;							//Render pass description the pipeline is compatible with
+	pipeline_create_info.subpass = desc.subpass;									//Subpass of render pass to use with pipeline
+
+	//Pipeline derivatives : can create multiple pipelines that derive from one another for optimisation
+	pipeline_create_info.basePipelineHandle = VK_NULL_HANDLE;
+	pipeline_create_info.basePipelineIndex = -1;
+
+	VkPipeline pipeline;
+	VkResult result;
+	{
+		ScopedTimer vk_timer("vkCreateGraphicsPipelines", "vulkan");
+		result = vkCreateGraphicsPipelines(device, cache, 1, &pipeline_create_info, nullptr, &pipeline);
+	}
+	if (result != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create a graphics pipeline");
+	}
+
+	return pipeline;
+
+}
+
+VkPipeline PipelineBuilder::BuildComputePipeline(const ComputePipelineDesc& desc) {
+	VkComputePipelineCreateInfo pipeline_create_info = {};
+	pipeline_create_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipeline_create_info.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	pipeline_create_info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	pipeline_create_info.stage.module = desc.shader;
+	pipeline_create_info.stage.pName = "main";
+	pipeline_create_info.layout = desc.layout;
+	pipeline_create_info.basePipelineHandle = VK_NULL_HANDLE;
+	pipeline_create_info.basePipelineIndex = -1;
+
+	VkPipeline pipeline;
+	VkResult result;
+	{
+		ScopedTimer vk_timer("vkCreateComputePipelines", "vulkan");
+		result = vkCreateComputePipelines(device, cache, 1, &pipeline_create_info, nullptr, &pipeline);
+	}
+	if (result != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create a compute pipeline");
+	}
+
+	return pipeline;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+#include "VertexFormat.h"
+
+//Everything that differs between graphics pipelines. Copied to the worker thread, but the shader modules, layout,
+//render pass and vertex input arrays (normally a VertexInput's static ones) must stay alive until the future is ready
+struct GraphicsPipelineDesc {
+	VkShaderModule vertex_shader = VK_NULL_HANDLE;
+	VkShaderModule fragment_shader = VK_NULL_HANDLE;
+	VertexInputLayout vertex_input;
+	VkPrimitiveTopology topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+	VkCullModeFlags cull_mode = VK_CULL_MODE_BACK_BIT;
+	VkFrontFace front_face = VK_FRONT_FACE_CLOCKWISE;
+	VkExtent2D extent = {};
+	VkPipelineLayout layout = VK_NULL_HANDLE;
+	VkRenderPass render_pass = VK_NULL_HANDLE;
+	uint32_t subpass = 0;
+};
+
+//Compute pipelines only need their shader and layout, which must stay alive until the future is ready
+struct ComputePipelineDesc {
+	VkShaderModule shader = VK_NULL_HANDLE;
+	VkPipelineLayout layout = VK_NULL_HANDLE;
+};
+
+//Compiles pipelines concurrently on a pool of worker threads.
+//All workers share one VkPipelineCache - pipeline caches are internally synchronised by the driver
+class PipelineBuilder
+{
+public:
+	~PipelineBuilder();
+
+	//thread_count = 0 uses one worker per hardware thread except the caller's
+	void Start(VkDevice logical_device, VkPipelineCache pipeline_cache, uint32_t thread_count = 0);
+	void Stop();
+
+	//Queues a pipeline for compilation. The future throws std::runtime_error if creation failed
+	std::future<VkPipeline> Submit(const GraphicsPipelineDesc& desc);
+	std::future<VkPipeline> Submit(const ComputePipelineDesc& desc);
+
+	uint32_t GetThreadCount() const { return static_cast<uint32_t>(workers.size()); }
+
+private:
+	VkDevice device = VK_NULL_HANDLE;
+	VkPipelineCache cache = VK_NULL_HANDLE;
+
+	std::vector<std::thread> workers;
+	std::queue<std::packaged_task<VkPipeline()>> tasks;
+	std::mutex tasks_mutex;
+	std::condition_variable tasks_available;
+	bool stopping = false;
+
+	void WorkerLoop();
+	std::future<VkPipeline> Enqueue(std::packaged_task<VkPipeline()> task);
+	VkPipeline BuildGraphicsPipeline(const GraphicsPipelineDesc& desc);
+	VkPipeline BuildComputePipeline(const ComputePipelineDesc& desc);
+};
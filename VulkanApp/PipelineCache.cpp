@@ -0,0 +1,165 @@
+#include "PipelineCache.h"
+#include "StartupProfiler.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+bool PipelineCache::Create(VkPhysicalDevice physical_device, VkDevice logical_device, const std::string& path) {
+	device = logical_device;
+	file_path = path;
+	vkGetPhysicalDeviceProperties(physical_device, &device_properties);
+
+	std::vector<char> initial_data = LoadValidatedData();
+
+	VkPipelineCacheCreateInfo cache_create_info = {};
+	cache_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+	cache_create_info.initialDataSize = initial_data.size();
+	cache_create_info.pInitialData = initial_data.empty() ? nullptr : initial_data.data();
+
+	VkResult result;
+	{
+		ScopedTimer vk_timer("vkCreatePipelineCache", "vulkan");
+		result = vkCreatePipelineCache(device, &cache_create_info, nullptr, &cache);
+	}
+	if (result != VK_SUCCESS && !initial_data.empty()) {
+		//Driver refused data that passed our checks - start over empty rather than failing startup
+		std::cout << "Pipeline cache: driver rejected " << file_path << ", starting cold" << std::endl;
+		initial_data.clear();
+		cache_create_info.initialDataSize = 0;
+		cache_create_info.pInitialData = nullptr;
+		result = vkCreatePipelineCache(device, &cache_create_info, nullptr, &cache);
+	}
+	if (result != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create a pipeline cache");
+	}
+
+	return !initial_data.empty();
+}
+
+void PipelineCache::Save() {
+	if (cache == VK_NULL_HANDLE || file_path.empty()) {
+		return;
+	}
+
+	size_t data_size = 0;
+	if (vkGetPipelineCacheData(device, cache, &data_size, nullptr) != VK_SUCCESS || data_size == 0) {
+		return;
+	}
+
+	std::vector<char> data(data_size);
+	if (vkGetPipelineCacheData(device, cache, &data_size, data.data()) != VK_SUCCESS) {
+		return;
+	}
+	data.resize(data_size);
+
+	FileHeader header = MakeHeader(data);
+
+	//Write next to the real file and swap it in, readers only ever see a complete file
+	std::string temp_path = file_path + ".tmp";
+	{
+		std::ofstream outfile(temp_path, std::ios::binary | std::ios::trunc);
+		if (!outfile.is_open()) {
+			std::cout << "Pipeline cache: failed to open " << temp_path << std::endl;
+			return;
+		}
+
+		outfile.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		outfile.write(data.data(), data.size());
+		if (!outfile.good()) {
+			std::cout << "Pipeline cache: failed to write " << temp_path << std::endl;
+			outfile.close();
+			std::error_code error;
+			std::filesystem::remove(temp_path, error);
+			return;
+		}
+	}
+
+	std::error_code error;
+	std::filesystem::rename(temp_path, file_path, error);
+	if (error) {
+		std::cout << "Pipeline cache: failed to replace " << file_path << " : " << error.message() << std::endl;
+		std::filesystem::remove(temp_path, error);
+	}
+}
+
+void PipelineCache::Destroy() {
+	if (cache != VK_NULL_HANDLE) {
+		vkDestroyPipelineCache(device, cache, nullptr);
+		cache = VK_NULL_HANDLE;
+	}
+}
+
+std::vector<char> PipelineCache::LoadValidatedData() {
+	if (file_path.empty()) {
+		return {};
+	}
+
+	std::ifstream infile(file_path, std::ios::binary | std::ios::ate);
+	if (!infile.is_open()) {
+		return {};		//First run
+	}
+
+	size_t file_size = static_cast<size_t>(infile.tellg());
+	if (file_size < sizeof(FileHeader)) {
+		std::cout << "Pipeline cache: " << file_path << " is truncated, ignoring it" << std::endl;
+		return {};
+	}
+
+	FileHeader header;
+	infile.seekg(0);
+	infile.read(reinterpret_cast<char*>(&header), sizeof(header));
+
+	if (header.magic != FILE_MAGIC || header.header_version != FILE_VERSION) {
+		std::cout << "Pipeline cache: " << file_path << " has an unknown format, ignoring it" << std::endl;
+		return {};
+	}
+
+	//A cache built by another GPU or driver is useless at best and can crash drivers at worst
+	if (header.vendor_id != device_properties.vendorID ||
+		header.device_id != device_properties.deviceID ||
+		header.driver_version != device_properties.driverVersion ||
+		std::memcmp(header.pipeline_cache_uuid, device_properties.pipelineCacheUUID, VK_UUID_SIZE) != 0) {
+		std::cout << "Pipeline cache: " << file_path << " was written by another device or driver, ignoring it" << std::endl;
+		return {};
+	}
+
+	if (header.data_size != file_size - sizeof(FileHeader)) {
+		std::cout << "Pipeline cache: " << file_path << " has a wrong size, ignoring it" << std::endl;
+		return {};
+	}
+
+	std::vector<char> data(static_cast<size_t>(header.data_size));
+	infile.read(data.data(), data.size());
+	if (!infile.good() || Checksum(data) != header.data_checksum) {
+		std::cout << "Pipeline cache: " << file_path << " is corrupt, ignoring it" << std::endl;
+		return {};
+	}
+
+	return data;
+}
+
+PipelineCache::FileHeader PipelineCache::MakeHeader(const std::vector<char>& data) const {
+	FileHeader header = {};
+	header.magic = FILE_MAGIC;
+	header.header_version = FILE_VERSION;
+	header.vendor_id = device_properties.vendorID;
+	header.device_id = device_properties.deviceID;
+	header.driver_version = device_properties.driverVersion;
+	std::memcpy(header.pipeline_cache_uuid, device_properties.pipelineCacheUUID, VK_UUID_SIZE);
+	header.data_size = data.size();
+	header.data_checksum = Checksum(data);
+	return header;
+}
+
+//64-bit FNV-1a, enough to catch truncated or bit-flipped files
+uint64_t PipelineCache::Checksum(const std::vector<char>& data) {
+	uint64_t hash = 14695981039346656037ull;
+	for (char byte : data) {
+		hash ^= static_cast<uint8_t>(byte);
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <string>
+#include <vector>
+
+//VkPipelineCache persisted between runs.
+//The file is only accepted if it was written by the same device + driver, otherwise the cache starts empty
+class PipelineCache
+{
+public:
+	//Creates the cache, seeded from the file at path when it's valid. Returns true if the file was used (warm start)
+	bool Create(VkPhysicalDevice physical_device, VkDevice logical_device, const std::string& path);
+
+	//Writes the cache contents to disk (through a temporary file, so a crash never leaves a half written cache)
+	void Save();
+
+	void Destroy();
+
+	VkPipelineCache GetHandle() const { return cache; }
+
+private:
+	//Prefix written in front of the driver's cache data
+	struct FileHeader {
+		uint32_t magic;
+		uint32_t header_version;
+		uint32_t vendor_id;
+		uint32_t device_id;
+		uint32_t driver_version;
+		uint8_t pipeline_cache_uuid[VK_UUID_SIZE];
+		uint64_t data_size;
+		uint64_t data_checksum;
+	};
+
+	static const uint32_t FILE_MAGIC = 0x43505556;		//"VUPC"
+	static const uint32_t FILE_VERSION = 1;
+
+	VkDevice device = VK_NULL_HANDLE;
+	VkPipelineCache cache = VK_NULL_HANDLE;
+	VkPhysicalDeviceProperties device_properties = {};
+	std::string file_path;
+
+	std::vector<char> LoadValidatedData();
+	FileHeader MakeHeader(const std::vector<char>& data) const;
+	static uint64_t Checksum(const std::vector<char>& data);
+};
@@ -0,0 +1,244 @@
+#include "SceneGraph.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SCENE_GRAPH_SSE2
+#endif
+
+namespace {
+	//Above one dirty node in this many, UpdateTransforms scans the flags instead of sorting the dirty list
+	const size_t DIRTY_SCAN_RATIO = 16;
+
+	//Vector insert that keeps every per-index array in step
+	template<typename T>
+	void InsertAt(std::vector<T>& field, uint32_t index, const T& value) {
+		field.insert(field.begin() + index, value);
+	}
+}
+
+glm::mat4 ComposeTransform(const glm::mat4& parent, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale,
+	bool use_simd) {
+	glm::mat3 basis = glm::mat3_cast(rotation);
+	glm::mat4 local(glm::vec4(basis[0] * scale.x, 0.0f), glm::vec4(basis[1] * scale.y, 0.0f), glm::vec4(basis[2] * scale.z, 0.0f),
+		glm::vec4(position, 1.0f));
+
+#ifdef SCENE_GRAPH_SSE2
+	if (use_simd) {
+		//Each result column is the parent's columns weighted by one local column, summed in glm's order
+		__m128 a0 = _mm_loadu_ps(&parent[0][0]);
+		__m128 a1 = _mm_loadu_ps(&parent[1][0]);
+		__m128 a2 = _mm_loadu_ps(&parent[2][0]);
+		__m128 a3 = _mm_loadu_ps(&parent[3][0]);
+
+		glm::mat4 result;
+		for (int column = 0; column < 4; ++column) {
+			const glm::vec4& b = local[column];
+			__m128 sum = _mm_add_ps(_mm_mul_ps(a0, _mm_set1_ps(b.x)), _mm_mul_ps(a1, _mm_set1_ps(b.y)));
+			sum = _mm_add_ps(sum, _mm_mul_ps(a2, _mm_set1_ps(b.z)));
+			sum = _mm_add_ps(sum, _mm_mul_ps(a3, _mm_set1_ps(b.w)));
+			_mm_storeu_ps(&result[column][0], sum);
+		}
+		return result;
+	}
+#endif
+	return parent * local;
+}
+
+void SceneGraph::Reserve(size_t count) {
+	positions.reserve(count);
+	rotations.reserve(count);
+	scales.reserve(count);
+	world.reserve(count);
+	bounds_centres.reserve(count);
+	bounds_extents.reserve(count);
+	parents.reserve(count);
+	subtree_sizes.reserve(count);
+	dirty.reserve(count);
+	node_at.reserve(count);
+	index_of.reserve(count);
+	world_bounds.Reserve(count);
+}
+
+SceneGraph::NodeId SceneGraph::AddNode(NodeId parent, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale) {
+	uint32_t parent_index = NO_PARENT;
+	uint32_t index = static_cast<uint32_t>(Size());
+	if (parent != NO_PARENT) {
+		if (parent >= index_of.size()) {
+			throw std::runtime_error("Scene node added under a parent that does not exist");
+		}
+
+		//Last place in the parent's subtree, every ancestor's subtree grows by one
+		parent_index = index_of[parent];
+		index = parent_index + subtree_sizes[parent_index];
+		for (uint32_t ancestor = parent_index; ancestor != NO_PARENT; ancestor = parents[ancestor]) {
+			++subtree_sizes[ancestor];
+		}
+	}
+
+	NodeId node = static_cast<NodeId>(index_of.size());
+	if (index < Size()) {
+		//Everything behind the new node moves up one index
+		for (uint32_t& other_parent : parents) {
+			if (other_parent != NO_PARENT && other_parent >= index) {
+				++other_parent;
+			}
+		}
+		for (uint32_t i = index; i < node_at.size(); ++i) {
+			++index_of[node_at[i]];
+		}
+		structure_changed = true;
+	}
+
+	InsertAt(positions, index, position);
+	InsertAt(rotations, index, rotation);
+	InsertAt(scales, index, scale);
+	InsertAt(world, index, glm::mat4(1.0f));
+	InsertAt(bounds_centres, index, glm::vec3(0.0f));
+	InsertAt(bounds_extents, index, glm::vec3(0.0f));
+	InsertAt(parents, index, parent_index);
+	InsertAt(subtree_sizes, index, 1u);
+	InsertAt(dirty, index, uint8_t(0));
+	InsertAt(node_at, index, node);
+	index_of.push_back(index);
+
+	MarkDirty(node);
+	return node;
+}
+
+void SceneGraph::MarkDirty(NodeId node) {
+	uint32_t index = index_of[node];
+	if (!dirty[index]) {
+		dirty[index] = 1;
+		dirty_nodes.push_back(node);
+	}
+}
+
+void SceneGraph::SetPosition(NodeId node, const glm::vec3& position) {
+	positions[index_of[node]] = position;
+	MarkDirty(node);
+}
+
+void SceneGraph::SetRotation(NodeId node, const glm::quat& rotation) {
+	rotations[index_of[node]] = rotation;
+	MarkDirty(node);
+}
+
+void SceneGraph::SetScale(NodeId node, const glm::vec3& scale) {
+	scales[index_of[node]] = scale;
+	MarkDirty(node);
+}
+
+void SceneGraph::SetLocal(NodeId node, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale) {
+	uint32_t index = index_of[node];
+	positions[index] = position;
+	rotations[index] = rotation;
+	scales[index] = scale;
+	MarkDirty(node);
+}
+
+void SceneGraph::SetBounds(NodeId node, const glm::vec3& centre, const glm::vec3& extents) {
+	uint32_t index = index_of[node];
+	bounds_centres[index] = centre;
+	bounds_extents[index] = extents;
+	MarkDirty(node);
+}
+
+void SceneGraph::MarkAllDirty() {
+	for (uint32_t index = 0; index < Size(); index += subtree_sizes[index]) {
+		MarkDirty(node_at[index]);
+	}
+}
+
+SceneGraph::NodeId SceneGraph::GetParent(NodeId node) const {
+	uint32_t parent_index = parents[index_of[node]];
+	return parent_index == NO_PARENT ? NO_PARENT : node_at[parent_index];
+}
+
+size_t SceneGraph::UpdateTransforms(bool use_simd) {
+	++stats.updates;
+	size_t recomputed = 0;
+
+	if (structure_changed) {
+		//Bounds are indexed like the nodes, an insertion shifted them all
+		world_bounds.Clear();
+		world_bounds.Reserve(Size());
+		for (size_t i = 0; i < Size(); ++i) {
+			world_bounds.Add(glm::vec3(0.0f), glm::vec3(0.0f));
+		}
+		for (NodeId node : dirty_nodes) {
+			dirty[index_of[node]] = 0;
+		}
+		dirty_nodes.clear();
+		structure_changed = false;
+
+		UpdateRange(0, static_cast<uint32_t>(Size()), use_simd);
+		++stats.full_updates;
+		stats.recomputed_nodes += Size();
+		return Size();
+	}
+
+	//Appended nodes are dirty, so they get real bounds below
+	while (world_bounds.Size() < Size()) {
+		world_bounds.Add(glm::vec3(0.0f), glm::vec3(0.0f));
+	}
+
+	//Front to back, a dirty node inside a subtree that was just recomputed is already done.
+	//When a large share moved, one pass over the flags is cheaper than sorting the dirty list
+	uint32_t covered_end = 0;
+	if (dirty_nodes.size() * DIRTY_SCAN_RATIO > Size()) {
+		dirty_nodes.clear();
+		for (uint32_t index = 0; index < Size(); ++index) {
+			if (dirty[index] && index >= covered_end) {
+				covered_end = index + subtree_sizes[index];
+				UpdateRange(index, covered_end, use_simd);
+				recomputed += covered_end - index;
+			}
+			dirty[index] = 0;
+		}
+	}
+	else {
+		std::vector<uint32_t> dirty_indices;
+		dirty_indices.reserve(dirty_nodes.size());
+		for (NodeId node : dirty_nodes) {
+			uint32_t index = index_of[node];
+			dirty[index] = 0;
+			dirty_indices.push_back(index);
+		}
+		dirty_nodes.clear();
+		std::sort(dirty_indices.begin(), dirty_indices.end());
+
+		for (uint32_t index : dirty_indices) {
+			if (index < covered_end) {
+				continue;
+			}
+			covered_end = index + subtree_sizes[index];
+			UpdateRange(index, covered_end, use_simd);
+			recomputed += covered_end - index;
+		}
+	}
+
+	stats.recomputed_nodes += recomputed;
+	return recomputed;
+}
+
+void SceneGraph::UpdateRange(uint32_t first, uint32_t end, bool use_simd) {
+	//Depth-first order: every parent in the range is written before its children read it
+	for (uint32_t i = first; i < end; ++i) {
+		if (parents[i] == NO_PARENT) {
+			world[i] = ComposeTransform(glm::mat4(1.0f), positions[i], rotations[i], scales[i], use_simd);
+		}
+		else {
+			world[i] = ComposeTransform(world[parents[i]], positions[i], rotations[i], scales[i], use_simd);
+		}
+
+		//Box of the transformed box: centre moves, extents are the absolute axes weighted by the local extents
+		const glm::mat4& m = world[i];
+		glm::vec3 centre = glm::vec3(m * glm::vec4(bounds_centres[i], 1.0f));
+		glm::vec3 extents = glm::abs(glm::vec3(m[0])) * bounds_extents[i].x + glm::abs(glm::vec3(m[1])) * bounds_extents[i].y
+			+ glm::abs(glm::vec3(m[2])) * bounds_extents[i].z;
+		world_bounds.Set(i, centre, extents);
+	}
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/gtc/quaternion.hpp>
+
+#include "Utilities.h"
+#include "FrustumCulling.h"
+
+//Transform hierarchy with every field in its own array. Nodes are kept in depth-first order, so a parent always
+//comes before its children and every subtree is one contiguous range of indices. Moving a node only marks it dirty;
+//UpdateTransforms then walks just the dirty subtrees front to back, so its cost follows what moved, not scene size.
+//
+//NodeIds stay valid for the life of the graph. Indices (NodeAt, GetWorldBounds) change when a node is inserted
+//in the middle of the order, which only happens when a parent gets a child after other nodes were added behind it
+class SceneGraph
+{
+public:
+	using NodeId = uint32_t;
+	static const NodeId NO_PARENT = UINT32_MAX;
+
+	struct Stats {
+		uint64_t updates = 0;
+		uint64_t recomputed_nodes = 0;		//World matrices written, over all updates
+		uint64_t full_updates = 0;			//Updates that had to touch every node after an insertion
+	};
+
+	void Reserve(size_t count);
+
+	//parent must already exist. Adding children right after their parent (depth-first) keeps insertion O(1)
+	NodeId AddNode(NodeId parent = NO_PARENT, const glm::vec3& position = glm::vec3(0.0f),
+		const glm::quat& rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f), const glm::vec3& scale = glm::vec3(1.0f));
+
+	void SetPosition(NodeId node, const glm::vec3& position);
+	void SetRotation(NodeId node, const glm::quat& rotation);
+	void SetScale(NodeId node, const glm::vec3& scale);
+	void SetLocal(NodeId node, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale);
+
+	//Local space box, kept in world space in GetWorldBounds (nodes without one get an empty box at their origin)
+	void SetBounds(NodeId node, const glm::vec3& centre, const glm::vec3& extents);
+
+	//Recomputes world matrices and bounds of the dirty nodes and everything below them. Returns how many were written.
+	//use_simd = false forces glm's scalar matrix product, both give the same bits
+	size_t UpdateTransforms(bool use_simd = true);
+
+	//Marks every root dirty, the next update recomputes the whole graph
+	void MarkAllDirty();
+
+	size_t Size() const { return parents.size(); }
+	NodeId GetParent(NodeId node) const;
+	const glm::mat4& GetWorld(NodeId node) const { return world[index_of[node]]; }
+
+	//World space bounds by index, for culling. NodeAt maps the indices CullingVolumes::Cull returns back to nodes
+	const CullingVolumes& GetWorldBounds() const { return world_bounds; }
+	NodeId NodeAt(uint32_t index) const { return node_at[index]; }
+
+	Stats GetStats() const { return stats; }
+
+private:
+	//By index, depth-first order
+	std::vector<glm::vec3> positions;
+	std::vector<glm::quat> rotations;
+	std::vector<glm::vec3> scales;
+	std::vector<glm::mat4> world;
+	std::vector<glm::vec3> bounds_centres;
+	std::vector<glm::vec3> bounds_extents;
+	std::vector<uint32_t> parents;			//Index of the parent, NO_PARENT for roots
+	std::vector<uint32_t> subtree_sizes;	//The node and all its descendants
+	std::vector<uint8_t> dirty;
+	std::vector<NodeId> node_at;
+
+	std::vector<uint32_t> index_of;			//By NodeId
+	std::vector<NodeId> dirty_nodes;		//Marked since the last update, NodeIds so insertions don't invalidate them
+	bool structure_changed = false;			//An insertion shifted indices, world_bounds must be rebuilt
+
+	CullingVolumes world_bounds;
+	Stats stats;
+
+	void MarkDirty(NodeId node);
+	void UpdateRange(uint32_t first, uint32_t end, bool use_simd);
+};
+
+//World matrix from a parent's world matrix and local position, rotation and scale (T * R * S). The SSE2 product
+//runs the same operations in the same order as glm's operator*, so the results are identical
+glm::mat4 ComposeTransform(const glm::mat4& parent, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale,
+	bool use_simd = true);
@@ -0,0 +1,105 @@
+#include "SceneGraphBenchmark.h"
+
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "SceneGraph.h"
+#include "Benchmark.h"
+
+namespace {
+	const uint32_t FRAMES = 100;
+
+	//Roots with 9 children of 10 leaves each (100 nodes per root), built depth-first so every insertion appends
+	void BuildScene(SceneGraph& graph, uint64_t node_count, std::mt19937& random) {
+		std::uniform_real_distribution<float> offset(-1.0f, 1.0f);
+		graph.Reserve(node_count);
+		while (graph.Size() < node_count) {
+			SceneGraph::NodeId root = graph.AddNode(SceneGraph::NO_PARENT, glm::vec3(offset(random), offset(random), offset(random)) * 100.0f);
+			for (int child = 0; child < 9 && graph.Size() < node_count; ++child) {
+				SceneGraph::NodeId arm = graph.AddNode(root, glm::vec3(offset(random), offset(random), offset(random)) * 5.0f);
+				for (int leaf = 0; leaf < 10 && graph.Size() < node_count; ++leaf) {
+					SceneGraph::NodeId node = graph.AddNode(arm, glm::vec3(offset(random), offset(random), offset(random)),
+						glm::quat(1.0f, 0.0f, 0.0f, 0.0f), glm::vec3(0.5f));
+					graph.SetBounds(node, glm::vec3(0.0f), glm::vec3(0.5f));
+				}
+			}
+		}
+		graph.UpdateTransforms();
+	}
+
+	//Rotates moved_count random nodes (the same ones for every mode) and times the update that follows
+	double TimeFrames(SceneGraph& graph, uint64_t moved_count, bool full, bool use_simd, uint64_t& recomputed) {
+		std::mt19937 random(11);
+		std::uniform_int_distribution<SceneGraph::NodeId> pick(0, static_cast<SceneGraph::NodeId>(graph.Size() - 1));
+		std::uniform_real_distribution<float> angle(0.0f, 6.2831853f);
+
+		double total_ms = 0.0;
+		recomputed = 0;
+		for (uint32_t frame = 0; frame < FRAMES; ++frame) {
+			for (uint64_t i = 0; i < moved_count; ++i) {
+				graph.SetRotation(pick(random), glm::angleAxis(angle(random), glm::vec3(0.0f, 0.0f, 1.0f)));
+			}
+			if (full) {
+				graph.MarkAllDirty();
+			}
+
+			BenchClock::time_point start = BenchClock::now();
+			recomputed += graph.UpdateTransforms(use_simd);
+			total_ms += ElapsedMs(start);
+		}
+		recomputed /= FRAMES;
+		return total_ms / FRAMES;
+	}
+
+	bool SameWorld(const SceneGraph& a, const SceneGraph& b) {
+		for (SceneGraph::NodeId node = 0; node < a.Size(); ++node) {
+			if (std::memcmp(&a.GetWorld(node), &b.GetWorld(node), sizeof(glm::mat4)) != 0) {
+				return false;
+			}
+		}
+		return true;
+	}
+}
+
+void RunSceneGraphBenchmark(uint64_t node_count) {
+	std::mt19937 random(3);
+	SceneGraph graph;
+	BenchClock::time_point build_start = BenchClock::now();
+	BuildScene(graph, node_count, random);
+	double build_ms = ElapsedMs(build_start);
+
+	std::cout << std::fixed << std::setprecision(3)
+		<< "Scene graph benchmark, " << graph.Size() << " nodes (built in " << build_ms << " ms), ms per frame over " << FRAMES << " frames:" << std::endl
+		<< "   moved  recomputed  incremental  scalar incremental  full recompute" << std::endl;
+
+	bool all_matched = true;
+	for (double share : { 0.001, 0.01, 0.05, 0.25, 1.0 }) {
+		uint64_t moved_count = std::max<uint64_t>(1, static_cast<uint64_t>(graph.Size() * share));
+		uint64_t recomputed = 0;
+		uint64_t unused = 0;
+
+		double incremental_ms = TimeFrames(graph, moved_count, false, true, recomputed);
+		double scalar_ms = TimeFrames(graph, moved_count, false, false, unused);
+		double full_ms = TimeFrames(graph, moved_count, true, true, unused);
+
+		//Incremental results must equal recomputing everything on the scalar path
+		TimeFrames(graph, moved_count, false, true, unused);
+		SceneGraph reference = graph;
+		reference.MarkAllDirty();
+		reference.UpdateTransforms(false);
+		bool matched = SameWorld(graph, reference);
+		all_matched = all_matched && matched;
+
+		std::cout << std::setw(7) << std::setprecision(1) << share * 100.0 << "%" << std::setw(12) << recomputed << std::setprecision(3)
+			<< std::setw(13) << incremental_ms << std::setw(20) << scalar_ms << std::setw(16) << full_ms
+			<< (matched ? "" : "  MISMATCH") << std::endl;
+	}
+
+	SceneGraph::Stats stats = graph.GetStats();
+	std::cout << stats.updates << " updates, " << stats.recomputed_nodes << " world matrices written, " << stats.full_updates
+		<< " full updates after insertions" << std::endl;
+	std::cout << (all_matched ? "Incremental updates match a full recompute" : "FAILED: incremental update differs from a full recompute") << std::endl;
+}
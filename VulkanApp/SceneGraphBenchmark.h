@@ -0,0 +1,9 @@
+#pragma once
+
+#include <cstdint>
+
+//CPU only timings of SceneGraph transform updates, no device needed. Run with --scene-bench <nodes>
+
+//Moves a growing share of the nodes every frame and times the incremental update (SSE2 and scalar) against
+//recomputing the whole graph. Also checks the incremental results against a full scalar recompute
+void RunSceneGraphBenchmark(uint64_t node_count);
@@ -0,0 +1,130 @@
+#include "ShaderFile.h"
+
+#include <stdexcept>
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+bool IsValidSpirv(const void* code, size_t size) {
+	//Header alone is 5 words: magic, version, generator, bound, schema
+	const size_t header_size = 5 * sizeof(uint32_t);
+
+	if (code == nullptr || size < header_size || size % sizeof(uint32_t) != 0) {
+		return false;
+	}
+	if (reinterpret_cast<uintptr_t>(code) % alignof(uint32_t) != 0) {
+		return false;
+	}
+
+	return *static_cast<const uint32_t*>(code) == SPIRV_MAGIC;
+}
+
+MappedSpirvFile::MappedSpirvFile(const std::string& filename) {
+#ifdef _WIN32
+	HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE) {
+		throw std::runtime_error("Failed to open a file : " + filename);
+	}
+	file_handle = file;
+
+	LARGE_INTEGER file_size;
+	if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0) {
+		Unmap();
+		throw std::runtime_error("Failed to read the size of a file : " + filename);
+	}
+	size = static_cast<size_t>(file_size.QuadPart);
+
+	mapping_handle = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mapping_handle != nullptr) {
+		view = MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0);
+	}
+#else
+	int fd = open(filename.c_str(), O_RDONLY);
+	if (fd < 0) {
+		throw std::runtime_error("Failed to open a file : " + filename);
+	}
+
+	struct stat file_stat;
+	if (fstat(fd, &file_stat) != 0 || file_stat.st_size == 0) {
+		close(fd);
+		throw std::runtime_error("Failed to read the size of a file : " + filename);
+	}
+	size = static_cast<size_t>(file_stat.st_size);
+
+	void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);		//Mapping keeps its own reference to the file
+	if (mapped != MAP_FAILED) {
+		view = mapped;
+	}
+#endif
+
+	if (view == nullptr) {
+		Unmap();
+		throw std::runtime_error("Failed to map a file : " + filename);
+	}
+
+	if (!IsValidSpirv(view, size)) {
+		Unmap();
+		throw std::runtime_error("File is not valid SPIR-V : " + filename);
+	}
+}
+
+MappedSpirvFile::~MappedSpirvFile() {
+	Unmap();
+}
+
+MappedSpirvFile::MappedSpirvFile(MappedSpirvFile&& other) noexcept {
+	*this = std::move(other);
+}
+
+MappedSpirvFile& MappedSpirvFile::operator=(MappedSpirvFile&& other) noexcept {
+	if (this != &other) {
+		Unmap();
+		std::swap(view, other.view);
+		std::swap(size, other.size);
+#ifdef _WIN32
+		std::swap(file_handle, other.file_handle);
+		std::swap(mapping_handle, other.mapping_handle);
+#endif
+	}
+	return *this;
+}
+
+SpirvView MappedSpirvFile::GetCode() const {
+	SpirvView code;
+	code.words = static_cast<const uint32_t*>(view);
+	code.size = size;
+	return code;
+}
+
+void MappedSpirvFile::Unmap() {
+#ifdef _WIN32
+	if (view != nullptr) {
+		UnmapViewOfFile(view);
+	}
+	if (mapping_handle != nullptr) {
+		CloseHandle(mapping_handle);
+	}
+	if (file_handle != nullptr) {
+		CloseHandle(file_handle);
+	}
+	file_handle = nullptr;
+	mapping_handle = nullptr;
+#else
+	if (view != nullptr) {
+		munmap(const_cast<void*>(view), size);
+	}
+#endif
+	view = nullptr;
+	size = 0;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+const uint32_t SPIRV_MAGIC = 0x07230203;
+
+//Non-owning view of SPIR-V words, ready to hand to vkCreateShaderModule
+struct SpirvView {
+	const uint32_t* words = nullptr;
+	size_t size = 0;							//In bytes, always a multiple of 4
+};
+
+//Checks alignment, size and the magic number (in host byte order, as Vulkan requires)
+bool IsValidSpirv(const void* code, size_t size);
+
+//Read-only memory mapping of a .spv file. The mapping starts on a page boundary so the words
+//are always 4-byte aligned, and the driver reads them straight from the page cache with no heap copy
+class MappedSpirvFile
+{
+public:
+	explicit MappedSpirvFile(const std::string& filename);
+	~MappedSpirvFile();
+
+	MappedSpirvFile(const MappedSpirvFile&) = delete;
+	MappedSpirvFile& operator=(const MappedSpirvFile&) = delete;
+	MappedSpirvFile(MappedSpirvFile&& other) noexcept;
+	MappedSpirvFile& operator=(MappedSpirvFile&& other) noexcept;
+
+	SpirvView GetCode() const;
+
+private:
+	const void* view = nullptr;
+	size_t size = 0;
+#ifdef _WIN32
+	void* file_handle = nullptr;
+	void* mapping_handle = nullptr;
+#endif
+
+	void Unmap();
+};
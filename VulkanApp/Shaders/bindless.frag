@@ -0,0 +1,37 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require	//Unsized descriptor arrays
+
+layout(location = 0) in vec3 col;
+layout(location = 1) in vec2 tex_coord;
+layout(location = 0) out vec4 final_col;
+
+//GpuMaterial in BindlessDescriptors.h
+struct Material {
+    vec4 base_colour;
+    uint texture;		//0xFFFFFFFF = untextured
+};
+
+//BindlessDescriptors.h: every resource is indexed, nothing is bound per draw
+layout(set = 0, binding = 0) uniform texture2D textures[];
+layout(set = 0, binding = 1) readonly buffer MaterialTable {
+    Material materials[];
+} buffers[];
+layout(set = 0, binding = 2) uniform sampler linear_sampler;
+
+//MaterialPush in BindlessDescriptors.h, after the vertex stage's PositionDecode
+layout(push_constant) uniform PushMaterial {
+    layout(offset = 32) uint material_buffer;
+    uint material;
+} push;
+
+const uint NO_TEXTURE = 0xFFFFFFFFu;
+
+void main() {
+    //Both indices are the same for the whole draw (dynamically uniform), so no nonuniformEXT
+    Material material = buffers[push.material_buffer].materials[push.material];
+    vec4 colour = material.base_colour;
+    if (material.texture != NO_TEXTURE) {
+        colour *= texture(sampler2D(textures[material.texture], linear_sampler), tex_coord);
+    }
+    final_col = vec4(col, 1.0) * colour;
+}
@@ -1,21 +1,23 @@
 #version 450 // GLSL 4.5
 
-layout(location = 0) out vec3 col;
+//Matches Vertex in Utilities.h
+layout(location = 0) in vec3 pos;
+layout(location = 1) in vec3 normal;
+layout(location = 2) in vec2 uv;
+layout(location = 3) in vec3 colour;
+
+//InstanceData in Utilities.h, binding 1 advances once per instance
+layout(location = 4) in mat4 model;
+layout(location = 8) in vec4 tint;
 
-//triangle vertices
-vec3 pos[3] = vec3[](
-    vec3(0.0, -0.4, 0.0),
-    vec3(0.4, 0.4, 0.0),
-    vec3(-0.4, 0.4, 0.0)
-);
+layout(location = 0) out vec3 col;
+layout(location = 1) out vec2 tex_coord;	//Only read by bindless.frag
 
-vec3 colors[3] = vec3[](
-    vec3(1, 0, 0),
-    vec3(0, 1, 0),
-    vec3(0, 0, 1)
-);
+//Lit from the viewer's direction
+const vec3 light_dir = vec3(0.0, 0.0, -1.0);
 
 void main() {
-    gl_Position = vec4(pos[gl_VertexIndex], 1.0);
-    col = colors[gl_VertexIndex];
-}
\ No newline at end of file
+    gl_Position = model * vec4(pos, 1.0);
+    col = colour * tint.rgb * max(dot(normalize(mat3(model) * normal), light_dir), 0.0);
+    tex_coord = uv;
+}
@@ -1,3 +1,24 @@
-C:/VulkanSDK/1.2.162.1/Bin32/glslangValidator.exe -V shader.vert
-C:/VulkanSDK/1.2.162.1/Bin32/glslangValidator.exe -V shader.frag
-pause
\ No newline at end of file
+C:/VulkanSDK/1.2.162.1/Bin32/glslangValidator.exe -V shader.vert || goto failed
+C:/VulkanSDK/1.2.162.1/Bin32/glslangValidator.exe -V shader.frag || goto failed
+C:/VulkanSDK/1.2.162.1/Bin32/glslangValidator.exe -V bindless.frag -o bindless_frag.spv || goto failed
+C:/VulkanSDK/1.2.162.1/Bin32/glslangValidator.exe -V shader_quantized.vert -o quantized_vert.spv || goto failed
+C:/VulkanSDK/1.2.162.1/Bin32/glslangValidator.exe -V cull.comp -o cull_comp.spv || goto failed
+
+::Same SPIR-V as C arrays, compiled into the executable (see EmbeddedShaders.cpp).
+::Outputs are not tracked (see .gitignore), this script is the only way they are produced.
+if not exist Generated mkdir Generated || goto failed
+C:/VulkanSDK/1.2.162.1/Bin32/glslangValidator.exe -V shader.vert --vn vert_spv -o Generated/vert_spv.h || goto failed
+C:/VulkanSDK/1.2.162.1/Bin32/glslangValidator.exe -V shader.frag --vn frag_spv -o Generated/frag_spv.h || goto failed
+C:/VulkanSDK/1.2.162.1/Bin32/glslangValidator.exe -V bindless.frag --vn bindless_frag_spv -o Generated/bindless_frag_spv.h || goto failed
+C:/VulkanSDK/1.2.162.1/Bin32/glslangValidator.exe -V shader_quantized.vert --vn quantized_vert_spv -o Generated/quantized_vert_spv.h || goto failed
+C:/VulkanSDK/1.2.162.1/Bin32/glslangValidator.exe -V cull.comp --vn cull_comp_spv -o Generated/cull_comp_spv.h || goto failed
+
+::Pre-build step passes nopause
+if not "%1"=="nopause" pause
+exit /b 0
+
+::Any failed call fails the pre-build step, so a shader error can't leave stale SPIR-V embedded
+:failed
+echo Shader compilation failed
+if not "%1"=="nopause" pause
+exit /b 1
@@ -0,0 +1,36 @@
+#version 450 // GLSL 4.5
+
+//Matches QuantizedVertex in MeshQuantizer.h. The vertex fetch already expands UNORM/SNORM/half to float
+layout(location = 0) in vec3 pos;		//UNORM16 or half, relative to the mesh AABB
+layout(location = 1) in vec2 normal;	//Octahedral, SNORM16
+layout(location = 2) in vec2 uv;		//half
+layout(location = 3) in vec3 colour;	//UNORM8
+
+//InstanceData in Utilities.h, binding 1 advances once per instance
+layout(location = 4) in mat4 model;
+layout(location = 8) in vec4 tint;
+
+layout(location = 0) out vec3 col;
+layout(location = 1) out vec2 tex_coord;	//Only read by bindless.frag
+
+//PositionDecode in MeshQuantizer.h
+layout(push_constant) uniform PushPositionDecode {
+    vec4 offset;
+    vec4 scale;
+} position_decode;
+
+const vec3 light_dir = vec3(0.0, 0.0, -1.0);
+
+//Same as OctahedralDecode in MeshQuantizer.cpp
+vec3 OctahedralDecode(vec2 encoded) {
+    vec3 n = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+    float fold = max(-n.z, 0.0);
+    n.xy += vec2(n.x >= 0.0 ? -fold : fold, n.y >= 0.0 ? -fold : fold);
+    return normalize(n);
+}
+
+void main() {
+    gl_Position = model * vec4(position_decode.offset.xyz + pos * position_decode.scale.xyz, 1.0);
+    col = colour * tint.rgb * max(dot(normalize(mat3(model) * OctahedralDecode(normal)), light_dir), 0.0);
+    tex_coord = uv;
+}
@@ -0,0 +1,415 @@
+#include "StagingRing.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+
+void StagingRing::Init(VkPhysicalDevice physical_device, VkDevice logical_device, DeviceAllocator& device_allocator,
+	uint32_t transfer_family_index, VkQueue transfer_queue, uint32_t graphics_family_index,
+	uint32_t frames_in_flight, VkDeviceSize size) {
+	device = logical_device;
+	allocator = &device_allocator;
+	transfer_family = transfer_family_index;
+	graphics_family = graphics_family_index;
+	queue = transfer_queue;
+	capacity = size;
+
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(physical_device, &properties);
+	image_offset_alignment = std::max<VkDeviceSize>(4, properties.limits.optimalBufferCopyOffsetAlignment);
+
+	uint32_t family_count = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &family_count, nullptr);
+	std::vector<VkQueueFamilyProperties> families(family_count);
+	vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &family_count, families.data());
+	wait_stages = WAIT_STAGES;
+	if (families[graphics_family].queueFlags & VK_QUEUE_COMPUTE_BIT) {
+		wait_stages |= VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+	}
+
+	VkBufferCreateInfo buffer_create_info = {};
+	buffer_create_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	buffer_create_info.size = capacity;
+	buffer_create_info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+	buffer_create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;		//Only ever read by the transfer queue
+
+	if (vkCreateBuffer(device, &buffer_create_info, nullptr, &ring_buffer) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create the staging buffer");
+	}
+
+	//Coherent, so writes through the mapping need no flush
+	ring_memory = allocator->AllocateForBuffer(ring_buffer, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	ring_data = static_cast<char*>(ring_memory.mapped);
+
+	VkCommandPoolCreateInfo pool_create_info = {};
+	pool_create_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	pool_create_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+	pool_create_info.queueFamilyIndex = transfer_family;
+
+	frames.resize(frames_in_flight);
+	for (auto& frame : frames) {
+		if (vkCreateCommandPool(device, &pool_create_info, nullptr, &frame.command_pool) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create a command pool");
+		}
+	}
+	current_frame = 0;
+}
+
+void StagingRing::Destroy() {
+	for (auto& frame : frames) {
+		//Fences past submission_count were reset and never submitted again
+		if (frame.submission_count != 0) {
+			vkWaitForFences(device, frame.submission_count, frame.fences.data(), VK_TRUE, std::numeric_limits<uint64_t>::max());
+		}
+		for (auto fence : frame.fences) {
+			vkDestroyFence(device, fence, nullptr);
+		}
+		vkDestroyCommandPool(device, frame.command_pool, nullptr);		//Frees its command buffers too
+	}
+	for (auto semaphore : semaphores) {
+		vkDestroySemaphore(device, semaphore, nullptr);
+	}
+	frames.clear();
+	in_flight.clear();
+	semaphores.clear();
+	free_semaphores.clear();
+	wait_semaphores.clear();
+	buffer_acquires.clear();
+	image_acquires.clear();
+
+	vkDestroyBuffer(device, ring_buffer, nullptr);
+	allocator->Free(ring_memory);
+}
+
+void StagingRing::ReleaseOldest() {
+	InFlight oldest = in_flight.front();
+	in_flight.pop_front();
+
+	vkWaitForFences(device, 1, &oldest.fence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+	used -= oldest.bytes;
+}
+
+void StagingRing::BeginFrame(uint32_t frame_index) {
+	current_frame = frame_index;
+	FrameUploads& frame = frames[current_frame];
+
+	//Submissions of this slot are normally the oldest ones still in flight, release up to the last of them.
+	//Their semaphores may still be waiting for a graphics submission, those stay in wait_semaphores
+	auto belongs_to_frame = [this](const InFlight& submission) { return submission.frame == current_frame; };
+	while (std::any_of(in_flight.begin(), in_flight.end(), belongs_to_frame)) {
+		ReleaseOldest();
+	}
+
+	if (frame.submission_count != 0) {
+		vkResetFences(device, frame.submission_count, frame.fences.data());
+		vkResetCommandPool(device, frame.command_pool, 0);
+	}
+	frame.submission_count = 0;
+
+	//The graphics fence of this slot was waited on, so its waits on these semaphores have executed too
+	free_semaphores.insert(free_semaphores.end(), frame.waited_semaphores.begin(), frame.waited_semaphores.end());
+	frame.waited_semaphores.clear();
+}
+
+VkDeviceSize StagingRing::Reserve(VkDeviceSize size, VkDeviceSize alignment) {
+	if (size > capacity) {
+		throw std::runtime_error("Upload does not fit in the staging ring");
+	}
+
+	VkDeviceSize offset = 0;
+	VkDeviceSize consumed = 0;
+	bool waited = false;
+	while (true) {
+		//Nothing in the ring, start over at 0 so a big upload doesn't depend on where head was left
+		if (used == 0) {
+			head = 0;
+		}
+
+		offset = (head + alignment - 1) / alignment * alignment;
+		consumed = offset + size - head;
+
+		//Doesn't fit before the end, skip the rest of the ring and start over at 0
+		if (offset + size > capacity) {
+			offset = 0;
+			consumed = capacity - head + size;
+		}
+		if (used + consumed <= capacity) {
+			break;
+		}
+
+		if (!waited) {
+			++stats.ring_full_waits;
+			waited = true;
+		}
+		//Nothing left to wait for but this frame's own uploads, send them first
+		if (in_flight.empty()) {
+			Submit();
+		}
+		ReleaseOldest();
+	}
+
+	head = offset + size;
+	used += consumed;
+	pending_bytes += consumed;
+	return offset;
+}
+
+void StagingRing::UploadBuffer(VkBuffer dst, VkDeviceSize dst_offset, const void* data, VkDeviceSize size, VkAccessFlags dst_access) {
+	const char* source = static_cast<const char*>(data);
+	VkDeviceSize max_chunk = capacity / 4;
+
+	while (size > 0) {
+		VkDeviceSize chunk = std::min(size, max_chunk);
+		VkDeviceSize offset = Reserve(chunk, 4);
+		std::memcpy(ring_data + offset, source, static_cast<size_t>(chunk));
+
+		PendingBuffer& pending = pending_buffers[dst];
+		pending.dst_access |= dst_access;
+
+		//Consecutive uploads to consecutive ranges become one region
+		bool merged = false;
+		if (!pending.regions.empty()) {
+			VkBufferCopy& last = pending.regions.back();
+			if (last.srcOffset + last.size == offset && last.dstOffset + last.size == dst_offset) {
+				last.size += chunk;
+				merged = true;
+			}
+		}
+		if (!merged) {
+			VkBufferCopy region = {};
+			region.srcOffset = offset;
+			region.dstOffset = dst_offset;
+			region.size = chunk;
+			pending.regions.push_back(region);
+		}
+
+		stats.uploaded_bytes += chunk;
+		source += chunk;
+		dst_offset += chunk;
+		size -= chunk;
+	}
+}
+
+void StagingRing::UploadImage(VkImage dst, VkExtent3D extent, VkDeviceSize texel_size, const void* data, VkImageAspectFlags aspect) {
+	//Buffer offset must be a multiple of 4 and of the texel size
+	VkDeviceSize alignment = std::lcm(image_offset_alignment, texel_size);
+	VkDeviceSize size = texel_size * extent.width * extent.height * extent.depth;
+	VkDeviceSize offset = Reserve(size, alignment);
+	std::memcpy(ring_data + offset, data, static_cast<size_t>(size));
+
+	PendingImage pending = {};
+	pending.image = dst;
+	pending.region.bufferOffset = offset;
+	pending.region.bufferRowLength = 0;					//Tightly packed
+	pending.region.bufferImageHeight = 0;
+	pending.region.imageSubresource.aspectMask = aspect;
+	pending.region.imageSubresource.mipLevel = 0;
+	pending.region.imageSubresource.baseArrayLayer = 0;
+	pending.region.imageSubresource.layerCount = 1;
+	pending.region.imageOffset = { 0, 0, 0 };
+	pending.region.imageExtent = extent;
+	pending_images.push_back(pending);
+
+	stats.uploaded_bytes += size;
+}
+
+void StagingRing::RecordCopies(VkCommandBuffer command_buffer) {
+	auto image_barrier = [](VkImage image, VkImageAspectFlags aspect) {
+		VkImageMemoryBarrier barrier = {};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.image = image;
+		barrier.subresourceRange.aspectMask = aspect;
+		barrier.subresourceRange.baseMipLevel = 0;
+		barrier.subresourceRange.levelCount = 1;
+		barrier.subresourceRange.baseArrayLayer = 0;
+		barrier.subresourceRange.layerCount = 1;
+		return barrier;
+	};
+
+	//Images: old contents are discarded, then one copy each
+	std::vector<VkImageMemoryBarrier> to_transfer;
+	for (const auto& pending : pending_images) {
+		VkImageMemoryBarrier barrier = image_barrier(pending.image, pending.region.imageSubresource.aspectMask);
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		to_transfer.push_back(barrier);
+	}
+	if (!to_transfer.empty()) {
+		vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+			0, nullptr, 0, nullptr, static_cast<uint32_t>(to_transfer.size()), to_transfer.data());
+	}
+
+	for (const auto& pending : pending_buffers) {
+		vkCmdCopyBuffer(command_buffer, ring_buffer, pending.first,
+			static_cast<uint32_t>(pending.second.regions.size()), pending.second.regions.data());
+		++stats.copy_commands;
+		stats.copy_regions += pending.second.regions.size();
+	}
+	for (const auto& pending : pending_images) {
+		vkCmdCopyBufferToImage(command_buffer, ring_buffer, pending.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &pending.region);
+		++stats.copy_commands;
+		++stats.copy_regions;
+	}
+
+	//Hand over to the graphics family: release here, acquire in RecordAcquireBarriers.
+	//With one family the semaphore is enough for buffers and images only need their layout changed
+	std::vector<VkBufferMemoryBarrier> buffer_releases;
+	std::vector<VkImageMemoryBarrier> image_releases;
+	for (const auto& pending : pending_buffers) {
+		if (!SeparateFamilies()) {
+			break;
+		}
+
+		VkBufferMemoryBarrier barrier = {};
+		barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = 0;
+		barrier.srcQueueFamilyIndex = transfer_family;
+		barrier.dstQueueFamilyIndex = graphics_family;
+		barrier.buffer = pending.first;
+		barrier.offset = 0;
+		barrier.size = VK_WHOLE_SIZE;
+		buffer_releases.push_back(barrier);
+
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = pending.second.dst_access;
+		buffer_acquires.push_back(barrier);
+	}
+	for (const auto& pending : pending_images) {
+		VkImageMemoryBarrier barrier = image_barrier(pending.image, pending.region.imageSubresource.aspectMask);
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = SeparateFamilies() ? 0 : VK_ACCESS_SHADER_READ_BIT;
+		barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		if (SeparateFamilies()) {
+			barrier.srcQueueFamilyIndex = transfer_family;
+			barrier.dstQueueFamilyIndex = graphics_family;
+		}
+		image_releases.push_back(barrier);
+
+		if (SeparateFamilies()) {
+			barrier.srcAccessMask = 0;
+			barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+			image_acquires.push_back(barrier);
+		}
+	}
+	if (!buffer_releases.empty() || !image_releases.empty()) {
+		//A transfer-only queue can't name graphics stages, the graphics side waits on the semaphore anyway
+		VkPipelineStageFlags dst_stage = SeparateFamilies() ? VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT : VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+		vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, dst_stage, 0, 0, nullptr,
+			static_cast<uint32_t>(buffer_releases.size()), buffer_releases.data(),
+			static_cast<uint32_t>(image_releases.size()), image_releases.data());
+	}
+}
+
+void StagingRing::Submit() {
+	if (pending_buffers.empty() && pending_images.empty()) {
+		return;
+	}
+
+	FrameUploads& frame = frames[current_frame];
+
+	//Grow the slot's submission objects on demand, the same ones are reused every time the slot comes around
+	if (frame.submission_count == frame.command_buffers.size()) {
+		VkCommandBufferAllocateInfo allocate_info = {};
+		allocate_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocate_info.commandPool = frame.command_pool;
+		allocate_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		allocate_info.commandBufferCount = 1;
+
+		VkFenceCreateInfo fence_create_info = {};
+		fence_create_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+		VkCommandBuffer command_buffer;
+		VkFence fence;
+		if (vkAllocateCommandBuffers(device, &allocate_info, &command_buffer) != VK_SUCCESS ||
+			vkCreateFence(device, &fence_create_info, nullptr, &fence) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create upload submission objects");
+		}
+		frame.command_buffers.push_back(command_buffer);
+		frame.fences.push_back(fence);
+	}
+
+	//Semaphores are freed by the slot that waited on them, which need not be the one that signalled them
+	if (free_semaphores.empty()) {
+		VkSemaphoreCreateInfo semaphore_create_info = {};
+		semaphore_create_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+		VkSemaphore semaphore;
+		if (vkCreateSemaphore(device, &semaphore_create_info, nullptr, &semaphore) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create upload submission objects");
+		}
+		semaphores.push_back(semaphore);
+		free_semaphores.push_back(semaphore);
+	}
+	VkSemaphore semaphore = free_semaphores.back();
+	free_semaphores.pop_back();
+
+	uint32_t index = frame.submission_count++;
+	VkCommandBuffer command_buffer = frame.command_buffers[index];
+
+	VkCommandBufferBeginInfo begin_info = {};
+	begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+	if (vkBeginCommandBuffer(command_buffer, &begin_info) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to start recording a command buffer");
+	}
+	RecordCopies(command_buffer);
+	if (vkEndCommandBuffer(command_buffer) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to stop recording a command buffer");
+	}
+
+	VkSubmitInfo submit_info = {};
+	submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submit_info.commandBufferCount = 1;
+	submit_info.pCommandBuffers = &command_buffer;
+	submit_info.signalSemaphoreCount = 1;
+	submit_info.pSignalSemaphores = &semaphore;
+
+	if (vkQueueSubmit(queue, 1, &submit_info, frame.fences[index]) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to submit uploads");
+	}
+
+	wait_semaphores.push_back(semaphore);
+	in_flight.push_back({ frame.fences[index], pending_bytes, current_frame });
+	pending_bytes = 0;
+	pending_buffers.clear();
+	pending_images.clear();
+	++stats.submissions;
+}
+
+std::vector<VkSemaphore> StagingRing::TakeWaitSemaphores() {
+	std::vector<VkSemaphore> taken;
+	taken.swap(wait_semaphores);
+
+	std::vector<VkSemaphore>& waited = frames[current_frame].waited_semaphores;
+	waited.insert(waited.end(), taken.begin(), taken.end());
+	return taken;
+}
+
+void StagingRing::RecordAcquireBarriers(VkCommandBuffer graphics_command_buffer) {
+	if (buffer_acquires.empty() && image_acquires.empty()) {
+		return;
+	}
+
+	vkCmdPipelineBarrier(graphics_command_buffer, wait_stages, wait_stages, 0, 0, nullptr,
+		static_cast<uint32_t>(buffer_acquires.size()), buffer_acquires.data(),
+		static_cast<uint32_t>(image_acquires.size()), image_acquires.data());
+	buffer_acquires.clear();
+	image_acquires.clear();
+}
+
+void StagingRing::PrintStats(std::ostream& out) const {
+	out << std::fixed << std::setprecision(1)
+		<< "Staging: " << stats.uploaded_bytes / (1024.0 * 1024.0) << " MiB uploaded in " << stats.submissions << " submissions, "
+		<< stats.copy_commands << " copy commands for " << stats.copy_regions << " regions, "
+		<< stats.ring_full_waits << " waits for ring space" << std::endl;
+}
@@ -0,0 +1,134 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <deque>
+#include <map>
+#include <ostream>
+#include <vector>
+
+#include "DeviceAllocator.h"
+
+//Persistently mapped, host visible ring buffer that streams uploads through the transfer queue.
+//Uploads queued during a frame are copied into the ring and go out as one submission with as few copy commands
+//as possible (one vkCmdCopyBuffer per destination buffer). Ring space is reclaimed through the fences of those
+//submissions, so the CPU only waits when the ring is full.
+//
+//Per frame: BeginFrame (after the frame slot's fence wait), Upload*, Submit, then the graphics command buffer starts
+//with RecordAcquireBarriers() and its submission waits on TakeWaitSemaphores()
+class StagingRing
+{
+public:
+	struct Stats {
+		uint64_t uploaded_bytes = 0;
+		uint64_t copy_regions = 0;
+		uint64_t copy_commands = 0;			//vkCmdCopyBuffer / vkCmdCopyBufferToImage calls
+		uint64_t submissions = 0;
+		uint64_t ring_full_waits = 0;		//Times an upload had to wait for the GPU to free ring space
+	};
+
+	static const VkDeviceSize DEFAULT_SIZE = 32ull * 1024 * 1024;
+
+	//Stages where the graphics queue waits for uploads (vertex input, uniforms and textures, indirect arguments).
+	//GetWaitStages() adds compute when the graphics family can run it (GPU culling reads uploaded buffers)
+	static const VkPipelineStageFlags WAIT_STAGES = VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT |
+		VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+
+	void Init(VkPhysicalDevice physical_device, VkDevice logical_device, DeviceAllocator& device_allocator,
+		uint32_t transfer_family, VkQueue transfer_queue, uint32_t graphics_family,
+		uint32_t frames_in_flight, VkDeviceSize size = DEFAULT_SIZE);
+	void Destroy();
+
+	//Call once the frame slot's fence has been waited on, its upload submissions and the semaphores its graphics
+	//submission waited on can be reused then
+	void BeginFrame(uint32_t frame_index);
+
+	//dst_access is how the graphics queue reads the buffer afterwards (VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT, ...).
+	//Uploads bigger than the ring are split
+	void UploadBuffer(VkBuffer dst, VkDeviceSize dst_offset, const void* data, VkDeviceSize size, VkAccessFlags dst_access);
+
+	//Whole mip 0 of a 2D image, left in SHADER_READ_ONLY_OPTIMAL. data is tightly packed texels.
+	//Not split, throws std::runtime_error when the image is bigger than the whole ring
+	void UploadImage(VkImage dst, VkExtent3D extent, VkDeviceSize texel_size, const void* data,
+		VkImageAspectFlags aspect = VK_IMAGE_ASPECT_COLOR_BIT);
+
+	//Records and submits everything queued since the last submission (does nothing when there is nothing queued)
+	void Submit();
+
+	//Signalled by every submission not yet waited on. The graphics submission of the frame must wait on all of them
+	//(at GetWaitStages())
+	std::vector<VkSemaphore> TakeWaitSemaphores();
+	VkPipelineStageFlags GetWaitStages() const { return wait_stages; }
+
+	//Queue family ownership acquire for everything submitted since the last call (only needed with a dedicated transfer family)
+	void RecordAcquireBarriers(VkCommandBuffer graphics_command_buffer);
+
+	Stats GetStats() const { return stats; }
+	void PrintStats(std::ostream& out) const;
+
+private:
+	struct PendingBuffer {
+		std::vector<VkBufferCopy> regions;
+		VkAccessFlags dst_access = 0;
+	};
+
+	struct PendingImage {
+		VkImage image;
+		VkBufferImageCopy region;
+	};
+
+	//Upload submissions made while a frame slot was current. Reused when the slot comes around again
+	struct FrameUploads {
+		VkCommandPool command_pool = VK_NULL_HANDLE;
+		std::vector<VkCommandBuffer> command_buffers;
+		std::vector<VkFence> fences;
+		uint32_t submission_count = 0;
+		std::vector<VkSemaphore> waited_semaphores;		//Waited on by this slot's graphics submission, free after its fence
+	};
+
+	//Ring bytes held by one submission, released in submission order
+	struct InFlight {
+		VkFence fence;
+		VkDeviceSize bytes;
+		uint32_t frame;
+	};
+
+	VkDevice device = VK_NULL_HANDLE;
+	DeviceAllocator* allocator = nullptr;
+	uint32_t transfer_family = 0;
+	uint32_t graphics_family = 0;
+	VkQueue queue = VK_NULL_HANDLE;
+	VkPipelineStageFlags wait_stages = WAIT_STAGES;
+	VkDeviceSize image_offset_alignment = 4;
+
+	VkBuffer ring_buffer = VK_NULL_HANDLE;
+	DeviceAllocation ring_memory;
+	char* ring_data = nullptr;
+	VkDeviceSize capacity = 0;
+	VkDeviceSize head = 0;					//Next write position
+	VkDeviceSize used = 0;					//Bytes in flight or pending, including padding and skipped ends
+	VkDeviceSize pending_bytes = 0;			//Part of used not submitted yet
+	std::deque<InFlight> in_flight;
+
+	std::map<VkBuffer, PendingBuffer> pending_buffers;
+	std::vector<PendingImage> pending_images;
+
+	std::vector<FrameUploads> frames;
+	uint32_t current_frame = 0;
+
+	//Whatever was submitted but not picked up yet belongs to the next graphics submission, whichever slot it uses.
+	//Uploads made between frames (or during Init) are submitted while the previous slot is current
+	std::vector<VkSemaphore> wait_semaphores;
+	std::vector<VkBufferMemoryBarrier> buffer_acquires;
+	std::vector<VkImageMemoryBarrier> image_acquires;
+
+	std::vector<VkSemaphore> semaphores;				//Every semaphore created, for Destroy
+	std::vector<VkSemaphore> free_semaphores;
+	Stats stats;
+
+	VkDeviceSize Reserve(VkDeviceSize size, VkDeviceSize alignment);
+	void ReleaseOldest();
+	bool SeparateFamilies() const { return transfer_family != graphics_family; }
+	void RecordCopies(VkCommandBuffer command_buffer);
+};
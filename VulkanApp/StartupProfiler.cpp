@@ -0,0 +1,125 @@
+#include "StartupProfiler.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <stdexcept>
+
+namespace {
+	double ToMs(StartupProfiler::Clock::duration duration) {
+		return std::chrono::duration<double, std::milli>(duration).count();
+	}
+
+	double ToUs(StartupProfiler::Clock::duration duration) {
+		return std::chrono::duration<double, std::micro>(duration).count();
+	}
+
+	//Earlier first, and enclosing events before the events they contain
+	bool StartsBefore(const StartupProfiler::Event& a, const StartupProfiler::Event& b) {
+		if (a.start != b.start) {
+			return a.start < b.start;
+		}
+		return a.end > b.end;
+	}
+}
+
+StartupProfiler& StartupProfiler::Get() {
+	static StartupProfiler profiler;
+	return profiler;
+}
+
+StartupProfiler::StartupProfiler() : origin(Clock::now()) {
+	events.reserve(64);
+}
+
+void StartupProfiler::Record(const std::string& name, const char* category, Clock::time_point start, Clock::time_point end) {
+	std::lock_guard<std::mutex> lock(events_mutex);
+	if (finished) {
+		return;
+	}
+
+	events.push_back({ name, category, start, end, std::this_thread::get_id() });
+}
+
+void StartupProfiler::MarkFirstFrame() {
+	Clock::time_point now = Clock::now();
+
+	std::lock_guard<std::mutex> lock(events_mutex);
+	if (finished) {
+		return;
+	}
+
+	first_frame = now;
+	finished = true;
+	events.push_back({ "FirstFrame", "frame", origin, now, std::this_thread::get_id() });
+}
+
+std::vector<StartupProfiler::Event> StartupProfiler::GetEvents() const {
+	std::lock_guard<std::mutex> lock(events_mutex);
+	std::vector<Event> sorted = events;
+	std::sort(sorted.begin(), sorted.end(), StartsBefore);
+	return sorted;
+}
+
+double StartupProfiler::GetTimeToFirstFrameMs() const {
+	return finished ? ToMs(first_frame - origin) : 0.0;
+}
+
+void StartupProfiler::PrintReport(std::ostream& out) const {
+	std::vector<Event> sorted = GetEvents();
+	double total_ms = GetTimeToFirstFrameMs();
+
+	out << "Startup report (time to first frame: " << std::fixed << std::setprecision(2) << total_ms << " ms)" << std::endl;
+	out << std::right << std::setw(10) << "start" << std::setw(10) << "ms" << std::setw(8) << "%" << "  stage" << std::endl;
+
+	//Indent each event by how many events on the same thread enclose it
+	for (size_t i = 0; i < sorted.size(); ++i) {
+		const Event& event = sorted[i];
+		if (event.name == "FirstFrame") {
+			continue;
+		}
+
+		int depth = 0;
+		for (size_t j = 0; j < i; ++j) {
+			if (sorted[j].thread == event.thread && sorted[j].end >= event.end && sorted[j].name != "FirstFrame") {
+				++depth;
+			}
+		}
+
+		double duration_ms = ToMs(event.end - event.start);
+		out << std::setw(10) << ToMs(event.start - origin)
+			<< std::setw(10) << duration_ms
+			<< std::setw(8) << std::setprecision(1) << (total_ms > 0.0 ? duration_ms * 100.0 / total_ms : 0.0)
+			<< std::setprecision(2) << "  " << std::string(depth * 2, ' ') << event.name
+			<< " [" << event.category << "]" << std::endl;
+	}
+}
+
+void StartupProfiler::WriteChromeTrace(const std::string& path) const {
+	std::ofstream out(path);
+	if (!out.is_open()) {
+		throw std::runtime_error("Failed to open startup trace output : " + path);
+	}
+
+	std::vector<Event> sorted = GetEvents();
+
+	//Chrome's viewer wants small integer thread ids
+	std::map<std::thread::id, int> thread_ids;
+	for (const Event& event : sorted) {
+		thread_ids.emplace(event.thread, static_cast<int>(thread_ids.size()) + 1);
+	}
+
+	//Complete ("X") events in microseconds - loads in chrome://tracing and Perfetto
+	out << std::fixed << std::setprecision(3);
+	out << "{\"traceEvents\":[";
+	for (size_t i = 0; i < sorted.size(); ++i) {
+		const Event& event = sorted[i];
+		out << (i == 0 ? "\n" : ",\n");
+		out << "  {\"name\":\"" << event.name << "\",\"cat\":\"" << event.category
+			<< "\",\"ph\":\"X\",\"ts\":" << ToUs(event.start - origin)
+			<< ",\"dur\":" << ToUs(event.end - event.start)
+			<< ",\"pid\":1,\"tid\":" << thread_ids[event.thread] << "}";
+	}
+	out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+}
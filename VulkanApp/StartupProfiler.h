@@ -0,0 +1,67 @@
+#pragma once
+
+#include <chrono>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+//Records how long each startup stage and Vulkan call takes, up to the first presented frame.
+//Thread safe - pipelines are built on worker threads
+class StartupProfiler
+{
+public:
+	using Clock = std::chrono::steady_clock;
+
+	struct Event {
+		std::string name;
+		const char* category;
+		Clock::time_point start;
+		Clock::time_point end;
+		std::thread::id thread;
+	};
+
+	static StartupProfiler& Get();
+
+	void Record(const std::string& name, const char* category, Clock::time_point start, Clock::time_point end);
+
+	//Closes the startup window. Events recorded after this are ignored
+	void MarkFirstFrame();
+
+	void PrintReport(std::ostream& out) const;
+	void WriteChromeTrace(const std::string& path) const;
+
+	std::vector<Event> GetEvents() const;
+	Clock::time_point GetOrigin() const { return origin; }
+	double GetTimeToFirstFrameMs() const;
+
+private:
+	StartupProfiler();
+
+	Clock::time_point origin;
+	Clock::time_point first_frame;
+	bool finished = false;
+	std::vector<Event> events;
+	mutable std::mutex events_mutex;
+};
+
+//Records the lifetime of the scope as one startup event
+class ScopedTimer
+{
+public:
+	explicit ScopedTimer(std::string timer_name, const char* timer_category = "init")
+		: name(std::move(timer_name)), category(timer_category), start(StartupProfiler::Clock::now()) {}
+
+	~ScopedTimer() {
+		StartupProfiler::Get().Record(name, category, start, StartupProfiler::Clock::now());
+	}
+
+	ScopedTimer(const ScopedTimer&) = delete;
+	ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+private:
+	std::string name;
+	const char* category;
+	StartupProfiler::Clock::time_point start;
+};
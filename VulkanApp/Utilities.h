@@ -1,15 +1,62 @@
 #pragma once
 #include <optional>
-#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include "VertexFormat.h"
 
 const std::vector<const char*> device_extensions = {
 	VK_KHR_SWAPCHAIN_EXTENSION_NAME
 };
 
+//Layout must match the vertex inputs of shader.vert
+struct Vertex {
+	glm::vec3 pos;		//Vertex position (x, y, z)
+	glm::vec3 normal;	//Vertex normal, unit length
+	glm::vec2 uv;		//Texture coordinates (u, v)
+	glm::vec3 col;		//Vertex colour (r, g, b)
+};
+
+template<> struct VertexTraits<Vertex> {
+	static constexpr VertexAttribute attributes[] = {
+		VERTEX_ATTRIBUTE(Vertex, pos), VERTEX_ATTRIBUTE(Vertex, normal), VERTEX_ATTRIBUTE(Vertex, uv), VERTEX_ATTRIBUTE(Vertex, col)
+	};
+};
+
+//Per-instance vertex data (binding 1), follows the mesh's vertex locations in the vertex shaders
+struct InstanceData {
+	glm::mat4 model;	//Object to clip space, uniform scale only (normals use its upper 3x3)
+	glm::vec4 tint;		//Multiplies the vertex colour
+};
+
+template<> struct VertexTraits<InstanceData> {
+	static constexpr VertexAttribute attributes[] = { VERTEX_ATTRIBUTE(InstanceData, model), VERTEX_ATTRIBUTE(InstanceData, tint) };
+};
+
+//How mesh vertices are stored on the GPU, see MeshQuantizer.h
+enum class VertexEncoding {
+	FULL,			//Vertex, 32 bit floats
+	UNORM16,		//QuantizedVertexUnorm16
+	HALF			//QuantizedVertexHalf
+};
+
 //Indices (locations) of queue families (if they exist at all)
 struct QueueFamilyIndices {
 	std::optional<uint32_t> graphics_family; //Location of graphics queue family
 	std::optional<uint32_t> presentation_family; //Location of presentation queue family
+	std::optional<uint32_t> transfer_family; //Transfer-only family if there is one, otherwise the best available fallback
+	std::optional<uint32_t> compute_family; //Compute family without graphics if there is one, otherwise graphics_family
+
+	//Dedicated families run next to graphics instead of queueing behind it
+	bool HasDedicatedTransfer() const {
+		return transfer_family.has_value() && transfer_family != graphics_family;
+	}
+	bool HasDedicatedCompute() const {
+		return compute_family.has_value() && compute_family != graphics_family;
+	}
 
 	bool IsComplete() {
 		return graphics_family.has_value() && presentation_family.has_value();
@@ -27,20 +74,58 @@ struct SwapchainImage {
 	VkImageView image_view;
 };
 
-static std::vector<char> ReadFile(const std::string& filename) {
-	//std::ios::ate tells stream to start reading from end of file
-	std::ifstream infile(filename, std::ios::binary | std::ios::ate);
-	if (!infile.is_open()) {
-		throw std::runtime_error("Failed to open a file : " + filename);
-	}
+//Per-frame resources, one set for every frame that can be in flight at once
+struct FrameData {
+	VkCommandPool command_pool;			//Reset as a whole each time this frame slot is reused
+	VkCommandBuffer command_buffer;
+	std::vector<VkCommandPool> slice_command_pools;		//One per recording thread, each reset by the thread recording into it
+	std::vector<VkCommandBuffer> slice_command_buffers;	//Secondary, one slice of the draw list each, executed by command_buffer
+	VkSemaphore image_available;		//Signalled when the acquired swapchain image can be rendered to
+	VkSemaphore render_finished;		//Signalled when rendering is done and the image can be presented
+	VkFence in_flight;					//Signalled when the GPU has finished executing this frame slot
+	VkSemaphore ownership_acquired = VK_NULL_HANDLE;	//Presentation family owns the image (only when it differs from graphics)
+};
+
+//Settings chosen before Init
+struct RendererOptions {
+	uint32_t frames_in_flight = 2;		//How many frames the CPU may record ahead of the GPU
+	bool headless = false;				//Render into offscreen images - no window, surface or swapchain
+	uint64_t max_frames = 0;			//Stop after this many frames (0 = until the window is closed)
+	uint64_t bench_frames = 0;			//Time this many frames (after a warm-up) and report them, 0 = off
+	std::string bench_output = "bench_results.json";
+	std::string pipeline_cache_path = "pipeline_cache.bin";	//Empty = don't load or save the pipeline cache
+	std::string startup_trace_path = "startup_trace.json";	//Chrome trace of Init, empty = text report only
+	std::string gpu_override;			//Use the GPU with this UUID or name (part of it), empty = best scored one
+	bool alloc_test = false;			//Run the memory allocator self test instead of rendering
+	uint64_t alloc_bench_operations = 0;	//Benchmark the memory allocator with this many operations instead of rendering
+	uint64_t cull_bench_objects = 0;	//Benchmark CPU frustum culling with up to this many objects instead of rendering
+	uint64_t scene_bench_nodes = 0;		//Benchmark scene graph transform updates with this many nodes instead of rendering
+	bool job_test = false;				//Run the job system self test instead of rendering
+	uint64_t job_bench_objects = 0;		//Benchmark job system scaling over this many objects instead of rendering
+	uint64_t triangle_count = 1;		//Triangles in the generated scene mesh (benchmarks push millions)
+	uint32_t instance_count = 1;		//Copies of the scene mesh, all drawn by one instanced draw
+	uint32_t draws_per_batch = 1;		//Split every instance batch into this many draws (stresses command recording)
+	uint32_t record_threads = 1;		//Threads recording the draw list into secondary command buffers, 0 = all hardware threads
+	uint64_t record_bench_frames = 0;	//After rendering, time recording this many frames at every thread count
+	VertexEncoding vertex_encoding = VertexEncoding::FULL;
+	float instance_spread = 1.0f;		//Distance between copies, > 1 moves some of them off screen
+	bool gpu_driven = false;			//Compute frustum culling + vkCmdDrawIndexedIndirectCount, see GpuCulling.h
+	bool verify_culling = false;		//Check GPU survivor counts against a CPU cull every frame
+	bool bindless = false;				//Materials and textures through descriptor indexing, see BindlessDescriptors.h
+	bool parallel_init = true;			//Run independent Init stages concurrently, false = one after another
+	std::string shader_directory;		//Load <name>.spv from here instead of the embedded SPIR-V (for shader development)
+};
 
-	//Get current read position
-	size_t file_size = (size_t)infile.tellg();
-	std::vector<char> file_buffer(file_size);
+static uint32_t FindMemoryTypeIndex(VkPhysicalDevice physical_device, uint32_t allowed_types, VkMemoryPropertyFlags properties) {
+	VkPhysicalDeviceMemoryProperties memory_properties;
+	vkGetPhysicalDeviceMemoryProperties(physical_device, &memory_properties);
 
-	infile.seekg(0);
-	infile.read(file_buffer.data(), file_size);
-	infile.close();
+	for (uint32_t i = 0; i < memory_properties.memoryTypeCount; ++i) {
+		if ((allowed_types & (1 << i)) &&													//Index of memory type must match corresponding bit in allowed_types
+			(memory_properties.memoryTypes[i].propertyFlags & properties) == properties) {	//Desired property bit flags are part of memory type's property flags
+			return i;
+		}
+	}
 
-	return file_buffer;
-}
\ No newline at end of file
+	throw std::runtime_error("Failed to find a suitable memory type");
+}
@@ -0,0 +1,213 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <type_traits>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+
+//Half precision vectors as stored in a vertex buffer. glm has no half float type, so the bits are packed
+//on the CPU with glm::packHalf and expanded back to float by the vertex fetch
+struct PackedHalf2 {
+	glm::u16vec2 bits;
+
+	PackedHalf2() = default;
+	explicit PackedHalf2(const glm::vec2& value) : bits(glm::packHalf(value)) {}
+};
+
+struct PackedHalf4 {
+	glm::u16vec4 bits;
+
+	PackedHalf4() = default;
+	explicit PackedHalf4(const glm::vec4& value) : bits(glm::packHalf(value)) {}
+};
+
+//Vulkan format of a vertex attribute type. Float vectors stay float, 8 and 16 bit integer vectors are
+//normalised (UNORM/SNORM, e.g. u8vec4 colours) and 32 bit integer vectors are read as integers
+template<typename T>
+struct VertexAttributeFormat {
+	static_assert(sizeof(T) == 0, "No Vulkan vertex format is known for this attribute type");
+};
+
+#define VERTEX_ATTRIBUTE_FORMAT(type, vk_format, component_size, location_count)	\
+	template<> struct VertexAttributeFormat<type> {									\
+		static constexpr VkFormat format = vk_format;								\
+		static constexpr uint32_t alignment = component_size;						\
+		static constexpr uint32_t locations = location_count;						\
+	};
+
+VERTEX_ATTRIBUTE_FORMAT(float, VK_FORMAT_R32_SFLOAT, 4, 1)
+VERTEX_ATTRIBUTE_FORMAT(glm::vec2, VK_FORMAT_R32G32_SFLOAT, 4, 1)
+VERTEX_ATTRIBUTE_FORMAT(glm::vec3, VK_FORMAT_R32G32B32_SFLOAT, 4, 1)
+VERTEX_ATTRIBUTE_FORMAT(glm::vec4, VK_FORMAT_R32G32B32A32_SFLOAT, 4, 1)
+VERTEX_ATTRIBUTE_FORMAT(glm::mat4, VK_FORMAT_R32G32B32A32_SFLOAT, 4, 4)		//One vec4 column per location
+VERTEX_ATTRIBUTE_FORMAT(int32_t, VK_FORMAT_R32_SINT, 4, 1)
+VERTEX_ATTRIBUTE_FORMAT(glm::ivec2, VK_FORMAT_R32G32_SINT, 4, 1)
+VERTEX_ATTRIBUTE_FORMAT(glm::ivec3, VK_FORMAT_R32G32B32_SINT, 4, 1)
+VERTEX_ATTRIBUTE_FORMAT(glm::ivec4, VK_FORMAT_R32G32B32A32_SINT, 4, 1)
+VERTEX_ATTRIBUTE_FORMAT(uint32_t, VK_FORMAT_R32_UINT, 4, 1)
+VERTEX_ATTRIBUTE_FORMAT(glm::uvec2, VK_FORMAT_R32G32_UINT, 4, 1)
+VERTEX_ATTRIBUTE_FORMAT(glm::uvec3, VK_FORMAT_R32G32B32_UINT, 4, 1)
+VERTEX_ATTRIBUTE_FORMAT(glm::uvec4, VK_FORMAT_R32G32B32A32_UINT, 4, 1)
+VERTEX_ATTRIBUTE_FORMAT(glm::u8vec4, VK_FORMAT_R8G8B8A8_UNORM, 1, 1)
+VERTEX_ATTRIBUTE_FORMAT(glm::i8vec4, VK_FORMAT_R8G8B8A8_SNORM, 1, 1)
+VERTEX_ATTRIBUTE_FORMAT(glm::u16vec2, VK_FORMAT_R16G16_UNORM, 2, 1)
+VERTEX_ATTRIBUTE_FORMAT(glm::i16vec2, VK_FORMAT_R16G16_SNORM, 2, 1)
+VERTEX_ATTRIBUTE_FORMAT(glm::u16vec4, VK_FORMAT_R16G16B16A16_UNORM, 2, 1)
+VERTEX_ATTRIBUTE_FORMAT(glm::i16vec4, VK_FORMAT_R16G16B16A16_SNORM, 2, 1)
+VERTEX_ATTRIBUTE_FORMAT(PackedHalf2, VK_FORMAT_R16G16_SFLOAT, 2, 1)
+VERTEX_ATTRIBUTE_FORMAT(PackedHalf4, VK_FORMAT_R16G16B16A16_SFLOAT, 2, 1)
+
+#undef VERTEX_ATTRIBUTE_FORMAT
+
+//One member of a vertex struct, see VERTEX_ATTRIBUTE
+struct VertexAttribute {
+	VkFormat format;
+	uint32_t offset;
+	uint32_t size;
+	uint32_t alignment;
+	uint32_t locations;
+};
+
+template<typename T>
+constexpr VertexAttribute MakeVertexAttribute(size_t offset) {
+	return { VertexAttributeFormat<T>::format, static_cast<uint32_t>(offset), static_cast<uint32_t>(sizeof(T)),
+		VertexAttributeFormat<T>::alignment, VertexAttributeFormat<T>::locations };
+}
+
+//offsetof is a constant expression for standard layout types, so the whole description is built at compile time
+#define VERTEX_ATTRIBUTE(vertex_type, member) \
+	MakeVertexAttribute<decltype(vertex_type::member)>(offsetof(vertex_type, member))
+
+//Specialise for every vertex struct, listing its members in shader location order:
+//	template<> struct VertexTraits<Vertex> {
+//		static constexpr VertexAttribute attributes[] = { VERTEX_ATTRIBUTE(Vertex, pos), VERTEX_ATTRIBUTE(Vertex, col) };
+//	};
+template<typename V>
+struct VertexTraits {
+	static_assert(sizeof(V) == 0, "Vertex struct has no VertexTraits specialisation");
+};
+
+//Spec minimums for maxVertexInputAttributes, maxVertexInputAttributeOffset and maxVertexInputBindingStride,
+//so a layout that passes the checks below works on every device
+constexpr uint32_t MAX_VERTEX_LOCATIONS = 16;
+constexpr uint32_t MAX_VERTEX_ATTRIBUTE_OFFSET = 2047;
+constexpr uint32_t MAX_VERTEX_STRIDE = 2048;
+
+template<typename V>
+constexpr uint32_t VertexLocationCount() {
+	uint32_t count = 0;
+	for (const VertexAttribute& attribute : VertexTraits<V>::attributes) {
+		count += attribute.locations;
+	}
+	return count;
+}
+
+//Every attribute inside the struct, aligned to its component size and not overlapping another
+template<typename V>
+constexpr bool VertexAttributesFit() {
+	const auto& attributes = VertexTraits<V>::attributes;
+	for (size_t i = 0; i < std::size(attributes); ++i) {
+		if (attributes[i].offset + attributes[i].size > sizeof(V) || attributes[i].offset % attributes[i].alignment != 0
+			|| attributes[i].offset > MAX_VERTEX_ATTRIBUTE_OFFSET) {
+			return false;
+		}
+		for (size_t j = i + 1; j < std::size(attributes); ++j) {
+			if (attributes[i].offset < attributes[j].offset + attributes[j].size
+				&& attributes[j].offset < attributes[i].offset + attributes[i].size) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+//Attributes cover the whole stride - padding would be fetched (and uploaded) for nothing
+template<typename V>
+constexpr bool VertexHasNoPadding() {
+	uint32_t covered = 0;
+	for (const VertexAttribute& attribute : VertexTraits<V>::attributes) {
+		covered += attribute.size;
+	}
+	return covered == sizeof(V);
+}
+
+template<typename V>
+constexpr bool ValidateVertexLayout() {
+	static_assert(std::is_standard_layout_v<V>, "Vertex struct must be standard layout for offsetof");
+	static_assert(std::is_trivially_copyable_v<V>, "Vertex struct must be trivially copyable to be uploaded");
+	static_assert(VertexAttributesFit<V>(), "Vertex attribute is misaligned, overlaps another or lies outside the struct");
+	static_assert(VertexHasNoPadding<V>(), "Vertex struct has padding or members missing from VertexTraits");
+	static_assert(sizeof(V) % 4 == 0, "Vertex stride must be a multiple of 4 bytes");
+	static_assert(sizeof(V) <= MAX_VERTEX_STRIDE, "Vertex stride exceeds the guaranteed maxVertexInputBindingStride");
+	return true;
+}
+
+//One vertex buffer binding: a vertex struct and whether it advances per vertex or per instance
+template<typename V, VkVertexInputRate Rate = VK_VERTEX_INPUT_RATE_VERTEX>
+struct VertexBinding {
+	using VertexType = V;
+	static constexpr VkVertexInputRate input_rate = Rate;
+};
+
+//Non-owning view of a pipeline's vertex input state. Usually points at a VertexInput's static arrays
+struct VertexInputLayout {
+	const VkVertexInputBindingDescription* bindings = nullptr;
+	uint32_t binding_count = 0;
+	const VkVertexInputAttributeDescription* attributes = nullptr;
+	uint32_t attribute_count = 0;
+};
+
+template<typename... Bindings>
+constexpr uint32_t VERTEX_INPUT_LOCATIONS = (VertexLocationCount<typename Bindings::VertexType>() + ...);
+
+template<typename V, size_t N>
+constexpr void AppendVertexAttributes(std::array<VkVertexInputAttributeDescription, N>& result, uint32_t binding, uint32_t& location) {
+	//Multi-location types (matrices) are split into equal column sized attributes
+	for (const VertexAttribute& attribute : VertexTraits<V>::attributes) {
+		uint32_t column_size = attribute.size / attribute.locations;
+		for (uint32_t column = 0; column < attribute.locations; ++column) {
+			result[location] = { location, binding, attribute.format, attribute.offset + column * column_size };
+			++location;
+		}
+	}
+}
+
+template<typename... Bindings>
+constexpr std::array<VkVertexInputBindingDescription, sizeof...(Bindings)> MakeVertexBindings() {
+	std::array<VkVertexInputBindingDescription, sizeof...(Bindings)> result = {};
+	uint32_t binding = 0;
+	((result[binding] = { binding, static_cast<uint32_t>(sizeof(typename Bindings::VertexType)), Bindings::input_rate }, ++binding), ...);
+	return result;
+}
+
+template<typename... Bindings>
+constexpr std::array<VkVertexInputAttributeDescription, VERTEX_INPUT_LOCATIONS<Bindings...>> MakeVertexAttributes() {
+	std::array<VkVertexInputAttributeDescription, VERTEX_INPUT_LOCATIONS<Bindings...>> result = {};
+	uint32_t binding = 0;
+	uint32_t location = 0;
+	(AppendVertexAttributes<typename Bindings::VertexType>(result, binding++, location), ...);
+	return result;
+}
+
+//Binding and attribute descriptions for a set of vertex buffers, all built at compile time.
+//Bindings are numbered in order from 0, locations continue across bindings in member order
+template<typename... Bindings>
+struct VertexInput {
+	static_assert(sizeof...(Bindings) > 0, "Use an empty VertexInputLayout for pipelines without vertex buffers");
+	static_assert((ValidateVertexLayout<typename Bindings::VertexType>() && ...));
+	static_assert(VERTEX_INPUT_LOCATIONS<Bindings...> <= MAX_VERTEX_LOCATIONS, "More vertex locations than every device supports");
+
+	static constexpr std::array<VkVertexInputBindingDescription, sizeof...(Bindings)> bindings = MakeVertexBindings<Bindings...>();
+	static constexpr std::array<VkVertexInputAttributeDescription, VERTEX_INPUT_LOCATIONS<Bindings...>> attributes = MakeVertexAttributes<Bindings...>();
+
+	static VertexInputLayout Layout() {
+		return { bindings.data(), static_cast<uint32_t>(bindings.size()), attributes.data(), static_cast<uint32_t>(attributes.size()) };
+	}
+};
@@ -1,3 +1,4 @@
+#include <iomanip>
 #include <iostream>
 #include "VulkanRenderer.h"
 
@@ -34,29 +35,120 @@ void DestroyDebugUtilsMessengerEXT(VkInstance instance,
 }
 
 VulkanRenderer::~VulkanRenderer() {
-	glfwDestroyWindow(window);
-	glfwTerminate();
+	if (window) {
+		glfwDestroyWindow(window);
+		glfwTerminate();
+	}
 }
 
-int VulkanRenderer::Init(const std::string& name, const int width, const int height) {
-	glfwInit();
+int VulkanRenderer::Init(const std::string& name, const int width, const int height,
+	const RendererOptions& renderer_options) {
+	ScopedTimer init_timer("Init");
+	options = renderer_options;
+	//Checked before the graph runs, the staging ring and descriptor pools are sized by it as well
+	if (options.frames_in_flight == 0) {
+		std::cout << "ERROR: At least one frame in flight is required" << std::endl;
+		return EXIT_FAILURE;
+	}
+	if (options.bench_frames != 0) {
+		options.max_frames = BENCH_WARMUP_FRAMES + options.bench_frames;
+	}
 
-	//Set GLFW to not work with opengl
-	glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-	glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
+	//Idle workers sleep, so they cost nothing while recording stays on one thread
+	jobs.Start();
+	record_threads = options.record_threads != 0 ? options.record_threads : jobs.GetWorkerCount() + 1;
 
-	window = glfwCreateWindow(width, height, name.c_str(), nullptr, nullptr);
+	if (options.headless) {
+		//No window to ask for a size, offscreen targets use the requested one
+		swapchain_extent.width = static_cast<uint32_t>(width);
+		swapchain_extent.height = static_cast<uint32_t>(height);
+	}
+	else {
+		//Must happen on the main thread before any other GLFW call, it's cheap so it stays outside the graph
+		ScopedTimer glfw_timer("glfwInit", "window");
+		glfwInit();
+	}
 
 	try {
-		CreateInstance();
-		SetupDebugMessenger();
-		CreateSurface();
-		GetPhysicalDevice();
-		CreateLogicalDevice();
-		CreateSwapChain();
-		CreateGraphicsPipiline();
+		//Stages only wait for what they read, so window creation, instance creation, loader queries
+		//and shader loading overlap instead of running back to back
+		InitGraph init_graph;
+		using TaskId = InitGraph::TaskId;
+
+		TaskId layers = init_graph.Add("CheckValidationLayers", [this] {
+			if (enable_validation_layers && !CheckValidationLayerSupport()) {
+				throw std::runtime_error("Validation layers requested, but not available");
+			}
+		});
+		TaskId extensions = init_graph.Add("CheckInstanceExtensions", [this] {
+			instance_extensions = GetRequiredInstanceExtensions();
+			if (!CheckInstanceExtensionSupport(instance_extensions)) {
+				throw std::runtime_error("VKInstance does not support required extensions");
+			}
+		});
+		TaskId shaders = init_graph.Add("LoadShaderCode", [this] { LoadShaderCode(); });
+		TaskId instance = init_graph.Add("CreateInstance", [this] { CreateInstance(); }, { layers, extensions });
+		TaskId debug = init_graph.Add("SetupDebugMessenger", [this] { SetupDebugMessenger(); }, { instance });
+
+		//Device selection needs the surface to check presentation support
+		TaskId device_selection_ready = debug;
+		if (!options.headless) {
+			TaskId window_created = init_graph.Add("CreateWindow", [this, &name, width, height] {
+				CreateAppWindow(name, width, height);
+			}, {}, true);
+			device_selection_ready = init_graph.Add("CreateSurface", [this] { CreateSurface(); }, { debug, window_created });
+		}
+
+		TaskId physical_device = init_graph.Add("GetPhysicalDevice", [this] { GetPhysicalDevice(); }, { device_selection_ready });
+		TaskId logical_device = init_graph.Add("CreateLogicalDevice", [this] { CreateLogicalDevice(); }, { physical_device });
+
+		TaskId staging_ring = init_graph.Add("CreateStagingRing", [this] {
+			staging.Init(devices.physical_device, devices.logical_device, allocator, queue_families.transfer_family.value(),
+				transfer_queue, queue_families.graphics_family.value(), options.frames_in_flight);
+		}, { logical_device });
+		TaskId descriptors = init_graph.Add("CreateDescriptorAllocators", [this] {
+			frame_descriptors.Init(devices.logical_device, options.frames_in_flight);
+			descriptor_cache.Init(devices.logical_device);
+		}, { logical_device });
+		//Meshes register their bounds with it, the scene pipelines need its layout
+		TaskId culling = init_graph.Add("CreateGpuCulling", [this] {
+			if (gpu_driven) {
+				gpu_culling.Init(devices.logical_device, allocator, descriptor_cache, frame_descriptors, options.frames_in_flight,
+					options.verify_culling);
+			}
+		}, { descriptors });
+		//Materials register their texture and table with it, the scene pipeline layout needs its set layout
+		TaskId bindless_created = init_graph.Add("CreateBindlessDescriptors", [this] {
+			if (bindless) {
+				bindless_descriptors.Init(devices.physical_device, devices.logical_device, options.frames_in_flight);
+			}
+		}, { logical_device });
+		init_graph.Add("CreateMeshes", [this] { CreateMeshes(); }, { staging_ring, culling, bindless_created });
+		TaskId cache = init_graph.Add("CreatePipelineCache", [this] {
+			warm_pipeline_cache = pipeline_cache.Create(devices.physical_device, devices.logical_device, options.pipeline_cache_path);
+			pipeline_builder.Start(devices.logical_device, pipeline_cache.GetHandle());
+		}, { logical_device });
+
+		//The swapchain extent comes from glfwGetFramebufferSize, which is main thread only
+		TaskId targets = options.headless
+			? init_graph.Add("CreateOffscreenTargets", [this] { CreateOffscreenTargets(); }, { logical_device })
+			: init_graph.Add("CreateSwapChain", [this] { CreateSwapChain(); }, { logical_device }, true);
+
+		TaskId render_pass_created = init_graph.Add("CreateRenderPass", [this] { CreateRenderPass(); }, { targets });
+		init_graph.Add("CreateGraphicsPipelines", [this] {
+			BenchClock::time_point pipeline_start = BenchClock::now();
+			CreateGraphicsPipiline();
+			std::cout << "Graphics pipelines created in " << ElapsedMs(pipeline_start) << " ms ("
+				<< (warm_pipeline_cache ? "warm" : "cold") << " pipeline cache)" << std::endl;
+		}, { render_pass_created, cache, shaders, culling, bindless_created });
+		init_graph.Add("CreateFramebuffers", [this] { CreateFramebuffers(); }, { render_pass_created });
+		init_graph.Add("CreateFrameResources", [this] { CreateFrameResources(); }, { targets });
+
+		init_graph.Run(options.parallel_init);
+		init_graph.PrintCriticalPath(std::cout);
 	}
-	catch (const std::runtime_error& e) {
+	//Run rethrows whatever a stage threw (bad_alloc for huge meshes, system_error from thread creation, ...)
+	catch (const std::exception& e) {
 		std::cout << "ERROR: " << e.what() << std::endl;
 		return EXIT_FAILURE;
 	}
@@ -65,11 +157,73 @@ int VulkanRenderer::Init(const std::string& name, const int width, const int hei
 }
 
 void VulkanRenderer::Clean() {
+	//Nothing can be destroyed while the GPU may still be using it
+	vkDeviceWaitIdle(devices.logical_device);
+
+	for (auto& frame : frames) {
+		vkDestroySemaphore(devices.logical_device, frame.render_finished, nullptr);
+		vkDestroySemaphore(devices.logical_device, frame.ownership_acquired, nullptr);
+		vkDestroySemaphore(devices.logical_device, frame.image_available, nullptr);
+		vkDestroyFence(devices.logical_device, frame.in_flight, nullptr);
+		vkDestroyCommandPool(devices.logical_device, frame.command_pool, nullptr);	//Frees its command buffer too
+		for (VkCommandPool pool : frame.slice_command_pools) {
+			vkDestroyCommandPool(devices.logical_device, pool, nullptr);
+		}
+	}
+	vkDestroyCommandPool(devices.logical_device, present_command_pool, nullptr);
+
+	for (auto framebuffer : swapchain_framebuffers) {
+		vkDestroyFramebuffer(devices.logical_device, framebuffer, nullptr);
+	}
+
+	pipeline_builder.Stop();
+	jobs.Stop();
+	vkDestroyPipeline(devices.logical_device, graphics_pipeline, nullptr);
+	vkDestroyPipelineLayout(devices.logical_device, pipeline_layout, nullptr);
+
+	//Keep compiled pipelines for the next launch
+	pipeline_cache.Save();
+	pipeline_cache.Destroy();
+	vkDestroyRenderPass(devices.logical_device, render_pass, nullptr);
+
 	for (auto image : swapchain_images) {
 		vkDestroyImageView(devices.logical_device, image.image_view, nullptr);
+		if (options.headless) {
+			vkDestroyImage(devices.logical_device, image.image, nullptr);
+		}
+	}
+	for (auto& memory : offscreen_memory) {
+		allocator.Free(memory);
+	}
+	if (gpu_driven) {
+		gpu_culling.PrintStats(std::cout);
+		gpu_culling.Destroy();
+	}
+	if (bindless) {
+		vkDestroyImageView(devices.logical_device, checker_view, nullptr);
+		vkDestroyImage(devices.logical_device, checker_image, nullptr);
+		allocator.Free(checker_memory);
+		vkDestroyBuffer(devices.logical_device, material_buffer, nullptr);
+		allocator.Free(material_memory);
+		bindless_descriptors.PrintStats(std::cout);
+		bindless_descriptors.Destroy();
 	}
+	frame_descriptors.PrintStats(std::cout);
+	frame_descriptors.Destroy();
+	descriptor_cache.PrintStats(std::cout);
+	descriptor_cache.Destroy();
+	for (auto& batch : instance_batches) {
+		batch.DestroyBuffer();
+	}
+	for (auto& mesh : meshes) {
+		mesh.DestroyBuffers();
+	}
+	staging.PrintStats(std::cout);
+	staging.Destroy();
+	allocator.PrintStats(std::cout);
+	allocator.Destroy();
 
-	vkDestroySwapchainKHR(devices.logical_device, swapchain, nullptr);
+	vkDestroySwapchainKHR(devices.logical_device, swapchain, nullptr);		//Null handles (headless) are ignored
 	vkDestroySurfaceKHR(vk_instance, surface, nullptr);
 	if (enable_validation_layers) {
 		DestroyDebugUtilsMessengerEXT(vk_instance, debug_messenger, nullptr);
@@ -79,15 +233,28 @@ void VulkanRenderer::Clean() {
 }
 
 void VulkanRenderer::Update() {
-	while (!glfwWindowShouldClose(window)) {
-		glfwPollEvents();
+	try {
+		while (ShouldRun()) {
+			Draw();
+		}
+	}
+	catch (const std::runtime_error& e) {
+		std::cout << "ERROR: " << e.what() << std::endl;
+	}
+
+	//Let the frames still in flight finish before anything gets destroyed
+	vkDeviceWaitIdle(devices.logical_device);
+
+	if (options.bench_frames != 0) {
+		ReportBenchmark();
+	}
+	if (options.record_bench_frames != 0) {
+		ReportRecordingScaling();
 	}
 }
 
 void VulkanRenderer::CreateInstance() {
-	if (enable_validation_layers && !CheckValidationLayerSupport()) {
-		throw std::runtime_error("Validation layers requested, but not available");
-	}
+	ScopedTimer timer("CreateInstance");
 
 	//Application info - not vulkan instance
 	VkApplicationInfo app_info = {};
@@ -103,23 +270,9 @@ void VulkanRenderer::CreateInstance() {
 	instance_info.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
 	instance_info.pApplicationInfo = &app_info;
 
-	//Set up extensions that'll used by the instance
-	uint32_t glfw_extension_count = 0;
-	const char** glfw_extensions = glfwGetRequiredInstanceExtensions(&glfw_extension_count);
-
-	//Check "Instance extensions" supported
-	std::vector<const char*> extensions(glfw_extensions, glfw_extensions + glfw_extension_count);
-
-	if (enable_validation_layers) {
-		extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
-	}
-
-	if (!CheckInstanceExtensionSupport(extensions)) {
-		throw std::runtime_error("VKInstance does not support required extensions");
-	}
-
-	instance_info.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
-	instance_info.ppEnabledExtensionNames = extensions.data();
+	//Extensions were gathered and checked by GetRequiredInstanceExtensions / CheckInstanceExtensionSupport
+	instance_info.enabledExtensionCount = static_cast<uint32_t>(instance_extensions.size());
+	instance_info.ppEnabledExtensionNames = instance_extensions.data();
 
 	VkDebugUtilsMessengerCreateInfoEXT debug_create_info;
 	if (enable_validation_layers) {
@@ -136,12 +289,36 @@ void VulkanRenderer::CreateInstance() {
 	
 
 	//Create instance
-	if (vkCreateInstance(&instance_info, nullptr, &vk_instance) != VK_SUCCESS)
+	VkResult result;
+	{
+		ScopedTimer vk_timer("vkCreateInstance", "vulkan");
+		result = vkCreateInstance(&instance_info, nullptr, &vk_instance);
+	}
+	if (result != VK_SUCCESS)
 		throw std::runtime_error("Failed to create a vulkan instance");
 }
 
+std::vector<const char*> VulkanRenderer::GetRequiredInstanceExtensions() {
+	//Set up extensions that'll used by the instance (offscreen rendering doesn't need any surface extension)
+	std::vector<const char*> extensions;
+	if (!options.headless) {
+		//Only needs glfwInit, may be called from any thread
+		uint32_t glfw_extension_count = 0;
+		const char** glfw_extensions = glfwGetRequiredInstanceExtensions(&glfw_extension_count);
+		extensions.assign(glfw_extensions, glfw_extensions + glfw_extension_count);
+	}
+
+	if (enable_validation_layers) {
+		extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
+	}
+
+	return extensions;
+}
+
 bool VulkanRenderer::CheckInstanceExtensionSupport(const std::vector<const char*>& check_extensions)
 {
+	ScopedTimer timer("CheckInstanceExtensionSupport");
+
 	//Get the numner of extensions first - the size of the list is unknown at this point (third parameter)
 	uint32_t extension_count = 0;
 	vkEnumerateInstanceExtensionProperties(nullptr, &extension_count, nullptr);
@@ -169,6 +346,8 @@ bool VulkanRenderer::CheckInstanceExtensionSupport(const std::vector<const char*
 
 bool VulkanRenderer::CheckValidationLayerSupport()
 {
+	ScopedTimer timer("CheckValidationLayerSupport");
+
 	uint32_t layer_count;
 	vkEnumerateInstanceLayerProperties(&layer_count, nullptr);
 
@@ -192,6 +371,8 @@ bool VulkanRenderer::CheckValidationLayerSupport()
 }
 
 void VulkanRenderer::SetupDebugMessenger() {
+	ScopedTimer timer("SetupDebugMessenger");
+
 	if (!enable_validation_layers) return;
 	VkDebugUtilsMessengerCreateInfoEXT create_info = {};
 
@@ -219,9 +400,15 @@ void VulkanRenderer::PopulateDebugMessengerCreateInfo(VkDebugUtilsMessengerCreat
 }
 
 void VulkanRenderer::GetPhysicalDevice() {
+	ScopedTimer timer("GetPhysicalDevice");
+
 	//Enumerate physical devices that vk instance can access
+	//First enumeration is where the loader initialises the drivers
 	uint32_t device_count = 0;
-	vkEnumeratePhysicalDevices(vk_instance, &device_count, nullptr);
+	{
+		ScopedTimer vk_timer("vkEnumeratePhysicalDevices", "vulkan");
+		vkEnumeratePhysicalDevices(vk_instance, &device_count, nullptr);
+	}
 
 	if (device_count == 0)
 		throw std::runtime_error("Can't find GPUs that support Vulkan instance");
@@ -230,36 +417,67 @@ void VulkanRenderer::GetPhysicalDevice() {
 	std::vector<VkPhysicalDevice> device_list(device_count);
 	vkEnumeratePhysicalDevices(vk_instance, &device_count, device_list.data());
 
+	//Score every device, the first suitable one is often an integrated or software device
+	std::vector<DeviceCandidate> candidates;
 	for (auto& device : device_list) {
-		if (CheckDeviceSuitable(device)) {
-			devices.physical_device = device;
-			break;
-		}
+		DeviceCandidate candidate = DescribeDevice(device);
+		candidate.suitable = CheckDeviceSuitable(device);
+		candidate.unified_graphics_present = HasGraphicsPresentFamily(device);
+		candidates.push_back(candidate);
 	}
-}
 
-bool VulkanRenderer::CheckDeviceSuitable(VkPhysicalDevice device)
-{
-	/*
-	
-	//Information about the device itself (id, name, type, vendor, ...)
-	
-	VkPhysicalDeviceProperties device_properties;
-	vkGetPhysicalDeviceProperties(device, &device_properties);
+	const DeviceCandidate* chosen = nullptr;
+	long long chosen_score = 0;
+	std::string reason;
+
+	for (const auto& candidate : candidates) {
+		DeviceScore score = ScoreDevice(candidate);
+		std::cout << "GPU " << candidate.properties.deviceName << " [" << FormatUuid(candidate.device_uuid) << "]: ";
+		if (!candidate.suitable) {
+			std::cout << "not suitable" << std::endl;
+			continue;
+		}
 
+		std::cout << "score " << score.total << " (";
+		for (size_t i = 0; i < score.reasons.size(); ++i) {
+			std::cout << (i == 0 ? "" : ", ") << score.reasons[i];
+		}
+		std::cout << ")" << std::endl;
 
-	//Information about what the device can do (geometry shader, tess shader, ...)
+		if (!options.gpu_override.empty()) {
+			if (chosen == nullptr && MatchesDeviceOverride(candidate, options.gpu_override)) {
+				chosen = &candidate;
+				chosen_score = score.total;
+				reason = "matches override \"" + options.gpu_override + "\"";
+			}
+		}
+		else if (chosen == nullptr || score.total > chosen_score) {
+			chosen = &candidate;
+			chosen_score = score.total;
+			reason = "highest score";
+		}
+	}
 
-	VkPhysicalDeviceFeatures device_features;
-	vkGetPhysicalDeviceFeatures(device, &device_features);
+	if (chosen == nullptr) {
+		if (!options.gpu_override.empty()) {
+			throw std::runtime_error("No suitable GPU matches \"" + options.gpu_override + "\"");
+		}
+		throw std::runtime_error("Can't find a suitable GPU");
+	}
 
-	*/
+	devices.physical_device = chosen->device;
+	std::cout << "Using GPU " << chosen->properties.deviceName << " (" << reason << ", score " << chosen_score << ")" << std::endl;
+}
 
+bool VulkanRenderer::CheckDeviceSuitable(VkPhysicalDevice device)
+{
+	//Properties and features only rank suitable devices, see DescribeDevice / ScoreDevice
 	bool extension_support = CheckDeviceExtensionSupport(device);
 	bool queue_families_complete = GetQueueFamilies(device).IsComplete();
 
-	bool swapchain_valid = false;
-	if (extension_support) {
+	//Offscreen targets don't depend on any surface support
+	bool swapchain_valid = options.headless;
+	if (extension_support && !options.headless) {
 		SwapChainDetails swapchain_details = GetSwapChainDetails(device);
 		swapchain_valid = !swapchain_details.formats.empty() && !swapchain_details.presentation_modes.empty();
 	}
@@ -267,6 +485,29 @@ bool VulkanRenderer::CheckDeviceSuitable(VkPhysicalDevice device)
 	return queue_families_complete && extension_support && swapchain_valid;
 }
 
+bool VulkanRenderer::HasGraphicsPresentFamily(VkPhysicalDevice device)
+{
+	uint32_t queue_family_count = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(device, &queue_family_count, nullptr);
+
+	std::vector<VkQueueFamilyProperties> queue_family_list(queue_family_count);
+	vkGetPhysicalDeviceQueueFamilyProperties(device, &queue_family_count, queue_family_list.data());
+
+	for (uint32_t i = 0; i < queue_family_count; ++i) {
+		if (queue_family_list[i].queueCount == 0 || !(queue_family_list[i].queueFlags & VK_QUEUE_GRAPHICS_BIT))
+			continue;
+
+		VkBool32 presentation_support = options.headless;
+		if (!options.headless) {
+			vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentation_support);
+		}
+		if (presentation_support)
+			return true;
+	}
+
+	return false;
+}
+
 QueueFamilyIndices VulkanRenderer::GetQueueFamilies(VkPhysicalDevice device)
 {
 	QueueFamilyIndices indices;
@@ -279,43 +520,105 @@ QueueFamilyIndices VulkanRenderer::GetQueueFamilies(VkPhysicalDevice device)
 	vkGetPhysicalDeviceQueueFamilyProperties(device, &queue_family_count, queue_family_list.data());
 
 	//Go through each queue family and check if it has at least 1 of the required types of queue
+	std::optional<uint32_t> transfer_only_family;
+	bool unified_family = false;
 	int i = 0;
 	for (auto& queue_family : queue_family_list) {
-		if (queue_family.queueCount > 0 && queue_family.queueFlags & VK_QUEUE_GRAPHICS_BIT)
-			indices.graphics_family = i;
+		bool graphics_support = queue_family.queueCount > 0 && queue_family.queueFlags & VK_QUEUE_GRAPHICS_BIT;
 
-		//Check if queue family supports presentation
+		//Check if queue family supports presentation (nothing is presented in headless mode, graphics stands in for it)
 		VkBool32 presentation_support = false;
-		vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentation_support);
-		if (queue_family.queueCount > 0 && presentation_support) {
+		if (options.headless) {
+			presentation_support = graphics_support;
+		}
+		else if (queue_family.queueCount > 0) {
+			vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentation_support);
+		}
+
+		//One family that does both wins over any pair - the swapchain images then never change owner
+		if (graphics_support && presentation_support && !unified_family) {
+			indices.graphics_family = i;
 			indices.presentation_family = i;
+			unified_family = true;
+		}
+		else if (!unified_family) {
+			if (graphics_support && !indices.graphics_family.has_value())
+				indices.graphics_family = i;
+			if (presentation_support && !indices.presentation_family.has_value())
+				indices.presentation_family = i;
 		}
 
-		if (indices.IsComplete())
-			break;
+		//Transfer-only families are usually DMA engines, a compute family without graphics is the next best thing
+		bool graphics = queue_family.queueFlags & VK_QUEUE_GRAPHICS_BIT;
+		bool compute = queue_family.queueFlags & VK_QUEUE_COMPUTE_BIT;
+		if (queue_family.queueCount > 0 && !graphics) {
+			if (compute && !indices.compute_family.has_value()) {
+				indices.compute_family = i;
+			}
+			if (!compute && (queue_family.queueFlags & VK_QUEUE_TRANSFER_BIT) && !transfer_only_family.has_value()) {
+				transfer_only_family = i;
+			}
+		}
 
 		++i;
 	}
 
+	//Graphics and compute families can always transfer, even if they don't report the bit
+	if (transfer_only_family.has_value()) {
+		indices.transfer_family = transfer_only_family;
+	}
+	else if (indices.compute_family.has_value()) {
+		indices.transfer_family = indices.compute_family;
+	}
+	else {
+		indices.transfer_family = indices.graphics_family;
+	}
+
+	if (!indices.compute_family.has_value()) {
+		indices.compute_family = indices.graphics_family;
+	}
+
 	return indices;
 }
 
 void VulkanRenderer::CreateLogicalDevice()
 {
+	ScopedTimer timer("CreateLogicalDevice");
+
 	//Get the queue family indices for the chosen physical device
-	QueueFamilyIndices indices = GetQueueFamilies(devices.physical_device);
+	queue_families = GetQueueFamilies(devices.physical_device);
+	QueueFamilyIndices& indices = queue_families;
+
+	uint32_t queue_family_count = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(devices.physical_device, &queue_family_count, nullptr);
+	std::vector<VkQueueFamilyProperties> queue_family_list(queue_family_count);
+	vkGetPhysicalDeviceQueueFamilyProperties(devices.physical_device, &queue_family_count, queue_family_list.data());
+
+	//Graphics and presentation share a queue when they share a family. Compute and transfer get their own queue when
+	//the family has one to spare, otherwise they share the last queue of it
+	std::map<uint32_t, uint32_t> queues_per_family;
+	auto assign_queue = [&](uint32_t family, bool own_queue) {
+		uint32_t& count = queues_per_family[family];
+		if (count == 0 || (own_queue && count < queue_family_list[family].queueCount)) {
+			++count;
+		}
+		return count - 1;
+	};
+	uint32_t graphics_queue_index = assign_queue(indices.graphics_family.value(), true);
+	uint32_t presentation_queue_index = assign_queue(indices.presentation_family.value(), false);
+	uint32_t compute_queue_index = assign_queue(indices.compute_family.value(), true);
+	uint32_t transfer_queue_index = assign_queue(indices.transfer_family.value(), true);
 
 	std::vector<VkDeviceQueueCreateInfo> queue_create_infos;
-	std::set<uint32_t> unique_queue_families = { indices.graphics_family.value(), indices.presentation_family.value() };
+	std::vector<float> priorities(4, 1.f); // the highest value
 
-	float priority = 1.f; // the highest value
-	for (uint32_t queue_family : unique_queue_families) {
+	for (auto& family : queues_per_family) {
 		//Queue informations for creating logical device
 		VkDeviceQueueCreateInfo queue_create_info = {};
 		queue_create_info.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-		queue_create_info.queueFamilyIndex = queue_family;
-		queue_create_info.queueCount = 1;
-		queue_create_info.pQueuePriorities = &priority;
+		queue_create_info.queueFamilyIndex = family.first;
+		queue_create_info.queueCount = family.second;
+		queue_create_info.pQueuePriorities = priorities.data();
 		queue_create_infos.push_back(queue_create_info);
 	}
 
@@ -324,8 +627,9 @@ void VulkanRenderer::CreateLogicalDevice()
 	device_info.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
 	device_info.queueCreateInfoCount = static_cast<uint32_t>(queue_create_infos.size());
 	device_info.pQueueCreateInfos = queue_create_infos.data();
-	device_info.enabledExtensionCount = static_cast<uint32_t>(device_extensions.size());
-	device_info.ppEnabledExtensionNames = device_extensions.data();
+	std::vector<const char*> extensions = GetRequiredDeviceExtensions();
+	device_info.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+	device_info.ppEnabledExtensionNames = extensions.data();
 
 	if (enable_validation_layers) {
 		device_info.enabledLayerCount = static_cast<uint32_t>(required_validation_layers.size());
@@ -338,26 +642,95 @@ void VulkanRenderer::CreateLogicalDevice()
 
 	//Physical device features that the logical device will be using
 	VkPhysicalDeviceFeatures device_features = {};
+	VkPhysicalDeviceVulkan12Features vulkan12_features = {};
+	vulkan12_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+
+	//GPU-driven drawing falls back to one instanced draw per batch when the device can't do it
+	gpu_driven = options.gpu_driven && GpuCulling::IsSupported(devices.physical_device, indices.graphics_family.value());
+	if (gpu_driven) {
+		GpuCulling::EnableFeatures(device_features, vulkan12_features);
+	}
+	else if (options.gpu_driven) {
+		std::cout << "GPU-driven drawing needs drawIndirectCount, multiDrawIndirect and drawIndirectFirstInstance, "
+			"using CPU draws" << std::endl;
+	}
+
+	//Bindless falls back to plain vertex colours (shader.frag, no descriptor sets)
+	bindless = options.bindless && BindlessDescriptors::IsSupported(devices.physical_device);
+	if (bindless) {
+		BindlessDescriptors::EnableFeatures(device_features, vulkan12_features);
+	}
+	else if (options.bindless) {
+		std::cout << "Bindless resources need descriptor indexing (runtime descriptor arrays, partially bound and "
+			"update-after-bind sampled images and storage buffers), drawing without materials" << std::endl;
+	}
+
+	if (gpu_driven || bindless) {
+		device_info.pNext = &vulkan12_features;
+	}
 
 	device_info.pEnabledFeatures = &device_features;
 
-	VkResult result = vkCreateDevice(devices.physical_device, &device_info, nullptr, &devices.logical_device);
+	VkResult result;
+	{
+		ScopedTimer vk_timer("vkCreateDevice", "vulkan");
+		result = vkCreateDevice(devices.physical_device, &device_info, nullptr, &devices.logical_device);
+	}
 	if (result != VK_SUCCESS)
 		throw std::runtime_error("Failed to create a logical device");
 
 	//Queues are created ar the same time as the device - get the handle of that
-	vkGetDeviceQueue(devices.logical_device, indices.graphics_family.value(), 0, &graphics_queue);
-	vkGetDeviceQueue(devices.logical_device, indices.presentation_family.value(), 0, &presentation_queue);
+	vkGetDeviceQueue(devices.logical_device, indices.graphics_family.value(), graphics_queue_index, &graphics_queue);
+	vkGetDeviceQueue(devices.logical_device, indices.presentation_family.value(), presentation_queue_index, &presentation_queue);
+	vkGetDeviceQueue(devices.logical_device, indices.compute_family.value(), compute_queue_index, &compute_queue);
+	vkGetDeviceQueue(devices.logical_device, indices.transfer_family.value(), transfer_queue_index, &transfer_queue);
+
+	allocator.Init(devices.physical_device, devices.logical_device);
+
+	std::cout << "Queues: graphics family " << indices.graphics_family.value()
+		<< ", compute family " << indices.compute_family.value() << (indices.HasDedicatedCompute() ? " (dedicated)" : " (shared with graphics)")
+		<< ", transfer family " << indices.transfer_family.value() << (indices.HasDedicatedTransfer() ? " (dedicated)" : " (shared with graphics)")
+		<< std::endl;
+}
+
+void VulkanRenderer::CreateAppWindow(const std::string& name, const int width, const int height) {
+	ScopedTimer timer("CreateWindow", "window");
+
+	//Set GLFW to not work with opengl
+	glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+	glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
+
+	window = glfwCreateWindow(width, height, name.c_str(), nullptr, nullptr);
+	if (window == nullptr) {
+		throw std::runtime_error("Failed to create a window");
+	}
 }
 
 void VulkanRenderer::CreateSurface() {
+	ScopedTimer timer("CreateSurface");
+
 	if (glfwCreateWindowSurface(vk_instance, window, nullptr, &surface) != VK_SUCCESS) {
 		throw std::runtime_error("Failed to create a surface");
 	}
 }
 
+std::vector<const char*> VulkanRenderer::GetRequiredDeviceExtensions()
+{
+	//Swapchain extension is only needed when presenting to a window
+	if (options.headless) {
+		return {};
+	}
+
+	return device_extensions;
+}
+
 bool VulkanRenderer::CheckDeviceExtensionSupport(VkPhysicalDevice device)
 {
+	std::vector<const char*> required_extensions = GetRequiredDeviceExtensions();
+	if (required_extensions.empty()) {
+		return true;
+	}
+
 	uint32_t extension_count = 0;
 	vkEnumerateDeviceExtensionProperties(device, nullptr, &extension_count, nullptr);
 
@@ -368,7 +741,7 @@ bool VulkanRenderer::CheckDeviceExtensionSupport(VkPhysicalDevice device)
 	std::vector<VkExtensionProperties> extensions(extension_count);
 	vkEnumerateDeviceExtensionProperties(device, nullptr, &extension_count, extensions.data());
 
-	for (const auto& device_extension : device_extensions) {
+	for (const auto& device_extension : required_extensions) {
 		bool has_extension = false;
 		for (const auto& extension : extensions) {
 			if (strcmp(device_extension, extension.extensionName) == 0) {
@@ -414,6 +787,8 @@ SwapChainDetails VulkanRenderer::GetSwapChainDetails(VkPhysicalDevice device)
 }
 
 void VulkanRenderer::CreateSwapChain() {
+	ScopedTimer timer("CreateSwapChain");
+
 	SwapChainDetails swapchain_details = GetSwapChainDetails(devices.physical_device);
 
 	//Find optimal surface values for our swap chain
@@ -445,30 +820,21 @@ void VulkanRenderer::CreateSwapChain() {
 	swapchain_create_info.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
 	swapchain_create_info.clipped = VK_TRUE;
 
-	QueueFamilyIndices indices = GetQueueFamilies(devices.physical_device);
-	//If graphics & presentation families are different then swapchain must let image be shared between families
-	if (indices.graphics_family != indices.presentation_family) {
-		uint32_t queueFamilyIndices[] = {
-			indices.graphics_family.value(),
-			indices.presentation_family.value()
-		};
-		swapchain_create_info.imageSharingMode = VK_SHARING_MODE_CONCURRENT;
-		swapchain_create_info.queueFamilyIndexCount = 2;
-		swapchain_create_info.pQueueFamilyIndices = queueFamilyIndices;
-	}
-	else {
-		swapchain_create_info.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
-
-		//no need to do specify these but just for clarity
-		swapchain_create_info.queueFamilyIndexCount = 0;
-		swapchain_create_info.pQueueFamilyIndices = nullptr;
-	}
+	//Exclusive even when graphics and presentation families differ: concurrent sharing can disable compression
+	//on some GPUs, so images are handed over with explicit ownership transfers instead (see RecordCommands / Draw)
+	swapchain_create_info.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	swapchain_create_info.queueFamilyIndexCount = 0;
+	swapchain_create_info.pQueueFamilyIndices = nullptr;
 
 	//If old swapchain has been destroyed and this one replaces it, then link old one to quickly hand over responsibilities
 	swapchain_create_info.oldSwapchain = VK_NULL_HANDLE;
 
 	//Create Swapchain
-	VkResult result = vkCreateSwapchainKHR(devices.logical_device, &swapchain_create_info, nullptr, &swapchain);
+	VkResult result;
+	{
+		ScopedTimer vk_timer("vkCreateSwapchainKHR", "vulkan");
+		result = vkCreateSwapchainKHR(devices.logical_device, &swapchain_create_info, nullptr, &swapchain);
+	}
 	if (result != VK_SUCCESS) {
 		throw std::runtime_error("Failed to create swapchain");
 	}
@@ -551,7 +917,7 @@ VkExtent2D VulkanRenderer::ChooseSwapExtent(const VkSurfaceCapabilitiesKHR& surf
 
 VkImageView VulkanRenderer::CreateImageView(VkImage image, VkFormat format, VkImageAspectFlags aspect_flags)
 {
-	VkImageViewCreateInfo view_create_info;
+	VkImageViewCreateInfo view_create_info = {};
 	view_create_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
 	view_create_info.image = image;
 	view_create_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
@@ -578,106 +944,982 @@ VkImageView VulkanRenderer::CreateImageView(VkImage image, VkFormat format, VkIm
 	return image_view;
 }
 
+void VulkanRenderer::CreateOffscreenTargets() {
+	ScopedTimer timer("CreateOffscreenTargets");
+
+	//Headless mode renders into plain images instead of swapchain images. Each frame slot gets its own
+	//image, so there is never a reason to wait for a target other than the slot's own fence
+	swapchain_image_format = VK_FORMAT_R8G8B8A8_UNORM;
+
+	VkImageCreateInfo image_create_info = {};
+	image_create_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	image_create_info.imageType = VK_IMAGE_TYPE_2D;
+	image_create_info.format = swapchain_image_format;
+	image_create_info.extent = { swapchain_extent.width, swapchain_extent.height, 1 };
+	image_create_info.mipLevels = 1;
+	image_create_info.arrayLayers = 1;
+	image_create_info.samples = VK_SAMPLE_COUNT_1_BIT;
+	image_create_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+	image_create_info.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;	//Transfer src so results can be read back
+	image_create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	image_create_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+	for (uint32_t i = 0; i < options.frames_in_flight; ++i) {
+		SwapchainImage target = {};
+		if (vkCreateImage(devices.logical_device, &image_create_info, nullptr, &target.image) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create an offscreen image");
+		}
+
+		try {
+			offscreen_memory.push_back(allocator.AllocateForImage(target.image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT));
+		}
+		catch (...) {
+			vkDestroyImage(devices.logical_device, target.image, nullptr);
+			throw;
+		}
+
+		target.image_view = CreateImageView(target.image, swapchain_image_format, VK_IMAGE_ASPECT_COLOR_BIT);
+		swapchain_images.push_back(target);
+	}
+}
+
+void VulkanRenderer::CreateRenderPass() {
+	ScopedTimer timer("CreateRenderPass");
+
+	//Colour attachment of render pass
+	VkAttachmentDescription colour_attachment = {};
+	colour_attachment.format = swapchain_image_format;								//Format to use for attachment
+	colour_attachment.samples = VK_SAMPLE_COUNT_1_BIT;								//Number of samples to write for multisampling
+	colour_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;							//What to do with attachment before rendering
+	colour_attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;						//What to do with attachment after rendering
+	colour_attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+	colour_attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	colour_attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;					//Image layout before render pass starts (contents are cleared anyway)
+	colour_attachment.finalLayout = options.headless ?								//Image layout to convert to after render pass
+		VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+	//Attachment reference uses an attachment index that refers to index in the attachment list passed to render pass create info
+	VkAttachmentReference colour_attachment_reference = {};
+	colour_attachment_reference.attachment = 0;
+	colour_attachment_reference.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+	//Information about a particular subpass the render pass is using
+	VkSubpassDescription subpass = {};
+	subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;					//Pipeline type subpass is to be bound to
+	subpass.colorAttachmentCount = 1;
+	subpass.pColorAttachments = &colour_attachment_reference;
+
+	//The image is only available once the acquire semaphore (waited at COLOR_ATTACHMENT_OUTPUT) signals,
+	//so the layout transition at the start of the render pass must wait for that stage too
+	VkSubpassDependency dependency = {};
+	dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+	dependency.dstSubpass = 0;
+	dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+	dependency.srcAccessMask = 0;
+	dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+	dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+
+	//Create info for render pass
+	VkRenderPassCreateInfo render_pass_create_info = {};
+	render_pass_create_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+	render_pass_create_info.attachmentCount = 1;
+	render_pass_create_info.pAttachments = &colour_attachment;
+	render_pass_create_info.subpassCount = 1;
+	render_pass_create_info.pSubpasses = &subpass;
+	render_pass_create_info.dependencyCount = 1;
+	render_pass_create_info.pDependencies = &dependency;
+
+	VkResult result = vkCreateRenderPass(devices.logical_device, &render_pass_create_info, nullptr, &render_pass);
+	if (result != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create a render pass");
+	}
+}
+
 void VulkanRenderer::CreateGraphicsPipiline() {
-	auto vertex_shader_code = ReadFile("Shaders/vert.spv");
-	auto fragment_shader_code = ReadFile("Shaders/frag.spv");
+	ScopedTimer timer("CreateGraphicsPipiline");
 
 	//Build shader modules to link to graphics pipeline
-	VkShaderModule vertex_shader_module = CreateShaderModule(vertex_shader_code);
-	VkShaderModule fragment_shader_module = CreateShaderModule(fragment_shader_code);
-
-	//Shader stage creation information
-	//Vertex stage creation information
-	VkPipelineShaderStageCreateInfo vertex_shader_create_info;
-	vertex_shader_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-	vertex_shader_create_info.stage = VK_SHADER_STAGE_VERTEX_BIT;				//Shader stage name
-	vertex_shader_create_info.module = vertex_shader_module;					//shader module to be used by stage
-	vertex_shader_create_info.pName = "main";									//Entry point in to shader
-
-	//Fragment stage creation information
-	VkPipelineShaderStageCreateInfo fragment_shader_create_info;
-	fragment_shader_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-	fragment_shader_create_info.stage = VK_SHADER_STAGE_FRAGMENT_BIT;				//Shader stage name
-	fragment_shader_create_info.module = fragment_shader_module;					//shader module to be used by stage
-	fragment_shader_create_info.pName = "main";										//Entry point in to shader
-
-	VkPipelineShaderStageCreateInfo shader_stages[] = { vertex_shader_create_info, fragment_shader_create_info };
-
-	//Create pipeline
-	// -- Vertex input -- 
-	VkPipelineVertexInputStateCreateInfo vertex_input_create_info;
-	vertex_input_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-	vertex_input_create_info.vertexBindingDescriptionCount = 0;
-	vertex_input_create_info.pVertexBindingDescriptions = nullptr;
-	vertex_input_create_info.vertexAttributeDescriptionCount = 0;
-	vertex_input_create_info.pVertexAttributeDescriptions = nullptr;
-
-	// -- Input Assembly -- 
-	VkPipelineInputAssemblyStateCreateInfo input_assembly;
-	input_assembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-	input_assembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;					// like GL_TRIANGLE / GL_LINE / ...
-	input_assembly.primitiveRestartEnable = VK_FALSE;								// Allow overriding of "strip" topology to start new primitives
-
-	// -- Viewport & Scissor --
-	//Create a viewport info struct
-	VkViewport viewport;
-	viewport.x = 0.f;																//X start coordinate
-	viewport.y = 0.f;																//Y start coordinate
-	viewport.width = (float)swapchain_extent.width;									//Width of viewport
-	viewport.height = (float)swapchain_extent.height;								//Height of viewport
-	viewport.minDepth = 0.f;														//Min framebuffer depth
-	viewport.maxDepth = 1.f;														//Max framebuffer depth
-
-	//Create a scissor info struct
-	VkRect2D scissor;
-	scissor.offset = { 0, 0 };														//Offset to use region from
-	scissor.extent = swapchain_extent;												//Extent to decribe region to use, starting at offset
-
-	VkPipelineViewportStateCreateInfo viewport_state_create_info;
-	viewport_state_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-	viewport_state_create_info.viewportCount = 1;
-	viewport_state_create_info.pViewports = &viewport;
-	viewport_state_create_info.scissorCount = 1;
-	viewport_state_create_info.pScissors = &scissor;
-
-	//// -- Dynamic State --
-	////Dynamic states to enable
-	//std::vector<VkDynamicState> dynamic_state_enables;
-	//dynamic_state_enables.push_back(VK_DYNAMIC_STATE_VIEWPORT); // dynamic viewport : can resize in command buffer with vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
-	//dynamic_state_enables.push_back(VK_DYNAMIC_STATE_SCISSOR);	// dynamic scissors : can resize in command buffer with vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
-
-	////Dynamic state creation info
-	//VkPipelineDynamicStateCreateInfo dynamic_state_create_info;
-	//dynamic_state_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-	//dynamic_state_create_info.dynamicStateCount = static_cast<uint32_t>(dynamic_state_enables.size());
-	//dynamic_state_create_info.pDynamicStates = dynamic_state_enables.data();
-
-	// -- Rasterizer -- 
-	VkPipelineRasterizationStateCreateInfo rasterization_create_info;
-	rasterization_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-	rasterization_create_info.depthClampEnable = VK_FALSE;							//Change if fragment beyond near / far plane are clipped (default) or clamped to plane -> NEED GPU FEATURE
-	rasterization_create_info.rasterizerDiscardEnable = VK_FALSE;					//Whether to discard data and skip rasterization - only suitable for pipeline without framebuffer output
-	rasterization_create_info.polygonMode = VK_POLYGON_MODE_FILL;					//Wireframe mode / ... -> NEED GPU FEATURE
-	rasterization_create_info.lineWidth = 1.f;										//Thickness of line
-	rasterization_create_info.cullMode = VK_CULL_MODE_BACK_BIT;						//Which face of a triangle to cull
-	rasterization_create_info.frontFace = VK_FRONT_FACE_CLOCKWISE;					//Winding to determine which side is front
+	VkShaderModule vertex_shader_module = LoadShaderModule(VertexShaderName());
+	VkShaderModule fragment_shader_module = LoadShaderModule(bindless ? "bindless_frag" : "frag");
+	VkShaderModule cull_shader_module = gpu_driven ? LoadShaderModule("cull_comp") : VK_NULL_HANDLE;
+
+	// -- Pipeline layout --
+	VkPipelineLayoutCreateInfo pipeline_layout_create_info = {};
+	pipeline_layout_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	//Position decode of the mesh being drawn (see Mesh::Draw), only read by shader_quantized.vert
+	VkPushConstantRange push_constant_ranges[2] = {};
+	push_constant_ranges[0].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+	push_constant_ranges[0].offset = 0;
+	push_constant_ranges[0].size = sizeof(PositionDecode);
+
+	//Bindless: set 0 holds every resource, the fragment stage gets the draw's material indices after the position decode
+	static_assert(MaterialPush::OFFSET == sizeof(PositionDecode), "bindless.frag expects the material right after PositionDecode");
+	push_constant_ranges[1].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+	push_constant_ranges[1].offset = MaterialPush::OFFSET;
+	push_constant_ranges[1].size = sizeof(MaterialPush);
+	VkDescriptorSetLayout bindless_set_layout = bindless ? bindless_descriptors.GetSetLayout() : VK_NULL_HANDLE;
+
+	pipeline_layout_create_info.setLayoutCount = bindless ? 1 : 0;
+	pipeline_layout_create_info.pSetLayouts = bindless ? &bindless_set_layout : nullptr;
+	pipeline_layout_create_info.pushConstantRangeCount = bindless ? 2 : 1;
+	pipeline_layout_create_info.pPushConstantRanges = push_constant_ranges;
+
+	VkResult result = vkCreatePipelineLayout(devices.logical_device, &pipeline_layout_create_info, nullptr, &pipeline_layout);
+	if (result != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create a pipeline layout");
+	}
+
+	//Fixed function state is filled in by the builder, only what differs per pipeline is described here
+	GraphicsPipelineDesc pipeline_desc;
+	pipeline_desc.vertex_shader = vertex_shader_module;
+	pipeline_desc.fragment_shader = fragment_shader_module;
+	pipeline_desc.extent = swapchain_extent;
+	pipeline_desc.layout = pipeline_layout;
+	pipeline_desc.render_pass = render_pass;
+
+	switch (options.vertex_encoding) {
+	case VertexEncoding::FULL:
+		pipeline_desc.vertex_input = SceneVertexInput<Vertex>::Layout();
+		break;
+	case VertexEncoding::UNORM16:
+		pipeline_desc.vertex_input = SceneVertexInput<QuantizedVertexUnorm16>::Layout();
+		break;
+	case VertexEncoding::HALF:
+		pipeline_desc.vertex_input = SceneVertexInput<QuantizedVertexHalf>::Layout();
+		break;
+	}
+
+	//Every pipeline is queued before waiting on any, so they compile in parallel on the worker threads
+	std::future<VkPipeline> pipeline_future = pipeline_builder.Submit(pipeline_desc);
+	std::future<VkPipeline> cull_pipeline_future;
+	if (gpu_driven) {
+		ComputePipelineDesc cull_desc;
+		cull_desc.shader = cull_shader_module;
+		cull_desc.layout = gpu_culling.GetPipelineLayout();
+		cull_pipeline_future = pipeline_builder.Submit(cull_desc);
+	}
+
+	try {
+		graphics_pipeline = pipeline_future.get();
+		if (gpu_driven) {
+			gpu_culling.SetPipeline(cull_pipeline_future.get());
+		}
+	}
+	catch (...) {
+		//The culling pipeline may still be compiling from its module
+		if (cull_pipeline_future.valid()) {
+			cull_pipeline_future.wait();
+		}
+		vkDestroyShaderModule(devices.logical_device, vertex_shader_module, nullptr);
+		vkDestroyShaderModule(devices.logical_device, fragment_shader_module, nullptr);
+		vkDestroyShaderModule(devices.logical_device, cull_shader_module, nullptr);
+		throw;
+	}
 
 	//Destroy shader modules, no longer needed after pipeline created
 	vkDestroyShaderModule(devices.logical_device, vertex_shader_module, nullptr);
 	vkDestroyShaderModule(devices.logical_device, fragment_shader_module, nullptr);
+	vkDestroyShaderModule(devices.logical_device, cull_shader_module, nullptr);
+	shader_code.clear();
+	shader_files.clear();
+}
+
+const char* VulkanRenderer::VertexShaderName() const {
+	return options.vertex_encoding == VertexEncoding::FULL ? "vert" : "quantized_vert";
+}
+
+void VulkanRenderer::LoadShaderCode() {
+	ScopedTimer timer("LoadShaderCode");
+
+	//Runs before the device exists, so the culling and bindless shaders are loaded whenever they were asked for
+	std::vector<const char*> names = { VertexShaderName(), "frag" };
+	if (options.gpu_driven) {
+		names.push_back("cull_comp");
+	}
+	if (options.bindless) {
+		names.push_back("bindless_frag");
+	}
+
+	for (const char* name : names) {
+		if (!options.shader_directory.empty()) {
+			//Development override - mapped read-only, the words go to the driver without a heap copy
+			MappedSpirvFile shader_file(options.shader_directory + "/" + name + ".spv");
+			shader_code[name] = shader_file.GetCode();
+			shader_files.push_back(std::move(shader_file));		//Moving keeps the mapping (and the view) valid
+			continue;
+		}
+
+		const EmbeddedShader* shader = FindEmbeddedShader(name);
+		if (shader == nullptr) {
+			throw std::runtime_error(std::string("No embedded shader named ") + name);
+		}
+		shader_code[name] = shader->code;
+	}
+}
+
+VkShaderModule VulkanRenderer::LoadShaderModule(const std::string& name) {
+	ScopedTimer timer("LoadShaderModule " + name);
+
+	auto code = shader_code.find(name);
+	if (code == shader_code.end()) {
+		throw std::runtime_error("Shader " + name + " was not loaded");
+	}
+
+	return CreateShaderModule(code->second);
 }
 
-VkShaderModule VulkanRenderer::CreateShaderModule(const std::vector<char>& code) {
-	VkShaderModuleCreateInfo shader_module_create_info;
+VkShaderModule VulkanRenderer::CreateShaderModule(const SpirvView& code) {
+	if (!IsValidSpirv(code.words, code.size)) {
+		throw std::runtime_error("Shader code is not valid SPIR-V");
+	}
+
+	VkShaderModuleCreateInfo shader_module_create_info = {};
 	shader_module_create_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-	shader_module_create_info.codeSize = code.size();
-	shader_module_create_info.pCode = reinterpret_cast<const uint32_t*>(code.data());
+	shader_module_create_info.codeSize = code.size;						//Size in bytes
+	shader_module_create_info.pCode = code.words;						//Already 4-byte aligned
 
 	VkShaderModule shader_module;
-	VkResult result = vkCreateShaderModule(devices.logical_device, &shader_module_create_info, nullptr, &shader_module);
+	VkResult result;
+	{
+		ScopedTimer vk_timer("vkCreateShaderModule", "vulkan");
+		result = vkCreateShaderModule(devices.logical_device, &shader_module_create_info, nullptr, &shader_module);
+	}
 	if (result != VK_SUCCESS) {
 		throw std::runtime_error("Failed to create shader module");
 	}
 
 	return shader_module;
 }
+
+void VulkanRenderer::CreateFramebuffers() {
+	ScopedTimer timer("CreateFramebuffers");
+
+	//One framebuffer per swapchain image
+	swapchain_framebuffers.resize(swapchain_images.size());
+
+	for (size_t i = 0; i < swapchain_framebuffers.size(); ++i) {
+		VkImageView attachments[] = {
+			swapchain_images[i].image_view
+		};
+
+		VkFramebufferCreateInfo framebuffer_create_info = {};
+		framebuffer_create_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+		framebuffer_create_info.renderPass = render_pass;								//Render pass layout the framebuffer will be used with
+		framebuffer_create_info.attachmentCount = 1;
+		framebuffer_create_info.pAttachments = attachments;								//List of attachments (1:1 with render pass)
+		framebuffer_create_info.width = swapchain_extent.width;
+		framebuffer_create_info.height = swapchain_extent.height;
+		framebuffer_create_info.layers = 1;
+
+		VkResult result = vkCreateFramebuffer(devices.logical_device, &framebuffer_create_info, nullptr, &swapchain_framebuffers[i]);
+		if (result != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create a framebuffer");
+		}
+	}
+}
+
+void VulkanRenderer::CreateMeshes() {
+	if (bindless) {
+		CreateMaterials();
+	}
+
+	std::vector<Vertex> vertices;
+	std::vector<uint32_t> indices;
+	GenerateTriangleGrid(options.triangle_count, vertices, indices);
+
+	std::vector<InstanceData> instances;
+	GenerateInstanceGrid(options.instance_count, instances, options.instance_spread);
+
+	//Only queued here, the first frame submits the uploads and waits on them
+	AddInstanceBatch(AddMesh(vertices, indices), instances);
+	std::cout << "Scene: " << indices.size() / 3 << " triangles, " << vertices.size() << " vertices, " << instances.size()
+		<< " instances (" << static_cast<uint64_t>(indices.size() / 3) * instances.size() << " triangles per frame)" << std::endl;
+}
+
+void VulkanRenderer::CreateMaterials() {
+	//Procedural until there is texture loading
+	const uint32_t CHECKER_SIZE = 64;
+	const uint32_t CHECKER_SQUARE = 8;
+	std::vector<uint32_t> texels(CHECKER_SIZE * CHECKER_SIZE);
+	for (uint32_t y = 0; y < CHECKER_SIZE; ++y) {
+		for (uint32_t x = 0; x < CHECKER_SIZE; ++x) {
+			bool light = (x / CHECKER_SQUARE + y / CHECKER_SQUARE) % 2 == 0;
+			texels[y * CHECKER_SIZE + x] = light ? 0xFFFFFFFF : 0xFF606060;		//RGBA8, alpha in the top byte
+		}
+	}
+
+	VkImageCreateInfo image_create_info = {};
+	image_create_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	image_create_info.imageType = VK_IMAGE_TYPE_2D;
+	image_create_info.format = VK_FORMAT_R8G8B8A8_UNORM;
+	image_create_info.extent = { CHECKER_SIZE, CHECKER_SIZE, 1 };
+	image_create_info.mipLevels = 1;
+	image_create_info.arrayLayers = 1;
+	image_create_info.samples = VK_SAMPLE_COUNT_1_BIT;
+	image_create_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+	image_create_info.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;	//Filled by the staging ring
+	image_create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	image_create_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	if (vkCreateImage(devices.logical_device, &image_create_info, nullptr, &checker_image) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create the checker texture");
+	}
+	try {
+		checker_memory = allocator.AllocateForImage(checker_image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	}
+	catch (...) {
+		vkDestroyImage(devices.logical_device, checker_image, nullptr);
+		throw;
+	}
+	checker_view = CreateImageView(checker_image, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_ASPECT_COLOR_BIT);
+	staging.UploadImage(checker_image, image_create_info.extent, sizeof(uint32_t), texels.data());
+
+	//The descriptor can be written before the upload lands, nothing reads it until the first frame waits on the ring
+	uint32_t checker_slot = bindless_descriptors.AddImage(checker_view);
+
+	materials.resize(2);
+	materials[MATERIAL_CHECKER].base_colour = glm::vec4(1.0f);
+	materials[MATERIAL_CHECKER].texture = checker_slot;
+	materials[MATERIAL_PLAIN].base_colour = glm::vec4(1.0f);
+
+	VkDeviceSize table_size = sizeof(GpuMaterial) * materials.size();
+	material_buffer = CreateDeviceLocalBuffer(devices.logical_device, allocator, table_size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, material_memory);
+	staging.UploadBuffer(material_buffer, 0, materials.data(), table_size, VK_ACCESS_SHADER_READ_BIT);
+	material_buffer_slot = bindless_descriptors.AddBuffer(material_buffer);
+}
+
+uint32_t VulkanRenderer::AddMesh(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices) {
+	float position_error = 0.0f;
+	auto add_quantized = [&](auto position_type) {
+		using QuantizedType = QuantizedVertex<decltype(position_type)>;
+		std::vector<QuantizedType> quantized;
+		BenchClock::time_point quantize_start = BenchClock::now();
+		PositionDecode decode = QuantizeVertices(vertices, quantized);
+		double quantize_ms = ElapsedMs(quantize_start);
+
+		QuantizationReport report = MeasureQuantizationError(vertices, quantized, decode);
+		report.quantize_ms = quantize_ms;
+		PrintQuantizationReport(std::cout, "mesh " + std::to_string(meshes.size()), report);
+		position_error = report.max_position_error;
+		meshes.emplace_back(devices.logical_device, allocator, staging, quantized, indices, decode);
+	};
+
+	switch (options.vertex_encoding) {
+	case VertexEncoding::FULL:
+		meshes.emplace_back(devices.logical_device, allocator, staging, vertices, indices);
+		break;
+	case VertexEncoding::UNORM16:
+		add_quantized(glm::u16vec4());
+		break;
+	case VertexEncoding::HALF:
+		add_quantized(PackedHalf4());
+		break;
+	}
+
+	//Bounds cover the decoded positions the GPU actually draws
+	if (gpu_driven) {
+		gpu_culling.AddMesh(meshes.back().GetIndexCount(), ComputeBoundingSphere(vertices, position_error));
+	}
+
+	return static_cast<uint32_t>(meshes.size() - 1);
+}
+
+uint32_t VulkanRenderer::AddInstanceBatch(uint32_t mesh, const std::vector<InstanceData>& instances, uint32_t material) {
+	if (mesh >= meshes.size()) {
+		throw std::runtime_error("Instance batch refers to a mesh that does not exist");
+	}
+	if (bindless && material >= materials.size()) {
+		throw std::runtime_error("Instance batch refers to a material that does not exist");
+	}
+
+	if (gpu_driven) {
+		return gpu_culling.AddObjects(mesh, instances);
+	}
+
+	instance_batches.emplace_back(devices.logical_device, allocator, staging, mesh, instances);
+	uint32_t batch = static_cast<uint32_t>(instance_batches.size() - 1);
+
+	//Even split, the first draws take one more instance when it doesn't divide
+	uint32_t instance_count = static_cast<uint32_t>(instances.size());
+	uint32_t draw_count = std::max(1u, std::min(options.draws_per_batch, instance_count));
+	uint32_t first_instance = 0;
+	for (uint32_t i = 0; i < draw_count; ++i) {
+		uint32_t draw_instances = instance_count / draw_count + (i < instance_count % draw_count ? 1 : 0);
+		draw_list.push_back({ batch, first_instance, draw_instances, material });
+		first_instance += draw_instances;
+	}
+	return batch;
+}
+
+void VulkanRenderer::CreateFrameResources() {
+	ScopedTimer timer("CreateFrameResources");
+
+	const QueueFamilyIndices& indices = queue_families;
+
+	//Each frame slot gets its own pool so it can be reset wholesale while other slots are still executing.
+	//Buffers are re-recorded every frame, so hint the driver that they are short lived
+	VkCommandPoolCreateInfo pool_create_info = {};
+	pool_create_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	pool_create_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+	pool_create_info.queueFamilyIndex = indices.graphics_family.value();
+
+	VkSemaphoreCreateInfo semaphore_create_info = {};
+	semaphore_create_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+	//Start signalled so the first wait on every slot returns immediately
+	VkFenceCreateInfo fence_create_info = {};
+	fence_create_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+	fence_create_info.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+
+	//Command pools are externally synchronised, so every thread recording a slice of the draw list needs its own.
+	//Enough for every thread count --record-bench tries, none when recording stays on one thread
+	uint32_t slice_count = std::max(record_threads, options.record_bench_frames != 0 ? jobs.GetWorkerCount() + 1 : 1);
+	if (slice_count < 2) {
+		slice_count = 0;
+	}
+
+	frames.resize(options.frames_in_flight);
+	for (auto& frame : frames) {
+		if (vkCreateCommandPool(devices.logical_device, &pool_create_info, nullptr, &frame.command_pool) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create a command pool");
+		}
+
+		VkCommandBufferAllocateInfo allocate_info = {};
+		allocate_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocate_info.commandPool = frame.command_pool;
+		allocate_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;						//Submitted directly to queue
+		allocate_info.commandBufferCount = 1;
+
+		if (vkAllocateCommandBuffers(devices.logical_device, &allocate_info, &frame.command_buffer) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to allocate a command buffer");
+		}
+
+		frame.slice_command_pools.resize(slice_count);
+		frame.slice_command_buffers.resize(slice_count);
+		for (uint32_t i = 0; i < slice_count; ++i) {
+			if (vkCreateCommandPool(devices.logical_device, &pool_create_info, nullptr, &frame.slice_command_pools[i]) != VK_SUCCESS) {
+				throw std::runtime_error("Failed to create a command pool");
+			}
+
+			VkCommandBufferAllocateInfo slice_allocate_info = {};
+			slice_allocate_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+			slice_allocate_info.commandPool = frame.slice_command_pools[i];
+			slice_allocate_info.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;			//Executed inside the primary's render pass
+			slice_allocate_info.commandBufferCount = 1;
+
+			if (vkAllocateCommandBuffers(devices.logical_device, &slice_allocate_info, &frame.slice_command_buffers[i]) != VK_SUCCESS) {
+				throw std::runtime_error("Failed to allocate a command buffer");
+			}
+		}
+
+		if (vkCreateSemaphore(devices.logical_device, &semaphore_create_info, nullptr, &frame.image_available) != VK_SUCCESS ||
+			vkCreateSemaphore(devices.logical_device, &semaphore_create_info, nullptr, &frame.render_finished) != VK_SUCCESS ||
+			vkCreateFence(devices.logical_device, &fence_create_info, nullptr, &frame.in_flight) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create frame synchronisation objects");
+		}
+
+		if (SeparatePresentFamily() &&
+			vkCreateSemaphore(devices.logical_device, &semaphore_create_info, nullptr, &frame.ownership_acquired) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create frame synchronisation objects");
+		}
+	}
+
+	images_in_flight.assign(swapchain_images.size(), VK_NULL_HANDLE);
+
+	if (SeparatePresentFamily()) {
+		CreateOwnershipTransferCommands();
+	}
+}
+
+void VulkanRenderer::CreateOwnershipTransferCommands() {
+	ScopedTimer timer("CreateOwnershipTransferCommands");
+
+	//The acquire half of the transfer never changes, so one buffer per swapchain image is recorded up front
+	VkCommandPoolCreateInfo pool_create_info = {};
+	pool_create_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	pool_create_info.queueFamilyIndex = queue_families.presentation_family.value();
+
+	if (vkCreateCommandPool(devices.logical_device, &pool_create_info, nullptr, &present_command_pool) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create a command pool");
+	}
+
+	VkCommandBufferAllocateInfo allocate_info = {};
+	allocate_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	allocate_info.commandPool = present_command_pool;
+	allocate_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	allocate_info.commandBufferCount = static_cast<uint32_t>(swapchain_images.size());
+
+	present_acquire_commands.resize(swapchain_images.size());
+	if (vkAllocateCommandBuffers(devices.logical_device, &allocate_info, present_acquire_commands.data()) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to allocate a command buffer");
+	}
+
+	for (size_t i = 0; i < swapchain_images.size(); ++i) {
+		VkCommandBufferBeginInfo begin_info = {};
+		begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+
+		if (vkBeginCommandBuffer(present_acquire_commands[i], &begin_info) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to start recording a command buffer");
+		}
+
+		//Must match the release barrier recorded on the graphics queue
+		VkImageMemoryBarrier acquire_barrier = OwnershipTransferBarrier(swapchain_images[i].image);
+		acquire_barrier.srcAccessMask = 0;
+		acquire_barrier.dstAccessMask = 0;			//Presentation needs no access mask, the semaphore makes it visible
+		vkCmdPipelineBarrier(present_acquire_commands[i], VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+			0, 0, nullptr, 0, nullptr, 1, &acquire_barrier);
+
+		if (vkEndCommandBuffer(present_acquire_commands[i]) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to stop recording a command buffer");
+		}
+	}
+}
+
+VkImageMemoryBarrier VulkanRenderer::OwnershipTransferBarrier(VkImage image) {
+	//Layout stays the same, the render pass already left the image ready to present
+	VkImageMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+	barrier.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+	barrier.srcQueueFamilyIndex = queue_families.graphics_family.value();
+	barrier.dstQueueFamilyIndex = queue_families.presentation_family.value();
+	barrier.image = image;
+	barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	barrier.subresourceRange.baseMipLevel = 0;
+	barrier.subresourceRange.levelCount = 1;
+	barrier.subresourceRange.baseArrayLayer = 0;
+	barrier.subresourceRange.layerCount = 1;
+
+	return barrier;
+}
+
+bool VulkanRenderer::SeparatePresentFamily() const {
+	return !options.headless && queue_families.graphics_family != queue_families.presentation_family;
+}
+
+void VulkanRenderer::RecordCommands(VkCommandBuffer command_buffer, uint32_t image_index) {
+	VkCommandBufferBeginInfo begin_info = {};
+	begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;				//Re-recorded after every submission
+
+	VkClearValue clear_values[] = {
+		{ 0.6f, 0.65f, 0.4f, 1.f }
+	};
+
+	VkRenderPassBeginInfo render_pass_begin_info = {};
+	render_pass_begin_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+	render_pass_begin_info.renderPass = render_pass;
+	render_pass_begin_info.framebuffer = swapchain_framebuffers[image_index];
+	render_pass_begin_info.renderArea.offset = { 0, 0 };							//Start point of render pass in pixels
+	render_pass_begin_info.renderArea.extent = swapchain_extent;					//Size of region to run render pass on
+	render_pass_begin_info.clearValueCount = 1;
+	render_pass_begin_info.pClearValues = clear_values;
+
+	if (vkBeginCommandBuffer(command_buffer, &begin_info) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to start recording a command buffer");
+	}
+
+	//Workers start on the draw list right away, the primary's commands up to the render pass are recorded meanwhile
+	uint32_t slice_count = GetRecordingSlices();
+	std::vector<VkResult> slice_results(slice_count, VK_SUCCESS);
+	JobCounter slices_recorded;
+	if (slice_count > 1) {
+		QueueSliceRecording(slice_count, image_index, slices_recorded, slice_results);
+	}
+
+	//The slice jobs write into slice_results and slices_recorded, so they must finish before this frame unwinds
+	try {
+		//Take over whatever the transfer queue uploaded for this frame
+		staging.RecordAcquireBarriers(command_buffer);
+
+		//There is no camera yet, meshes are placed straight in clip space
+		if (gpu_driven) {
+			gpu_culling.RecordCulling(command_buffer, current_frame, glm::mat4(1.0f));
+		}
+	}
+	catch (...) {
+		jobs.Wait(slices_recorded);
+		throw;
+	}
+
+	if (slice_count > 1) {
+		jobs.Wait(slices_recorded);
+		for (VkResult slice_result : slice_results) {
+			if (slice_result != VK_SUCCESS) {
+				throw std::runtime_error("Failed to record a secondary command buffer");
+			}
+		}
+
+		//A subpass with secondary contents can't have inline commands, everything is in the slices
+		vkCmdBeginRenderPass(command_buffer, &render_pass_begin_info, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+		vkCmdExecuteCommands(command_buffer, slice_count, frames[current_frame].slice_command_buffers.data());
+	}
+	else {
+		vkCmdBeginRenderPass(command_buffer, &render_pass_begin_info, VK_SUBPASS_CONTENTS_INLINE);
+		RecordDrawRange(command_buffer, 0, draw_list.size());
+		if (gpu_driven) {
+			if (bindless) {
+				PushMaterial(command_buffer, MATERIAL_CHECKER);
+			}
+			gpu_culling.RecordDraws(command_buffer, current_frame, meshes, pipeline_layout);
+		}
+	}
+	vkCmdEndRenderPass(command_buffer);
+
+	//Release half of the hand-over to the presentation family. Nothing goes back the other way:
+	//the render pass discards the old contents (UNDEFINED initial layout), so there is nothing to preserve
+	if (SeparatePresentFamily()) {
+		VkImageMemoryBarrier release_barrier = OwnershipTransferBarrier(swapchain_images[image_index].image);
+		release_barrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		release_barrier.dstAccessMask = 0;
+		vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+			0, 0, nullptr, 0, nullptr, 1, &release_barrier);
+	}
+
+	if (vkEndCommandBuffer(command_buffer) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to stop recording a command buffer");
+	}
+}
+
+uint32_t VulkanRenderer::GetRecordingSlices() const {
+	//Below this many draws a slice costs more to hand out than it saves
+	const size_t MIN_DRAWS_PER_SLICE = 256;
+
+	size_t slice_count = std::min<size_t>(record_threads, draw_list.size() / MIN_DRAWS_PER_SLICE);
+	slice_count = std::min(slice_count, frames[current_frame].slice_command_buffers.size());
+	return static_cast<uint32_t>(std::max<size_t>(slice_count, 1));
+}
+
+void VulkanRenderer::QueueSliceRecording(uint32_t slice_count, uint32_t image_index, JobCounter& recorded,
+	std::vector<VkResult>& results) {
+	FrameData& frame = frames[current_frame];
+	size_t slice_size = (draw_list.size() + slice_count - 1) / slice_count;
+
+	for (uint32_t slice = 0; slice < slice_count; ++slice) {
+		jobs.Run([this, &frame, &results, slice, slice_size, image_index]() {
+			//The slice's pool is only touched by this job, and the frame slot's fence says the GPU is done with it
+			VkCommandBuffer command_buffer = frame.slice_command_buffers[slice];
+			vkResetCommandPool(devices.logical_device, frame.slice_command_pools[slice], 0);
+
+			//Secondary buffers inherit the render pass but no state, each one binds its own pipeline
+			VkCommandBufferInheritanceInfo inheritance_info = {};
+			inheritance_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+			inheritance_info.renderPass = render_pass;
+			inheritance_info.subpass = 0;
+			inheritance_info.framebuffer = swapchain_framebuffers[image_index];
+
+			VkCommandBufferBeginInfo begin_info = {};
+			begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+			begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+			begin_info.pInheritanceInfo = &inheritance_info;
+
+			results[slice] = vkBeginCommandBuffer(command_buffer, &begin_info);
+			if (results[slice] != VK_SUCCESS) {
+				return;		//Jobs must not throw, RecordCommands reports it
+			}
+
+			size_t first = std::min(draw_list.size(), slice * slice_size);
+			RecordDrawRange(command_buffer, first, std::min(draw_list.size(), first + slice_size));
+			results[slice] = vkEndCommandBuffer(command_buffer);
+		}, &recorded);
+	}
+}
+
+void VulkanRenderer::RecordDrawRange(VkCommandBuffer command_buffer, size_t first, size_t end) const {
+	vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphics_pipeline);
+	if (bindless) {
+		//The only set any draw uses, draws just push which material they read from it
+		bindless_descriptors.Bind(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout);
+	}
+
+	//Draws of a batch are next to each other, its buffers are bound once for all of them
+	uint32_t bound_batch = UINT32_MAX;
+	uint32_t pushed_material = UINT32_MAX;
+	for (size_t i = first; i < end; ++i) {
+		const BatchDraw& draw = draw_list[i];
+		const InstanceBatch& batch = instance_batches[draw.batch];
+		const Mesh& mesh = meshes[batch.GetMeshIndex()];
+		if (draw.batch != bound_batch) {
+			mesh.Bind(command_buffer, pipeline_layout, batch.GetInstanceBuffer());
+			bound_batch = draw.batch;
+		}
+		if (bindless && draw.material != pushed_material) {
+			PushMaterial(command_buffer, draw.material);
+			pushed_material = draw.material;
+		}
+		vkCmdDrawIndexed(command_buffer, mesh.GetIndexCount(), draw.instance_count, 0, 0, draw.first_instance);
+	}
+}
+
+void VulkanRenderer::PushMaterial(VkCommandBuffer command_buffer, uint32_t material) const {
+	MaterialPush push = { material_buffer_slot, material };
+	vkCmdPushConstants(command_buffer, pipeline_layout, VK_SHADER_STAGE_FRAGMENT_BIT, MaterialPush::OFFSET, sizeof(MaterialPush), &push);
+}
+
+void VulkanRenderer::SubmitFrameUploads() {
+	staging.BeginFrame(current_frame);
+
+	if (gpu_driven) {
+		//The slot's fence has been waited on, so its culling results can be checked
+		gpu_culling.VerifyFrame(current_frame);
+		if (gpu_culling.NeedsUpload()) {
+			//Other frame slots may still be culling or drawing from the old scene buffers
+			vkDeviceWaitIdle(devices.logical_device);
+			gpu_culling.Upload(staging);
+		}
+	}
+
+	staging.Submit();
+}
+
+bool VulkanRenderer::ShouldRun() {
+	if (options.max_frames != 0 && frame_count >= options.max_frames) {
+		return false;
+	}
+
+	if (options.headless) {
+		return true;
+	}
+
+	glfwPollEvents();
+	return !glfwWindowShouldClose(window);
+}
+
+void VulkanRenderer::Draw() {
+	//Warm-up frames are not timed
+	bool timed = options.bench_frames != 0 && frame_count >= BENCH_WARMUP_FRAMES;
+	if (options.bench_frames != 0 && frame_count == BENCH_WARMUP_FRAMES) {
+		benchmark.Begin(options.bench_frames);
+	}
+
+	BenchClock::time_point frame_start = BenchClock::now();
+	FrameData& frame = frames[current_frame];
+
+	//Only wait for the last submission that used this slot - the other slots keep the GPU busy
+	//while this frame is being recorded
+	vkWaitForFences(devices.logical_device, 1, &frame.in_flight, VK_TRUE, std::numeric_limits<uint64_t>::max());
+	BenchClock::time_point stage_start = BenchClock::now();
+	if (timed) benchmark.Record(Benchmark::FENCE_WAIT, ElapsedMs(frame_start, stage_start));
+
+	if (options.headless) {
+		//Every slot owns its offscreen image, so nothing to acquire and nothing to present
+		vkResetFences(devices.logical_device, 1, &frame.in_flight);
+		vkResetCommandPool(devices.logical_device, frame.command_pool, 0);
+		frame_descriptors.BeginFrame(current_frame);
+		if (bindless) {
+			bindless_descriptors.BeginFrame(current_frame);
+		}
+		SubmitFrameUploads();
+		RecordCommands(frame.command_buffer, current_frame);
+		if (timed) benchmark.Record(Benchmark::RECORD, ElapsedMs(stage_start));
+
+		std::vector<VkSemaphore> wait_semaphores = staging.TakeWaitSemaphores();
+		std::vector<VkPipelineStageFlags> wait_stages(wait_semaphores.size(), staging.GetWaitStages());
+
+		VkSubmitInfo submit_info = {};
+		submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submit_info.waitSemaphoreCount = static_cast<uint32_t>(wait_semaphores.size());
+		submit_info.pWaitSemaphores = wait_semaphores.data();
+		submit_info.pWaitDstStageMask = wait_stages.data();
+		submit_info.commandBufferCount = 1;
+		submit_info.pCommandBuffers = &frame.command_buffer;
+
+		stage_start = BenchClock::now();
+		if (vkQueueSubmit(graphics_queue, 1, &submit_info, frame.in_flight) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to submit a command buffer");
+		}
+		if (timed) {
+			benchmark.Record(Benchmark::SUBMIT, ElapsedMs(stage_start));
+			benchmark.Record(Benchmark::CPU_FRAME, ElapsedMs(frame_start));
+		}
+
+		if (frame_count == 0) {
+			ReportStartup();
+		}
+		++frame_count;
+		current_frame = (current_frame + 1) % static_cast<uint32_t>(frames.size());
+		return;
+	}
+
+	uint32_t image_index;
+	VkResult result = vkAcquireNextImageKHR(devices.logical_device, swapchain, std::numeric_limits<uint64_t>::max(),
+		frame.image_available, VK_NULL_HANDLE, &image_index);
+	if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+		return;		//Window is not resizable, this only happens while it is minimised
+	}
+	if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
+		throw std::runtime_error("Failed to acquire a swapchain image");
+	}
+
+	//Images can come back out of order, so another slot may still be rendering to this one
+	if (images_in_flight[image_index] != VK_NULL_HANDLE) {
+		vkWaitForFences(devices.logical_device, 1, &images_in_flight[image_index], VK_TRUE, std::numeric_limits<uint64_t>::max());
+	}
+	images_in_flight[image_index] = frame.in_flight;
+	if (timed) benchmark.Record(Benchmark::ACQUIRE_WAIT, ElapsedMs(stage_start));
+
+	//GPU is done with this slot, so its pool can be recycled instead of reallocating buffers
+	stage_start = BenchClock::now();
+	vkResetFences(devices.logical_device, 1, &frame.in_flight);
+	vkResetCommandPool(devices.logical_device, frame.command_pool, 0);
+	frame_descriptors.BeginFrame(current_frame);
+	if (bindless) {
+		bindless_descriptors.BeginFrame(current_frame);
+	}
+	SubmitFrameUploads();
+	RecordCommands(frame.command_buffer, image_index);
+	if (timed) benchmark.Record(Benchmark::RECORD, ElapsedMs(stage_start));
+
+	//Uploads of this frame and the acquired image
+	std::vector<VkSemaphore> wait_semaphores = staging.TakeWaitSemaphores();
+	std::vector<VkPipelineStageFlags> wait_stages(wait_semaphores.size(), staging.GetWaitStages());
+	wait_semaphores.push_back(frame.image_available);
+	wait_stages.push_back(VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+
+	VkSubmitInfo submit_info = {};
+	submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submit_info.waitSemaphoreCount = static_cast<uint32_t>(wait_semaphores.size());
+	submit_info.pWaitSemaphores = wait_semaphores.data();
+	submit_info.pWaitDstStageMask = wait_stages.data();							//Stages to check semaphores at
+	submit_info.commandBufferCount = 1;
+	submit_info.pCommandBuffers = &frame.command_buffer;
+	submit_info.signalSemaphoreCount = 1;
+	submit_info.pSignalSemaphores = &frame.render_finished;
+
+	stage_start = BenchClock::now();
+	if (vkQueueSubmit(graphics_queue, 1, &submit_info, frame.in_flight) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to submit a command buffer");
+	}
+
+	//Presentation family takes ownership of the image before presenting it
+	VkSemaphore present_wait = frame.render_finished;
+	if (SeparatePresentFamily()) {
+		VkPipelineStageFlags acquire_wait_stages[] = {
+			VK_PIPELINE_STAGE_ALL_COMMANDS_BIT
+		};
+
+		VkSubmitInfo acquire_submit_info = {};
+		acquire_submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		acquire_submit_info.waitSemaphoreCount = 1;
+		acquire_submit_info.pWaitSemaphores = &frame.render_finished;
+		acquire_submit_info.pWaitDstStageMask = acquire_wait_stages;
+		acquire_submit_info.commandBufferCount = 1;
+		acquire_submit_info.pCommandBuffers = &present_acquire_commands[image_index];
+		acquire_submit_info.signalSemaphoreCount = 1;
+		acquire_submit_info.pSignalSemaphores = &frame.ownership_acquired;
+
+		if (vkQueueSubmit(presentation_queue, 1, &acquire_submit_info, VK_NULL_HANDLE) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to submit a command buffer");
+		}
+		present_wait = frame.ownership_acquired;
+	}
+	if (timed) benchmark.Record(Benchmark::SUBMIT, ElapsedMs(stage_start));
+
+	VkPresentInfoKHR present_info = {};
+	present_info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+	present_info.waitSemaphoreCount = 1;
+	present_info.pWaitSemaphores = &present_wait;
+	present_info.swapchainCount = 1;
+	present_info.pSwapchains = &swapchain;
+	present_info.pImageIndices = &image_index;
+
+	stage_start = BenchClock::now();
+	result = vkQueuePresentKHR(presentation_queue, &present_info);
+	if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR && result != VK_ERROR_OUT_OF_DATE_KHR) {
+		throw std::runtime_error("Failed to present an image");
+	}
+	if (timed) {
+		benchmark.Record(Benchmark::PRESENT_WAIT, ElapsedMs(stage_start));
+		benchmark.Record(Benchmark::CPU_FRAME, ElapsedMs(frame_start));
+	}
+
+	if (frame_count == 0) {
+		ReportStartup();
+	}
+	++frame_count;
+	current_frame = (current_frame + 1) % static_cast<uint32_t>(frames.size());
+}
+
+void VulkanRenderer::ReportBenchmark() {
+	if (!benchmark.HasSamples()) {
+		std::cout << "Benchmark: run ended during warm-up after " << frame_count << " frames, nothing to report" << std::endl;
+		return;
+	}
+
+	//Called after the device went idle, so the total includes GPU time of the last frames
+	benchmark.End();
+
+	VkPhysicalDeviceProperties device_properties;
+	vkGetPhysicalDeviceProperties(devices.physical_device, &device_properties);
+
+	benchmark.PrintReport(std::cout);
+	try {
+		benchmark.WriteJson(options.bench_output, device_properties.deviceName, options.headless, options.frames_in_flight);
+		std::cout << "Benchmark results written to " << options.bench_output << std::endl;
+	}
+	catch (const std::runtime_error& e) {
+		std::cout << "ERROR: " << e.what() << std::endl;
+	}
+}
+
+void VulkanRenderer::ReportRecordingScaling() {
+	//CPU side only: the current frame slot is idle (Update waited for the device), its buffers are recorded
+	//over and over and never submitted
+	std::vector<uint32_t> thread_counts;
+	uint32_t max_threads = jobs.GetWorkerCount() + 1;
+	for (uint32_t threads = 1; threads < max_threads; threads *= 2) {
+		thread_counts.push_back(threads);
+	}
+	thread_counts.push_back(max_threads);
+
+	std::cout << std::fixed << std::setprecision(3) << "Command recording, " << draw_list.size() << " draws, ms per frame over "
+		<< options.record_bench_frames << " frames:" << std::endl
+		<< "  threads  slices      p50     mean  speedup" << std::endl;
+
+	uint32_t configured_threads = record_threads;
+	FrameData& frame = frames[current_frame];
+	double single_thread_ms = 0.0;
+	try {
+		for (uint32_t threads : thread_counts) {
+			record_threads = threads;
+			Benchmark recording;
+			recording.Begin(options.record_bench_frames);
+			for (uint64_t i = 0; i < options.record_bench_frames; ++i) {
+				vkResetCommandPool(devices.logical_device, frame.command_pool, 0);
+				BenchClock::time_point start = BenchClock::now();
+				RecordCommands(frame.command_buffer, 0);
+				recording.Record(Benchmark::RECORD, ElapsedMs(start));
+			}
+
+			TimingSummary summary = recording.Summarise(Benchmark::RECORD);
+			if (threads == 1) {
+				single_thread_ms = summary.p50;
+			}
+			std::cout << std::setw(9) << threads << std::setw(8) << GetRecordingSlices() << std::setw(9) << summary.p50
+				<< std::setw(9) << summary.mean << std::setw(8) << std::setprecision(2) << single_thread_ms / summary.p50 << "x"
+				<< std::setprecision(3) << std::endl;
+		}
+	}
+	catch (const std::runtime_error& e) {
+		std::cout << "ERROR: " << e.what() << std::endl;
+	}
+	record_threads = configured_threads;
+}
+
+void VulkanRenderer::ReportStartup() {
+	//First frame is handed to the GPU, startup ends here
+	StartupProfiler& profiler = StartupProfiler::Get();
+	profiler.MarkFirstFrame();
+	profiler.PrintReport(std::cout);
+
+	if (options.startup_trace_path.empty()) {
+		return;
+	}
+
+	try {
+		profiler.WriteChromeTrace(options.startup_trace_path);
+		std::cout << "Startup trace written to " << options.startup_trace_path << std::endl;
+	}
+	catch (const std::runtime_error& e) {
+		std::cout << "ERROR: " << e.what() << std::endl;
+	}
+}
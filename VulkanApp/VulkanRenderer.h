@@ -7,8 +7,26 @@
 #include <vector>
 #include <set>
 #include <algorithm>
+#include <limits>
+#include <cstring>
+#include <map>
 
 #include "Utilities.h"
+#include "Benchmark.h"
+#include "PipelineCache.h"
+#include "PipelineBuilder.h"
+#include "ShaderFile.h"
+#include "EmbeddedShaders.h"
+#include "StartupProfiler.h"
+#include "InitGraph.h"
+#include "DeviceSelection.h"
+#include "DeviceAllocator.h"
+#include "StagingRing.h"
+#include "Mesh.h"
+#include "GpuCulling.h"
+#include "JobSystem.h"
+#include "DescriptorAllocator.h"
+#include "BindlessDescriptors.h"
 
 class VulkanRenderer
 {
@@ -17,17 +35,37 @@ public:
 	~VulkanRenderer();
 
 	int Init(const std::string& name = "VulkanApp",
-		const int width = 800, const int height = 600);
+		const int width = 800, const int height = 600,
+		const RendererOptions& renderer_options = RendererOptions());
 
 	void Clean();
 
 	void Update();
 
+	//Entries of the material table, only drawn with when bindless
+	static const uint32_t MATERIAL_CHECKER = 0;		//Checkerboard texture
+	static const uint32_t MATERIAL_PLAIN = 1;		//Vertex colour only
+
+	//Scene. Usable once the device exists (Init builds the default scene with them), uploads reach the GPU
+	//with the next frame. Vertices are stored as options.vertex_encoding. With gpu_driven the batch's instances
+	//become individually culled objects (the returned id is then GpuCulling's) and all use MATERIAL_CHECKER
+	uint32_t AddMesh(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices);
+	uint32_t AddInstanceBatch(uint32_t mesh, const std::vector<InstanceData>& instances, uint32_t material = MATERIAL_CHECKER);
+
+	//Queues for work that should overlap graphics, valid after Init. Without a dedicated family they are the graphics
+	//queue and family (see QueueFamilyIndices::HasDedicatedCompute / HasDedicatedTransfer), and resources crossing
+	//families need ownership transfers. The transfer queue is also used by the staging ring during Update, so
+	//submits to it must come from the thread calling Update
+	VkQueue GetComputeQueue() const { return compute_queue; }
+	VkQueue GetTransferQueue() const { return transfer_queue; }
+	const QueueFamilyIndices& GetQueueFamilies() const { return queue_families; }
+
 private:
 	GLFWwindow* window = nullptr;
 
 	//vk components
 	VkInstance vk_instance;
+	std::vector<const char*> instance_extensions;
 	VkDebugUtilsMessengerEXT debug_messenger;
 
 	struct MainDevice {
@@ -35,18 +73,65 @@ private:
 		VkDevice logical_device;
 	} devices;
 
+	QueueFamilyIndices queue_families;
 	VkQueue graphics_queue;
 	VkQueue presentation_queue;
-	VkSurfaceKHR surface;
-	VkSwapchainKHR swapchain;
-	std::vector<SwapchainImage> swapchain_images;
+	VkQueue compute_queue;			//Async compute, same queue as graphics_queue when there is no separate compute family
+	VkQueue transfer_queue;			//Uploads, may be the same handle as another queue - submits to a shared queue must not overlap
+	VkSurfaceKHR surface = VK_NULL_HANDLE;
+	VkSwapchainKHR swapchain = VK_NULL_HANDLE;
+	std::vector<SwapchainImage> swapchain_images;		//Offscreen images owned by the renderer in headless mode
+	DeviceAllocator allocator;
+	StagingRing staging;								//Uploads through transfer_queue
+	FrameDescriptorAllocator frame_descriptors;			//Sets that live for one frame
+	DescriptorSetCache descriptor_cache;				//Long-lived sets, by layout and bound resources
+	std::vector<DeviceAllocation> offscreen_memory;		//Backing memory of the headless images
+	std::vector<Mesh> meshes;
+	std::vector<InstanceBatch> instance_batches;		//What gets drawn
+	std::vector<BatchDraw> draw_list;					//Draws over instance_batches, options.draws_per_batch for each
+	GpuCulling gpu_culling;								//Owns the objects instead of instance_batches when gpu_driven
+	bool gpu_driven = false;							//options.gpu_driven and supported by the device
+	BindlessDescriptors bindless_descriptors;			//Every texture and the material table, when bindless
+	bool bindless = false;								//options.bindless and supported by the device
+	std::vector<GpuMaterial> materials;					//Indexed by material id, uploaded once by CreateMaterials
+	VkBuffer material_buffer = VK_NULL_HANDLE;
+	DeviceAllocation material_memory;
+	uint32_t material_buffer_slot = BindlessDescriptors::INVALID_SLOT;
+	VkImage checker_image = VK_NULL_HANDLE;
+	VkImageView checker_view = VK_NULL_HANDLE;
+	DeviceAllocation checker_memory;
+
+	std::vector<VkFramebuffer> swapchain_framebuffers;
+
+	//pipeline
+	PipelineCache pipeline_cache;
+	bool warm_pipeline_cache = false;
+	std::map<std::string, SpirvView> shader_code;		//Loaded while the device is still being created
+	std::vector<MappedSpirvFile> shader_files;			//Backs shader_code when loading from shader_directory
+	PipelineBuilder pipeline_builder;
+	VkRenderPass render_pass;
+	VkPipelineLayout pipeline_layout;
+	VkPipeline graphics_pipeline;
+
+	//frames in flight
+	std::vector<FrameData> frames;
+	VkCommandPool present_command_pool = VK_NULL_HANDLE;	//Only when graphics and presentation families differ
+	std::vector<VkCommandBuffer> present_acquire_commands;	//Ownership acquire barrier for each swapchain image
+	std::vector<VkFence> images_in_flight;	//Fence of the frame slot currently rendering to each swapchain image
+	uint32_t current_frame = 0;
+	uint64_t frame_count = 0;				//Frames submitted since Init
+	uint32_t record_threads = 1;			//Slices of the draw list recorded in parallel (options.record_threads resolved)
 
 	//utilities
+	JobSystem jobs;							//Per-frame CPU work, started before the init graph
+	RendererOptions options;
+	Benchmark benchmark;
 	VkFormat swapchain_image_format;
 	VkExtent2D swapchain_extent;
 
 	//vk functions
 	void CreateInstance();
+	std::vector<const char*> GetRequiredInstanceExtensions();
 	bool CheckInstanceExtensionSupport(const std::vector<const char*>& check_extensions);
 
 	bool CheckValidationLayerSupport();
@@ -63,11 +148,14 @@ private:
 
 	void GetPhysicalDevice();
 	bool CheckDeviceSuitable(VkPhysicalDevice device);
+	bool HasGraphicsPresentFamily(VkPhysicalDevice device);
 	QueueFamilyIndices GetQueueFamilies(VkPhysicalDevice device);
 
 	void CreateLogicalDevice();
 
+	void CreateAppWindow(const std::string& name, const int width, const int height);
 	void CreateSurface();
+	std::vector<const char*> GetRequiredDeviceExtensions();
 	bool CheckDeviceExtensionSupport(VkPhysicalDevice device);
 	SwapChainDetails GetSwapChainDetails(VkPhysicalDevice device);
 	void CreateSwapChain();
@@ -75,7 +163,31 @@ private:
 	VkPresentModeKHR ChooseBestPresentationMode(const std::vector<VkPresentModeKHR>& presentation_modes);
 	VkExtent2D ChooseSwapExtent(const VkSurfaceCapabilitiesKHR& surface_capabilities);
 	VkImageView CreateImageView(VkImage image, VkFormat format, VkImageAspectFlags aspect_flags);
+	void CreateOffscreenTargets();
 
+	void CreateRenderPass();
 	void CreateGraphicsPipiline();
-	VkShaderModule CreateShaderModule(const std::vector<char>& code);
+	const char* VertexShaderName() const;
+	void LoadShaderCode();
+	VkShaderModule LoadShaderModule(const std::string& name);
+	VkShaderModule CreateShaderModule(const SpirvView& code);
+	void CreateFramebuffers();
+	void CreateMeshes();
+	void CreateMaterials();
+
+	void CreateFrameResources();
+	void CreateOwnershipTransferCommands();
+	VkImageMemoryBarrier OwnershipTransferBarrier(VkImage image);
+	bool SeparatePresentFamily() const;
+	void SubmitFrameUploads();
+	void RecordCommands(VkCommandBuffer command_buffer, uint32_t image_index);
+	uint32_t GetRecordingSlices() const;
+	void QueueSliceRecording(uint32_t slice_count, uint32_t image_index, JobCounter& recorded, std::vector<VkResult>& results);
+	void RecordDrawRange(VkCommandBuffer command_buffer, size_t first, size_t end) const;
+	void PushMaterial(VkCommandBuffer command_buffer, uint32_t material) const;
+	bool ShouldRun();
+	void Draw();
+	void ReportBenchmark();
+	void ReportRecordingScaling();
+	void ReportStartup();
 };
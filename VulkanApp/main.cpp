@@ -1,9 +1,188 @@
+#include <cstdlib>
 #include <iostream>
+#include <string>
 #include "VulkanRenderer.h"
+#include "AllocatorTests.h"
+#include "CullingBenchmark.h"
+#include "SceneGraphBenchmark.h"
+#include "JobSystemTests.h"
+
+//Usage: VulkanApp [--headless] [--frames <count>] [--frames-in-flight <count>]
+//                 [--bench <frames>] [--bench-out <file.json>] [--pipeline-cache <file>]
+//                 [--shader-dir <dir>] [--startup-trace <file.json>] [--serial-init]
+//                 [--gpu <name|uuid>] [--alloc-test] [--alloc-bench <operations>]
+//                 [--triangles <count>] [--instances <count>] [--vertex-format <full|unorm16|half>]
+//                 [--instance-spread <factor>] [--gpu-driven] [--verify-culling] [--cull-bench <objects>]
+//                 [--scene-bench <nodes>] [--job-test] [--job-bench <objects>]
+//                 [--draws-per-batch <count>] [--record-threads <count>] [--record-bench <frames>] [--bindless]
+//Environment: VULKANAPP_GPU=<name|uuid> (--gpu takes precedence)
+static std::string ReadEnvironmentVariable(const char* name) {
+#ifdef _WIN32
+	//getenv is flagged as unsafe by SDL checks
+	char* value = nullptr;
+	size_t length = 0;
+	if (_dupenv_s(&value, &length, name) != 0 || value == nullptr) {
+		return {};
+	}
+	std::string result = value;
+	free(value);
+	return result;
+#else
+	const char* value = std::getenv(name);
+	return value != nullptr ? value : "";
+#endif
+}
+
+static bool ParseArguments(int argc, char* argv[], RendererOptions& options) {
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		bool has_value = i + 1 < argc;
+
+		if (arg == "--headless") {
+			options.headless = true;
+		}
+		else if (arg == "--frames" && has_value) {
+			options.max_frames = std::stoull(argv[++i]);
+		}
+		else if (arg == "--frames-in-flight" && has_value) {
+			options.frames_in_flight = static_cast<uint32_t>(std::stoul(argv[++i]));
+		}
+		else if (arg == "--bench" && has_value) {
+			options.bench_frames = std::stoull(argv[++i]);
+		}
+		else if (arg == "--bench-out" && has_value) {
+			options.bench_output = argv[++i];
+		}
+		else if (arg == "--pipeline-cache" && has_value) {
+			options.pipeline_cache_path = argv[++i];
+		}
+		else if (arg == "--shader-dir" && has_value) {
+			options.shader_directory = argv[++i];
+		}
+		else if (arg == "--startup-trace" && has_value) {
+			options.startup_trace_path = argv[++i];
+		}
+		else if (arg == "--serial-init") {
+			options.parallel_init = false;
+		}
+		else if (arg == "--gpu" && has_value) {
+			options.gpu_override = argv[++i];
+		}
+		else if (arg == "--alloc-test") {
+			options.alloc_test = true;
+		}
+		else if (arg == "--alloc-bench" && has_value) {
+			options.alloc_bench_operations = std::stoull(argv[++i]);
+		}
+		else if (arg == "--cull-bench" && has_value) {
+			options.cull_bench_objects = std::stoull(argv[++i]);
+		}
+		else if (arg == "--scene-bench" && has_value) {
+			options.scene_bench_nodes = std::stoull(argv[++i]);
+		}
+		else if (arg == "--job-test") {
+			options.job_test = true;
+		}
+		else if (arg == "--job-bench" && has_value) {
+			options.job_bench_objects = std::stoull(argv[++i]);
+		}
+		else if (arg == "--triangles" && has_value) {
+			options.triangle_count = std::stoull(argv[++i]);
+		}
+		else if (arg == "--instances" && has_value) {
+			options.instance_count = static_cast<uint32_t>(std::stoul(argv[++i]));
+		}
+		else if (arg == "--vertex-format" && has_value) {
+			std::string format = argv[++i];
+			if (format == "full") {
+				options.vertex_encoding = VertexEncoding::FULL;
+			}
+			else if (format == "unorm16") {
+				options.vertex_encoding = VertexEncoding::UNORM16;
+			}
+			else if (format == "half") {
+				options.vertex_encoding = VertexEncoding::HALF;
+			}
+			else {
+				std::cout << "Unknown vertex format: " << format << std::endl;
+				return false;
+			}
+		}
+		else if (arg == "--draws-per-batch" && has_value) {
+			options.draws_per_batch = static_cast<uint32_t>(std::stoul(argv[++i]));
+		}
+		else if (arg == "--record-threads" && has_value) {
+			options.record_threads = static_cast<uint32_t>(std::stoul(argv[++i]));
+		}
+		else if (arg == "--record-bench" && has_value) {
+			options.record_bench_frames = std::stoull(argv[++i]);
+		}
+		else if (arg == "--instance-spread" && has_value) {
+			options.instance_spread = std::stof(argv[++i]);
+		}
+		else if (arg == "--gpu-driven") {
+			options.gpu_driven = true;
+		}
+		else if (arg == "--verify-culling") {
+			options.gpu_driven = true;
+			options.verify_culling = true;
+		}
+		else if (arg == "--bindless") {
+			options.bindless = true;
+		}
+		else {
+			std::cout << "Unknown or incomplete argument: " << arg << std::endl;
+			return false;
+		}
+	}
+
+	return true;
+}
+
+int main(int argc, char* argv[]) {
+	//Startup timings are measured from here
+	StartupProfiler::Get();
+
+	RendererOptions options;
+	options.gpu_override = ReadEnvironmentVariable("VULKANAPP_GPU");
+	try {
+		if (!ParseArguments(argc, argv, options))
+			return EXIT_FAILURE;
+	}
+	catch (const std::exception&) {
+		std::cout << "ERROR: Invalid number in arguments" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	//Allocator checks run on the CPU only, no window or device is created
+	if (options.alloc_test || options.alloc_bench_operations != 0) {
+		bool passed = !options.alloc_test || RunAllocatorSelfTest();
+		if (options.alloc_bench_operations != 0) {
+			RunAllocatorBenchmark(options.alloc_bench_operations);
+		}
+		return passed ? 0 : EXIT_FAILURE;
+	}
+
+	if (options.cull_bench_objects != 0) {
+		RunCullingBenchmark(options.cull_bench_objects);
+		return 0;
+	}
+
+	if (options.scene_bench_nodes != 0) {
+		RunSceneGraphBenchmark(options.scene_bench_nodes);
+		return 0;
+	}
+
+	if (options.job_test || options.job_bench_objects != 0) {
+		bool passed = !options.job_test || RunJobSystemSelfTest();
+		if (options.job_bench_objects != 0) {
+			RunJobSystemBenchmark(options.job_bench_objects);
+		}
+		return passed ? 0 : EXIT_FAILURE;
+	}
 
-int main() {
 	VulkanRenderer vk_renderer;
-	if (vk_renderer.Init() == EXIT_FAILURE)
+	if (vk_renderer.Init("VulkanApp", 800, 600, options) == EXIT_FAILURE)
 		return EXIT_FAILURE;
 
 	vk_renderer.Update();